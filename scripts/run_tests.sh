@@ -27,4 +27,4 @@ echo
 echo
 echo "=== Running tests$D ==="
 echo
-opp_test run -v -w $NESTING/work -p $NESTING/work/nesting$D $NESTING/tests/*.test -a "-n .:$NESTING/src:$INET/src"
+opp_test run -v -w $NESTING/work -p $NESTING/work/nesting$D $NESTING/tests/*.test -a "-n .:$NESTING/src:$NESTING/simulations:$INET/src"
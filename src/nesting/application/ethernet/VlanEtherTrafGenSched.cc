@@ -16,6 +16,7 @@
 #include "nesting/application/ethernet/VlanEtherTrafGenSched.h"
 #include "nesting/linklayer/vlan/EnhancedVlanTag_m.h"
 #include "nesting/common/FlowMetaTag_m.h"
+#include "nesting/linklayer/launchTime/LaunchTimeTag_m.h"
 
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/InitStages.h"
@@ -26,6 +27,7 @@
 #include "inet/common/IProtocolRegistrationListener.h"
 
 #include <algorithm>
+#include <functional>
 #include <string.h>
 
 namespace nesting {
@@ -35,11 +37,12 @@ Define_Module(VlanEtherTrafGenSched);
 const Protocol* VlanEtherTrafGenSched::L2_PROTOCOL = &Protocol::nextHopForwarding;
 
 VlanEtherTrafGenSched::~VlanEtherTrafGenSched() {
-    // Delete self-messages for not yet sent packets
-    for (std::map<cMessage*, uint64_t>::iterator it = sendEvents.begin(); it != sendEvents.end(); it++) {
-        cancelAndDelete(it->first);
-    }
-    sendEvents.clear();
+    cancelEvent(&sendTimer);
+}
+
+bool VlanEtherTrafGenSched::PendingSend::operator>(const PendingSend& other) const {
+    return sendTime > other.sendTime
+            || (sendTime == other.sendTime && order > other.order);
 }
 
 void VlanEtherTrafGenSched::initialize(int stage) {
@@ -51,6 +54,8 @@ void VlanEtherTrafGenSched::initialize(int stage) {
         rcvdPkTreeIdSignal = registerSignal("rcvdPkTreeId");
 
         jitter = &par("jitter");
+        jitterEnabled = jitter->isExpression() || jitter->doubleValue() != 0;
+        launchTimeEnabled = par("launchTimeEnabled");
 
         WATCH_MAP(flowIdSeqNums);
 
@@ -72,8 +77,10 @@ void VlanEtherTrafGenSched::initialize(int stage) {
 
         currentSchedule = move(nextSchedule);
         nextSchedule.reset();
+        prepareSlots();
 
-        clock->subscribeTick(this, scheduleNextTickEvent() / clock->getClockRate());
+        cycleStart = clock->getTime();
+        scheduleNextSlotGroup();
 
         registerService(*L2_PROTOCOL, nullptr, gate("in"));
         registerProtocol(*L2_PROTOCOL, gate("out"), nullptr);
@@ -85,37 +92,31 @@ int VlanEtherTrafGenSched::numInitStages() const {
 }
 
 void VlanEtherTrafGenSched::handleMessage(cMessage *msg) {
-    if (msg->isSelfMessage()) {
-        sendDelayed(msg);
+    if (msg == &sendTimer) {
+        sendDelayed();
     } else {
         receivePacket(check_and_cast<Packet *>(msg));
     }
 }
 
-void VlanEtherTrafGenSched::sendPacket(uint64_t scheduleIndexTx) {
+void VlanEtherTrafGenSched::sendPacket(const SendSlot& slot, simtime_t launchTime) {
     // get scheduled control data
-    Ieee8021QCtrl header = currentSchedule->getScheduledObject(scheduleIndexTx % currentSchedule->size());
-
-    // If no sequence number for flow exists create one
-    if (flowIdSeqNums.find(header.flowId) == flowIdSeqNums.end()) {
-        flowIdSeqNums[header.flowId] = 0;
-    }
+    const Ieee8021QCtrl& header = slot.header;
 
     // Get and increment sequence number
     uint64_t flowId = header.flowId;
-    uint64_t seqNum = flowIdSeqNums[header.flowId];
-    flowIdSeqNums[header.flowId]++;
+    uint64_t seqNum = (*slot.seqNum)++;
 
     char msgname[40];
     sprintf(msgname, "pk-%d-%d-%d", getId(), flowId, seqNum);
 
     // create new packet
     Packet *datapacket = new Packet(msgname, IEEE802CTRL_DATA);
-    long len = currentSchedule->getSize(scheduleIndexTx % currentSchedule->size());
-    auto payload = makeShared<ByteCountChunk>(B(len));
-    // set creation time
+    auto payload = makeShared<ByteCountChunk>(slot.length);
+    // set creation time, which is the launch time in launch time mode so
+    // that the end to end delay doesn't include the time spent waiting for it
     auto timeTag = payload->addTag<CreationTimeTag>();
-    timeTag->setCreationTime(simTime());
+    timeTag->setCreationTime(launchTimeEnabled ? launchTime : simTime());
 
     datapacket->addTagIfAbsent<PacketProtocolTag>()->setProtocol(L2_PROTOCOL);
 
@@ -134,6 +135,10 @@ void VlanEtherTrafGenSched::sendPacket(uint64_t scheduleIndexTx) {
     flowMetaPckTag->setFlowId(header.flowId);
     flowMetaPckTag->setSeqNum(seqNum);
 
+    if (launchTimeEnabled) {
+        datapacket->addTag<LaunchTimeReq>()->setLaunchTime(launchTime);
+    }
+
     // Add flow id to packet meta information
     auto flowMetaTag = payload->addTagIfAbsent<FlowMetaTag>();
     flowMetaTag->setFlowId(header.flowId);
@@ -164,55 +169,118 @@ void VlanEtherTrafGenSched::receivePacket(Packet *pkt) {
 
 void VlanEtherTrafGenSched::tick(IClock *clock, short kind) {
     Enter_Method("tick()");
-    // When the current schedule index is 0, this means that the current
-    // schedule's cycle was not started or was just finished. Therefore in this
-    // case a new schedule is loaded if available.
-    if (indexSchedule == currentSchedule->size() ) {
-        // Load new schedule and delete the old one.
-        if (nextSchedule) {
-            currentSchedule = move(nextSchedule);
-            nextSchedule.reset();
+    assert(!idle && nextSlotGroup < slotGroups.size());
+
+    // Slot groups are only replaced in scheduleNextSlotGroup(), so the
+    // current group has to be processed before. In launch time mode the
+    // whole remaining cycle is handed to the network interface at once.
+    do {
+        processSlotGroup(slotGroups[nextSlotGroup]);
+        nextSlotGroup++;
+    } while (launchTimeEnabled && nextSlotGroup < slotGroups.size());
+
+    scheduleNextSlotGroup();
+}
+
+void VlanEtherTrafGenSched::processSlotGroup(const SlotGroup& group) {
+    if (launchTimeEnabled) {
+        // Convert the offset from local clock time to simulation time.
+        simtime_t launchTime = simTime() + cycleStart + group.offset - clock->getTime();
+        for (const std::shared_ptr<const SendSlot>& slot : group.slots) {
+            simtime_t delay = SimTime::ZERO;
+            if (jitterEnabled) {
+                delay = *jitter;
+            }
+            sendPacket(*slot, launchTime + std::max(delay, SimTime::ZERO));
         }
-        indexSchedule = 0;
-        clock->subscribeTick(this, scheduleNextTickEvent() / clock->getClockRate());
+        return;
+    }
 
+    for (const std::shared_ptr<const SendSlot>& slot : group.slots) {
+        if (jitterEnabled) {
+            simtime_t delay = *jitter;
+            if (delay > SimTime::ZERO) {
+                pendingSends.push_back(PendingSend { simTime() + delay, pendingSendCount++, slot });
+                std::push_heap(pendingSends.begin(), pendingSends.end(), std::greater<PendingSend>());
+                continue;
+            }
+        }
+        sendPacket(*slot);
     }
-    else {
-        double delay = *jitter;
-        cMessage* selfMessage = new cMessage();
-        // save msg in vector
-        sendEvents[selfMessage] = indexSchedule;
-        indexSchedule++;
-        scheduleAt(simTime() + delay, selfMessage);
-        clock->subscribeTick(this, scheduleNextTickEvent() / clock->getClockRate());
+
+    // Timer always points to the earliest delayed packet
+    if (!pendingSends.empty() && (!sendTimer.isScheduled()
+            || sendTimer.getArrivalTime() != pendingSends.front().sendTime)) {
+        cancelEvent(&sendTimer);
+        scheduleAt(pendingSends.front().sendTime, &sendTimer);
     }
 }
 
-void VlanEtherTrafGenSched::sendDelayed(cMessage *msg) {
-    sendPacket(sendEvents[msg]);
+void VlanEtherTrafGenSched::sendDelayed() {
+    while (!pendingSends.empty() && pendingSends.front().sendTime <= simTime()) {
+        std::pop_heap(pendingSends.begin(), pendingSends.end(), std::greater<PendingSend>());
+        std::shared_ptr<const SendSlot> slot = pendingSends.back().slot;
+        pendingSends.pop_back();
+        sendPacket(*slot);
+    }
 
-    assert(!msg->isScheduled()); // msg shouldn't be scheduled atm
-    sendEvents.erase(msg);
-    delete msg;
+    if (!pendingSends.empty()) {
+        scheduleAt(pendingSends.front().sendTime, &sendTimer);
+    }
 }
 
-/* This method returns the timeinterval between
- * the last sent frame and the frame to be sent next */
-simtime_t VlanEtherTrafGenSched::scheduleNextTickEvent() {
-    if (currentSchedule->size() == 0) {
-        return currentSchedule->getCycle();
-    } else if (indexSchedule == currentSchedule->size()) {
-        return currentSchedule->getCycle()
-                - currentSchedule->getTime(indexSchedule - 1);
-    } else if (indexSchedule % currentSchedule->size() == 0) {
-        return currentSchedule->getTime(indexSchedule);
-    } else {
-        return currentSchedule->getTime(indexSchedule % currentSchedule->size())
-                - currentSchedule->getTime(
-                        indexSchedule % currentSchedule->size() - 1);
+void VlanEtherTrafGenSched::prepareSlots() {
+    slotGroups.clear();
+    nextSlotGroup = 0;
+
+    if (!currentSchedule->isEmpty() && currentSchedule->getCycle() <= SimTime::ZERO) {
+        throw cRuntimeError("Cycle of a non-empty host schedule must be greater than zero.");
+    }
+
+    for (unsigned int i = 0; i < currentSchedule->size(); i++) {
+        std::shared_ptr<SendSlot> slot = std::make_shared<SendSlot>();
+        slot->header = currentSchedule->getScheduledObject(i);
+        slot->length = B(currentSchedule->getSize(i));
+        // Map nodes are stable, so the counter can be referenced directly.
+        slot->seqNum = &flowIdSeqNums[slot->header.flowId];
+
+        simtime_t offset = currentSchedule->getTime(i);
+        if (slotGroups.empty() || slotGroups.back().offset != offset) {
+            slotGroups.push_back(SlotGroup { offset, {} });
+        }
+        slotGroups.back().slots.push_back(slot);
     }
 }
 
+void VlanEtherTrafGenSched::scheduleNextSlotGroup() {
+    // Skip cycle boundaries until a non-empty offset is found.
+    while (nextSlotGroup >= slotGroups.size()) {
+        // Nothing to send until a new schedule is loaded.
+        if (slotGroups.empty() && !nextSchedule) {
+            idle = true;
+            return;
+        }
+
+        // A new schedule is loaded at the end of the current cycle.
+        cycleStart += currentSchedule->getCycle();
+        if (nextSchedule) {
+            currentSchedule = move(nextSchedule);
+            nextSchedule.reset();
+            prepareSlots();
+        }
+        nextSlotGroup = 0;
+    }
+
+    // Round up to whole clock ticks.
+    simtime_t idleTime = cycleStart + slotGroups[nextSlotGroup].offset - clock->getTime();
+    int64_t tickLength = clock->getClockRate().raw();
+    int64_t idleTicks = 0;
+    if (idleTime > SimTime::ZERO) {
+        idleTicks = (idleTime.raw() + tickLength - 1) / tickLength;
+    }
+    clock->subscribeTick(this, static_cast<unsigned>(idleTicks));
+}
+
 void VlanEtherTrafGenSched::loadScheduleOrDefault(cXMLElement* xml) {
     std::string hostName = this->getModuleByPath(par("hostModule"))->getFullName();
     HostSchedule<Ieee8021QCtrl>* schedule;
@@ -242,6 +310,19 @@ void VlanEtherTrafGenSched::loadScheduleOrDefault(cXMLElement* xml) {
     nextSchedule.reset();
     nextSchedule = move(schedulePtr);
 
+    // Resume at the next cycle boundary of the current (empty) schedule.
+    if (idle) {
+        idle = false;
+        simtime_t cycle = currentSchedule->getCycle();
+        if (cycle > SimTime::ZERO) {
+            int64_t elapsedCycles = (clock->getTime() - cycleStart).raw() / cycle.raw();
+            cycleStart += elapsedCycles * cycle;
+        } else {
+            cycleStart = clock->getTime();
+        }
+        scheduleNextSlotGroup();
+    }
+
 }
 
 } // namespace nesting
@@ -35,6 +35,7 @@
 #include <iostream>
 #include <vector>
 #include <tuple>
+#include <map>
 
 using namespace omnetpp;
 using namespace inet;
@@ -47,6 +48,30 @@ namespace nesting {
  */
 class VlanEtherTrafGenSched: public cSimpleModule, public IClockListener {
 protected:
+    /**
+     * Send slot prepared for a schedule entry when the schedule is loaded, so
+     * that sending a packet doesn't require any lookups.
+     */
+    struct SendSlot {
+        Ieee8021QCtrl header;
+        B length;
+        /** Sequence number counter of the slot's flow. */
+        uint64_t* seqNum;
+    };
+
+    /** Send slots sharing the same offset within the cycle. */
+    struct SlotGroup {
+        simtime_t offset;
+        std::vector<std::shared_ptr<const SendSlot>> slots;
+    };
+
+    /** Packet waiting for its jitter delay to elapse. */
+    struct PendingSend {
+        simtime_t sendTime;
+        uint64_t order;
+        std::shared_ptr<const SendSlot> slot;
+        bool operator>(const PendingSend& other) const;
+    };
 
     /** Current schedule. Is never null. */
     std::unique_ptr<HostSchedule<Ieee8021QCtrl>> currentSchedule;
@@ -57,8 +82,20 @@ protected:
      */
     std::unique_ptr<HostSchedule<Ieee8021QCtrl>> nextSchedule;
 
-    /** Index for the current entry in the schedule. */
-    uint64_t indexSchedule = 0;
+    /** Send slots of the current schedule grouped by offset. */
+    std::vector<SlotGroup> slotGroups;
+
+    /** Index of the next slot group to send. */
+    uint64_t nextSlotGroup = 0;
+
+    /** Clock time when the current cycle started. */
+    simtime_t cycleStart;
+
+    /**
+     * True if no tick is subscribed because the current schedule is empty and
+     * no further schedule is loaded.
+     */
+    bool idle = false;
 
     IClock *clock;
 
@@ -70,25 +107,60 @@ protected:
     simsignal_t sentPkTreeIdSignal;
     simsignal_t rcvdPkTreeIdSignal;
 
-    /**
-     * Keeps track of scheduled send events with their respective schedule index
-     */
-    std::map<cMessage*, uint64_t> sendEvents;
-
     /** Sequence numbers for every flow id. */
     std::map<uint64_t, uint64_t> flowIdSeqNums;
 
     cPar* jitter;
 
+    /**
+     * False if the jitter parameter is constant zero. Packets are sent
+     * directly on clock ticks in this case.
+     */
+    bool jitterEnabled = false;
+
+    /** Min-heap of packets delayed by jitter. */
+    std::vector<PendingSend> pendingSends;
+
+    /** Number of packets delayed by jitter so far. Keeps order stable. */
+    uint64_t pendingSendCount = 0;
+
+    /** Self-message used to send packets delayed by jitter. */
+    cMessage sendTimer = cMessage("sendTimer");
+
+    /**
+     * True if packets are stamped with a launch time and handed to the
+     * network interface once per cycle instead of on every offset.
+     */
+    bool launchTimeEnabled = false;
+
 protected:
     virtual void initialize(int stage) override;
-    virtual void sendPacket(uint64_t scheduleIndexTx);
+    /**
+     * Creates and sends the packet of a send slot. The launch time is only
+     * stamped on the packet if launch time mode is enabled.
+     */
+    virtual void sendPacket(const SendSlot& slot, simtime_t launchTime = SimTime::ZERO);
     virtual void receivePacket(Packet *msg);
     virtual void handleMessage(cMessage *msg) override;
-    virtual void sendDelayed(cMessage *msg);
+    virtual void sendDelayed();
 
     virtual int numInitStages() const override;
-    virtual simtime_t scheduleNextTickEvent();
+
+    /** Prepares the send slots of the current schedule. */
+    virtual void prepareSlots();
+
+    /**
+     * Subscribes a clock tick for the next non-empty offset. Switches to the
+     * next schedule at cycle boundaries without an additional tick.
+     */
+    virtual void scheduleNextSlotGroup();
+
+    /**
+     * Sends all packets of a slot group, or delays them by jitter. In launch
+     * time mode the packets are sent immediately with the group's offset as
+     * launch time, and jitter is added to the launch time.
+     */
+    virtual void processSlotGroup(const SlotGroup& group);
 public:
     /**
      * Arbitrary L2 protocol from inet::ProtocolGroup::ethertype, so that the
@@ -100,7 +172,10 @@ public:
 
     ~VlanEtherTrafGenSched();
 
-    /** Loads a new schedule into the gate controller. */
+    /**
+     * Loads a new schedule, which becomes active at the end of the current
+     * cycle.
+     */
     virtual void loadScheduleOrDefault(cXMLElement* xml);
 };
 
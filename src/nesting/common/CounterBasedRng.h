@@ -0,0 +1,64 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_COMMON_COUNTERBASEDRNG_H_
+#define NESTING_COMMON_COUNTERBASEDRNG_H_
+
+#include <cstdint>
+
+namespace nesting {
+
+/**
+ * Counter-based random number generator. The n-th number of a sequence is a
+ * hash of the key and n (the SplitMix64 finalizer), so drawing a number is a
+ * few multiplications, the state is two integers and every sequence can be
+ * reproduced from its key without replaying an RNG stream.
+ */
+class CounterBasedRng {
+private:
+    uint64_t key;
+    uint64_t counter = 0;
+public:
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+        return z ^ (z >> 31);
+    }
+
+    /** Returns the n-th number of the sequence of a key. */
+    static uint64_t at(uint64_t key, uint64_t n) {
+        return mix(key + n * UINT64_C(0x9E3779B97F4A7C15));
+    }
+
+    /** Keys are mixed, so consecutive seeds give unrelated sequences. */
+    explicit CounterBasedRng(uint64_t seed = 0) : key(mix(seed)) {}
+
+    void setSeed(uint64_t seed) {
+        key = mix(seed);
+        counter = 0;
+    }
+
+    /** Number of values drawn so far. */
+    uint64_t getCounter() const { return counter; }
+
+    uint64_t next() { return at(key, counter++); }
+
+    /** Returns a uniformly distributed double in [0, 1). */
+    double nextUniform() { return (next() >> 11) * (1.0 / (UINT64_C(1) << 53)); }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_COUNTERBASEDRNG_H_ */
@@ -13,16 +13,24 @@
 // along with this program.  If not, see http://www.gnu.org/licenses/.
 // 
 
-#include "nesting/linklayer/framePreemption/FrameForward.h"
+#include "nesting/common/IMisbehaviorListener.h"
+#include "nesting/common/FlowMetaTag_m.h"
+
+#include "inet/common/packet/Packet.h"
 
 namespace nesting {
 
-Define_Module(FrameForward);
+constexpr uint64_t IMisbehaviorListener::UNKNOWN_FLOW_ID;
 
-void FrameForward::initialize() {
+uint64_t IMisbehaviorListener::getFlowId(cPacket* packet) {
+    inet::Packet* inetPacket = dynamic_cast<inet::Packet*>(packet);
+    if (inetPacket != nullptr) {
+        auto flowMetaTag = inetPacket->findTag<FlowMetaTag>();
+        if (flowMetaTag != nullptr) {
+            return flowMetaTag->getFlowId();
+        }
+    }
+    return UNKNOWN_FLOW_ID;
 }
 
-void FrameForward::handleMessage(cMessage *msg) {
-    send(msg, "upperLayerOut");
-}
-}
+} // namespace nesting
@@ -0,0 +1,63 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_COMMON_IMISBEHAVIORLISTENER_H_
+#define NESTING_COMMON_IMISBEHAVIORLISTENER_H_
+
+#include <omnetpp.h>
+#include <cstdint>
+#include <limits>
+
+#include "nesting/common/misbehavior_m.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * This class implements an abstract interface for modules that are notified
+ * about misbehaving streams, e.g. frames discarded by a queue or frames
+ * received outside of their stream's schedule window.
+ *
+ * Notifications are direct method calls, so reporting doesn't allocate
+ * messages or schedule events.
+ */
+class IMisbehaviorListener {
+public:
+    /** Flow id used for frames that don't carry a FlowMetaTag. */
+    static constexpr uint64_t UNKNOWN_FLOW_ID = std::numeric_limits<uint64_t>::max();
+
+    virtual ~IMisbehaviorListener() {};
+
+    /**
+     * Called when a frame of the given flow misbehaved.
+     *
+     * @param type   DISCARD if the frame was dropped, LEAD or LAG if it was
+     *               received before or after its schedule window.
+     * @param flowId Flow id of the frame or UNKNOWN_FLOW_ID.
+     * @param source Module that detected the misbehavior.
+     */
+    virtual void onMisbehavior(MisbehaviorType type, uint64_t flowId, cModule* source) = 0;
+
+    /**
+     * Returns the flow id of the packet-level FlowMetaTag of a packet, or
+     * UNKNOWN_FLOW_ID if there is none.
+     */
+    static uint64_t getFlowId(cPacket* packet);
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_IMISBEHAVIORLISTENER_H_ */
@@ -0,0 +1,156 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/common/LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "nesting/common/time/TransmissionRate.h"
+
+namespace nesting {
+
+int LatencyHistogram::bucketIndex(int64_t picoseconds) {
+    ASSERT(picoseconds >= 0 && picoseconds <= kMaxLatencyPicoseconds);
+    if (picoseconds < 2 * kSubBucketHalfCount) {
+        return static_cast<int>(picoseconds);
+    }
+    // Values with the most significant bit msb are shifted so that their
+    // kSubBucketBits highest bits select the sub-bucket
+    int msb = 63 - __builtin_clzll(picoseconds);
+    int shift = msb - (kSubBucketBits - 1);
+    return shift * kSubBucketHalfCount + static_cast<int>(picoseconds >> shift);
+}
+
+int64_t LatencyHistogram::bucketLowerBound(int index) {
+    if (index < 2 * kSubBucketHalfCount) {
+        return index;
+    }
+    int shift = index / kSubBucketHalfCount - 1;
+    return static_cast<int64_t>(index - shift * kSubBucketHalfCount) << shift;
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < 2 * kSubBucketHalfCount) {
+        return index;
+    }
+    int shift = index / kSubBucketHalfCount - 1;
+    return bucketLowerBound(index) + (INT64_C(1) << shift) - 1;
+}
+
+void LatencyHistogram::collect(simtime_t latency) {
+    int64_t picoseconds = std::max(TransmissionRate::toPicoseconds(latency), INT64_C(0));
+    if (count == 0 || picoseconds < minPicoseconds) {
+        minPicoseconds = picoseconds;
+    }
+    if (count == 0 || picoseconds > maxPicoseconds) {
+        maxPicoseconds = picoseconds;
+    }
+    count++;
+    sum += latency.dbl();
+    if (picoseconds > kMaxLatencyPicoseconds) {
+        numOverflows++;
+        picoseconds = kMaxLatencyPicoseconds;
+    }
+    buckets[bucketIndex(picoseconds)]++;
+}
+
+void LatencyHistogram::clear() {
+    buckets.fill(0);
+    count = 0;
+    numOverflows = 0;
+    minPicoseconds = 0;
+    maxPicoseconds = 0;
+    sum = 0;
+}
+
+simtime_t LatencyHistogram::getMin() const {
+    return TransmissionRate::fromPicoseconds(minPicoseconds);
+}
+
+simtime_t LatencyHistogram::getMax() const {
+    return TransmissionRate::fromPicoseconds(maxPicoseconds);
+}
+
+simtime_t LatencyHistogram::getMean() const {
+    return count > 0 ? SimTime(sum / count) : SIMTIME_ZERO;
+}
+
+simtime_t LatencyHistogram::getPercentile(double percentile) const {
+    if (count == 0) {
+        return SIMTIME_ZERO;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100 * count));
+    rank = std::min(std::max(rank, UINT64_C(1)), count);
+    uint64_t cumulated = 0;
+    for (int i = 0; i < kNumBuckets; i++) {
+        cumulated += buckets[i];
+        if (cumulated >= rank) {
+            // Overflows are counted in the last bucket, its bound would cap
+            // them at kMaxLatencyPicoseconds
+            if (i == kNumBuckets - 1 && numOverflows > 0) {
+                return getMax();
+            }
+            return TransmissionRate::fromPicoseconds(
+                    std::min(bucketUpperBound(i), maxPicoseconds));
+        }
+    }
+    return getMax();
+}
+
+void LatencyHistogram::record(cComponent* component, const std::string& name) const {
+    if (count == 0) {
+        return;
+    }
+    component->recordScalar((name + " count").c_str(), count);
+    component->recordScalar((name + " mean").c_str(), getMean(), "s");
+    component->recordScalar((name + " min").c_str(), getMin(), "s");
+    component->recordScalar((name + " max").c_str(), getMax(), "s");
+    component->recordScalar((name + " p50").c_str(), getPercentile(50), "s");
+    component->recordScalar((name + " p99").c_str(), getPercentile(99), "s");
+    component->recordScalar((name + " p99.9").c_str(), getPercentile(99.9), "s");
+    component->recordScalar((name + " p99.99").c_str(), getPercentile(99.99), "s");
+    if (numOverflows > 0) {
+        component->recordScalar((name + " overflows").c_str(), numOverflows);
+    }
+
+    // The buckets are handed over as weighted bin centers, so the recorded
+    // histogram has the same bins without collecting every latency again
+    int first = 0;
+    while (buckets[first] == 0) {
+        first++;
+    }
+    int last = kNumBuckets - 1;
+    while (buckets[last] == 0) {
+        last--;
+    }
+    std::vector<double> binEdges;
+    for (int i = first; i <= last; i++) {
+        binEdges.push_back(bucketLowerBound(i) * 1e-12);
+    }
+    binEdges.push_back((bucketUpperBound(last) + 1) * 1e-12);
+    cHistogram histogram(name.c_str(), static_cast<cIHistogramStrategy*>(nullptr), true);
+    histogram.setBinEdges(binEdges);
+    for (int i = first; i <= last; i++) {
+        if (buckets[i] > 0) {
+            histogram.collectWeighted((bucketLowerBound(i) + bucketUpperBound(i) + 1) * 0.5e-12,
+                    static_cast<double>(buckets[i]));
+        }
+    }
+    component->recordStatistic(&histogram, "s");
+}
+
+} // namespace nesting
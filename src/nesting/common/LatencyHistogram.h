@@ -0,0 +1,86 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_COMMON_LATENCYHISTOGRAM_H_
+#define NESTING_COMMON_LATENCYHISTOGRAM_H_
+
+#include <omnetpp.h>
+
+#include <array>
+#include <string>
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Histogram of latencies with constant memory, in the style of HdrHistogram.
+ *
+ * Latencies are counted in picoseconds in log-linear buckets: every power of
+ * two is split into the same number of linear sub-buckets, so the relative
+ * error of a reported value is below 1/kSubBucketHalfCount (6.25%) over the
+ * whole range from 1ps to kMaxLatencyPicoseconds. Longer latencies are counted
+ * in the highest bucket, the exact minimum, maximum and mean are kept aside.
+ */
+class LatencyHistogram {
+public:
+    /** Number of linear sub-buckets per power of two is 2^kSubBucketBits. */
+    static const int kSubBucketBits = 5;
+    static const int kSubBucketHalfCount = 1 << (kSubBucketBits - 1);
+    /** Latencies up to 2^kMaxLatencyBits - 1 ps (about 1.1s) are resolved. */
+    static const int kMaxLatencyBits = 40;
+    static const int64_t kMaxLatencyPicoseconds = (INT64_C(1) << kMaxLatencyBits) - 1;
+    static const int kNumBuckets = (kMaxLatencyBits - kSubBucketBits + 2) * kSubBucketHalfCount;
+private:
+    std::array<uint64_t, kNumBuckets> buckets {};
+    uint64_t count = 0;
+    /** Number of latencies above kMaxLatencyPicoseconds. */
+    uint64_t numOverflows = 0;
+    int64_t minPicoseconds = 0;
+    int64_t maxPicoseconds = 0;
+    /** Sum in seconds, picoseconds would overflow after a few hours in total. */
+    double sum = 0;
+protected:
+    static int bucketIndex(int64_t picoseconds);
+    static int64_t bucketLowerBound(int index);
+    static int64_t bucketUpperBound(int index);
+public:
+    void collect(simtime_t latency);
+    void clear();
+
+    uint64_t getCount() const { return count; }
+    simtime_t getMin() const;
+    simtime_t getMax() const;
+    simtime_t getMean() const;
+
+    /**
+     * Returns the latency that percentile percent of the collected latencies
+     * don't exceed, rounded up to the end of its bucket. A percentile in the
+     * highest bucket is the maximum if latencies beyond the resolved range
+     * were collected.
+     */
+    simtime_t getPercentile(double percentile) const;
+
+    /**
+     * Records count, mean, min, max and percentiles as scalars and the
+     * non-empty range of buckets as histogram. Names are prefixed with name.
+     * Nothing is recorded for an empty histogram.
+     */
+    void record(cComponent* component, const std::string& name) const;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_LATENCYHISTOGRAM_H_ */
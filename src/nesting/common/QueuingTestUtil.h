@@ -0,0 +1,195 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_COMMON_QUEUINGTESTUTIL_H_
+#define NESTING_COMMON_QUEUINGTESTUTIL_H_
+
+#include <omnetpp.h>
+
+#include <string>
+#include <vector>
+
+#include "inet/common/ModuleAccess.h"
+#include "inet/common/packet/Packet.h"
+#include "inet/common/packet/chunk/ByteCountChunk.h"
+#include "inet/linklayer/ethernet/EtherFrame_m.h"
+#include "inet/linklayer/ieee8021q/Ieee8021qHeader_m.h"
+
+#include "nesting/common/LatencyTag_m.h"
+#include "nesting/common/time/LinkTiming.h"
+#include "nesting/ieee8021q/queue/TransmissionSelection.h"
+#include "nesting/linklayer/common/ITsnMac.h"
+
+// Test modules around a Queuing module. Not intended to be used in regular
+// NESTING components. Tests derive their modules from these classes and
+// register them with Define_Module in their own namespace.
+
+namespace nesting {
+
+/**
+ * Returns a frame with a VLAN tag of the given pcp, an 18B header and the
+ * given payload, without preamble.
+ */
+inline inet::Packet* createTestFrame(const char* name, int pcp, int payloadBytes)
+{
+    auto header = inet::makeShared<inet::EthernetMacHeader>();
+    auto cTag = new inet::Ieee8021qHeader();
+    cTag->setPcp(pcp);
+    header->setCTag(cTag);
+    header->setChunkLength(header->getChunkLength() + inet::B(4));
+    auto packet = new inet::Packet(name);
+    packet->insertAtBack(inet::makeShared<inet::ByteCountChunk>(inet::B(payloadBytes)));
+    packet->insertAtFront(header);
+    return packet;
+}
+
+/**
+ * Sends the frames given by the frames parameter at their times. Frames are
+ * given as name:pcp:payload:time, separated by spaces.
+ */
+class TestFrameSource : public omnetpp::cSimpleModule
+{
+protected:
+    virtual void initialize() override
+    {
+        omnetpp::cStringTokenizer tokenizer(par("frames"));
+        while (tokenizer.hasMoreTokens()) {
+            std::vector<std::string> fields = omnetpp::cStringTokenizer(tokenizer.nextToken(), ":").asVector();
+            if (fields.size() != 4) {
+                throw omnetpp::cRuntimeError("Frames must be given as name:pcp:payload:time");
+            }
+            inet::Packet* packet = createTestFrame(fields[0].c_str(), std::stoi(fields[1]), std::stoi(fields[2]));
+            scheduleAt(omnetpp::SimTime::parse(fields[3].c_str()), packet);
+        }
+    }
+
+    virtual void handleMessage(omnetpp::cMessage* msg) override
+    {
+        send(msg, "out");
+    }
+};
+
+/**
+ * Mac that keeps requesting frames from the transmission selection given by
+ * the transmissionSelectionModule parameter and transmits each frame for its
+ * duration at 1Gbps. Tests check the frames in receiveFrame().
+ */
+class TestMacBase : public omnetpp::cSimpleModule, public ITsnMac
+{
+protected:
+    LinkTiming linkTiming;
+    TransmissionSelection* transmissionSelection = nullptr;
+    omnetpp::cMessage endTxMsg = omnetpp::cMessage("endTx");
+protected:
+    virtual void initialize() override
+    {
+        linkTiming.update(1e9);
+        transmissionSelection = inet::getModuleFromPar<TransmissionSelection>(
+                par("transmissionSelectionModule"), this);
+        // First packet request once all modules are initialized
+        scheduleAt(omnetpp::simTime(), &endTxMsg);
+    }
+
+    virtual void handleMessage(omnetpp::cMessage* msg) override
+    {
+        if (msg == &endTxMsg) {
+            transmissionSelection->requestPacket();
+            return;
+        }
+
+        inet::Packet* packet = omnetpp::check_and_cast<inet::Packet*>(msg);
+        EV_INFO << "Received " << packet->getName() << " at " << omnetpp::simTime() << std::endl;
+        receiveFrame(packet);
+        scheduleAt(omnetpp::simTime() + linkTiming.durationForBits(packet->getBitLength()), &endTxMsg);
+        delete packet;
+    }
+
+    /** Checks a frame at the start of its transmission. */
+    virtual void receiveFrame(inet::Packet* packet) = 0;
+
+    /**
+     * Checks that the queueing time of a frame is its time from enqueueing
+     * until now, assuming it was created when it was enqueued.
+     */
+    virtual void checkQueueingTime(inet::Packet* packet)
+    {
+        omnetpp::simtime_t queueingTime = packet->getTag<LatencyTag>()->getQueueingTime();
+        omnetpp::simtime_t expected = omnetpp::simTime() - packet->getCreationTime();
+        if (queueingTime != expected) {
+            throw omnetpp::cRuntimeError("Queueing time of %s is %s instead of %s",
+                    packet->getName(), queueingTime.str().c_str(), expected.str().c_str());
+        }
+    }
+
+public:
+    virtual ~TestMacBase()
+    {
+        cancelEvent(&endTxMsg);
+    }
+
+    virtual const LinkTiming& getLinkTiming() const override { return linkTiming; }
+};
+
+/**
+ * Mac with frame preemption that checks the frames and the start of their
+ * transmission against the expectedFrames parameter, given as name@time
+ * separated by spaces in the order of transmission.
+ */
+class ExpectedFramesTestMac : public TestMacBase
+{
+protected:
+    std::vector<std::string> expectedFrames;
+    size_t numFramesReceived = 0;
+    bool onHold = false;
+protected:
+    virtual void initialize() override
+    {
+        TestMacBase::initialize();
+        expectedFrames = omnetpp::cStringTokenizer(par("expectedFrames")).asVector();
+    }
+
+    virtual void receiveFrame(inet::Packet* packet) override
+    {
+        omnetpp::simtime_t now = omnetpp::simTime();
+        if (numFramesReceived >= expectedFrames.size()) {
+            throw omnetpp::cRuntimeError("Unexpected frame %s at %s", packet->getName(),
+                    now.str().c_str());
+        }
+        std::vector<std::string> expected = omnetpp::cStringTokenizer(
+                expectedFrames[numFramesReceived++].c_str(), "@").asVector();
+        if (expected[0] != packet->getName() || omnetpp::SimTime::parse(expected[1].c_str()) != now) {
+            throw omnetpp::cRuntimeError("Received %s at %s instead of %s at %s", packet->getName(),
+                    now.str().c_str(), expected[0].c_str(), expected[1].c_str());
+        }
+    }
+
+    virtual void finish() override
+    {
+        if (numFramesReceived != expectedFrames.size()) {
+            throw omnetpp::cRuntimeError("Received %d of %d frames", (int) numFramesReceived,
+                    (int) expectedFrames.size());
+        }
+    }
+
+public:
+    virtual bool isFramePreemptionEnabled() override { return true; }
+    virtual void hold(omnetpp::simtime_t delay) override { Enter_Method_Silent(); onHold = true; }
+    virtual void release() override { Enter_Method_Silent(); onHold = false; }
+    virtual bool isOnHold() override { return onHold; }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_QUEUINGTESTUTIL_H_ */
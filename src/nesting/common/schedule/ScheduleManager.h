@@ -29,6 +29,8 @@
 #include <string>
 #include <memory>
 #include <set>
+#include <vector>
+#include <cmath>
 
 using namespace omnetpp;
 using namespace inet;
@@ -45,6 +47,11 @@ public:
     protected:
         virtual void onOperStateChange(const T& newState) {};
         virtual void onOperStateChange(const T& newState, const T& oldState) {};
+        /**
+         * Called if a phase jump of the clock skipped whole cycles of the
+         * operational schedule. Skipped cycles aren't executed.
+         */
+        virtual void onCyclesSkipped(uint64_t skippedCycles) {};
     };
 protected:
     /** Type values to associate timestamp events with state machines. */
@@ -76,6 +83,7 @@ protected:
     bool configPending = false;
     simtime_t configChangeTime = SimTime::ZERO;
     uint64_t configChangeErrorCounter = 0;
+    uint64_t skippedCycleCounter = 0;
     std::shared_ptr<const Schedule<T>> operSchedule = nullptr;
 
     // Variables belonging to CycleTimer state machine
@@ -119,6 +127,7 @@ protected:
         WATCH(cycleStartTime);
         WATCH(configChangeTime);
         WATCH(configChangeErrorCounter);
+        WATCH(skippedCycleCounter);
 
         // State machines
         WATCH(cycleTimerState);
@@ -476,6 +485,56 @@ public:
         }
     }
 
+    virtual void onTimestampsSkipped(IClock2& clock, const std::vector<std::shared_ptr<const IClock2::Timestamp>>& timestamps) override
+    {
+        Enter_Method("timestampsSkipped");
+
+        // Each state machine only waits for its latest timestamp, so it is
+        // updated once no matter how many of its timestamps were skipped.
+        bool cycleTimerSkipped = false;
+        for (const std::shared_ptr<const IClock2::Timestamp>& timestamp : timestamps) {
+            switch (timestamp->getKind()) {
+            case CYCLE_TIMER:
+                cycleTimerSkipped = true;
+                rescheduleAt(simTime(), &cycleTimerMsg);
+                break;
+            case LIST_EXECUTE:
+                rescheduleAt(simTime(), &listExecuteMsg);
+                break;
+            case LIST_CONFIG:
+                rescheduleAt(simTime(), &listConfigMsg);
+                break;
+            default:
+                throw cRuntimeError("Invalid timestamp event.");
+            }
+        }
+
+        // The cycle containing the new local time is started immediately.
+        // All complete cycles before are skipped instead of being replayed.
+        if (cycleTimerSkipped && nextCycleTimerState == CycleTimerState::START_CYCLE) {
+            simtime_t operCycleTime = operSchedule->getCycleTime();
+            simtime_t lag = clock.updateAndGetLocalTime() - cycleStartTime;
+            uint64_t skippedCycles = static_cast<uint64_t>(std::floor(lag / operCycleTime));
+            if (skippedCycles > 0) {
+                cycleStartTime += skippedCycles * operCycleTime;
+                skippedCycleCounter += skippedCycles;
+                EV_INFO << "Phase jump skipped " << skippedCycles << " schedule cycles." << std::endl;
+                for (auto listener : listeners) {
+                    listener->onCyclesSkipped(skippedCycles);
+                }
+            }
+        }
+    }
+
+    /**
+     * Returns the number of schedule cycles skipped because of phase jumps
+     * of the clock.
+     */
+    virtual uint64_t getSkippedCycleCounter()
+    {
+        return skippedCycleCounter;
+    }
+
     virtual void subscribeOperStateChanges(IOperStateListener& listener)
     {
         listeners.insert(&listener);
@@ -20,6 +20,7 @@
 
 #include <memory>
 #include <cstdint>
+#include <vector>
 
 using namespace omnetpp;
 
@@ -70,6 +71,20 @@ public:
         virtual ~TimestampListener() {};
 
         virtual void onTimestamp(IClock2& clock, std::shared_ptr<const Timestamp> timestamp) = 0;
+
+        /**
+         * Called once per listener if a forward phase jump of the clock
+         * skipped one or more subscribed timestamps. The timestamps are
+         * ordered by local time. The default implementation replays
+         * onTimestamp for every skipped timestamp; listeners that only need
+         * to catch up with the latest state should override this method.
+         */
+        virtual void onTimestampsSkipped(IClock2& clock, const std::vector<std::shared_ptr<const Timestamp>>& timestamps)
+        {
+            for (const std::shared_ptr<const Timestamp>& timestamp : timestamps) {
+                onTimestamp(clock, timestamp);
+            }
+        }
     };
 
     class ConfigListener {
@@ -0,0 +1,48 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/common/time/LinkTiming.h"
+
+namespace nesting {
+
+bool LinkTiming::update(double bitsPerSecond)
+{
+    if (!rate.update(bitsPerSecond)) {
+        return false;
+    }
+    if (rate.isZero()) {
+        interframeGap = SIMTIME_ZERO;
+        preambleDuration = SIMTIME_ZERO;
+        minFrameDuration = SIMTIME_ZERO;
+    } else {
+        interframeGap = rate.durationForBits(kInterframeGapBits);
+        preambleDuration = durationForBytes(kPreambleAndSfdBytes);
+        minFrameDuration = durationForBytes(kMinFrameBytes);
+    }
+    return true;
+}
+
+bool LinkTiming::isAdditionalRate(double bitsPerSecond)
+{
+    static const double kAdditionalRates[] = { 2.5e9, 5e9, 25e9, 50e9, 100e9 };
+    for (double additionalRate : kAdditionalRates) {
+        if (bitsPerSecond == additionalRate) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace nesting
@@ -0,0 +1,119 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_COMMON_TIME_LINKTIMING_H_
+#define NESTING_COMMON_TIME_LINKTIMING_H_
+
+#include <omnetpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+#include "nesting/common/time/TransmissionRate.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Timing constants of an Ethernet link, computed once when the transmit rate
+ * of a port is read from its channel instead of on every use.
+ *
+ * Interframe gap, preamble and SFD and the minimum frame size are the same
+ * for all full duplex rates from 10Mbps up to 100Gbps.
+ */
+class LinkTiming
+{
+public:
+    static const int64_t kInterframeGapBits = 96;
+    static const int64_t kPreambleAndSfdBytes = 8;
+    static const int64_t kMinFrameBytes = 64;
+protected:
+    TransmissionRate rate;
+    simtime_t interframeGap;
+    simtime_t preambleDuration;
+    simtime_t minFrameDuration;
+public:
+    LinkTiming() {};
+
+    /**
+     * Updates the constants if the given rate differs from the current rate.
+     * Returns true if the rate changed.
+     */
+    bool update(double bitsPerSecond);
+
+    const TransmissionRate& getRate() const { return rate; }
+
+    bool isZero() const { return rate.isZero(); }
+
+    /** Returns the interframe gap of 96 bit times. */
+    simtime_t getInterframeGap() const { return interframeGap; }
+
+    /** Returns the transmission duration of preamble and SFD. */
+    simtime_t getPreambleDuration() const { return preambleDuration; }
+
+    /** Returns the transmission duration of a minimum sized frame. */
+    simtime_t getMinFrameDuration() const { return minFrameDuration; }
+
+    /** @see TransmissionRate::bitsForDuration(simtime_t) */
+    int64_t bitsForDuration(simtime_t duration) const { return rate.bitsForDuration(duration); }
+
+    /** @see TransmissionRate::durationForBits(uint64_t) */
+    simtime_t durationForBits(uint64_t bits) const { return rate.durationForBits(bits); }
+
+    simtime_t durationForBytes(uint64_t bytes) const { return rate.durationForBits(bytes * 8); }
+
+    /**
+     * Returns true for rates supported by the TSN Macs in addition to the
+     * ones of INET's EtherMacBase (2.5, 5, 25, 50 and 100Gbps).
+     */
+    static bool isAdditionalRate(double bitsPerSecond);
+
+    /**
+     * Returns the Ethernet descriptor of an additional rate, or nullptr for
+     * other rates. The descriptors are copies of the 10Gbps descriptor of
+     * the given table, which has the same frame sizes and no half duplex.
+     */
+    template<typename EtherDescr, size_t N>
+    static const EtherDescr* findAdditionalEtherDescr(
+            const EtherDescr (&etherDescrs)[N], double bitsPerSecond);
+};
+
+template<typename EtherDescr, size_t N>
+const EtherDescr* LinkTiming::findAdditionalEtherDescr(
+        const EtherDescr (&etherDescrs)[N], double bitsPerSecond)
+{
+    static std::map<double, EtherDescr> additionalEtherDescrs;
+    if (!isAdditionalRate(bitsPerSecond)) {
+        return nullptr;
+    }
+    auto it = additionalEtherDescrs.find(bitsPerSecond);
+    if (it == additionalEtherDescrs.end()) {
+        for (size_t i = 0; i < N; i++) {
+            if (etherDescrs[i].txrate == 10e9) {
+                EtherDescr etherDescr = etherDescrs[i];
+                etherDescr.txrate = bitsPerSecond;
+                it = additionalEtherDescrs.emplace(bitsPerSecond, etherDescr).first;
+                break;
+            }
+        }
+    }
+    return it == additionalEtherDescrs.end() ? nullptr : &it->second;
+}
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_TIME_LINKTIMING_H_ */
@@ -26,6 +26,7 @@ OscillatorBase::OscillatorBase()
     , timeOfLastTick(SimTime::ZERO)
     , tickEventNow(false)
     , tickMessage(cMessage("TickMessage"))
+    , tickMessageCount(0)
 {
 }
 
@@ -47,10 +48,18 @@ void OscillatorBase::initialize()
     WATCH(lastTick);
     WATCH(timeOfLastTick);
     WATCH_LIST(scheduledEvents);
+    WATCH(tickMessageCount);
+    WATCH_VECTOR(listenerNames);
+    WATCH_VECTOR(domainEventCounts);
 }
 
 void OscillatorBase::finish()
 {
+    recordScalar("tick messages", tickMessageCount);
+    for (size_t listenerId = 0; listenerId < domainEventCounts.size(); listenerId++) {
+        std::string name = "tick events " + listenerNames[listenerId];
+        recordScalar(name.c_str(), domainEventCounts[listenerId]);
+    }
 }
 
 void OscillatorBase::handleMessage(cMessage *msg)
@@ -62,25 +71,37 @@ void OscillatorBase::handleMessage(cMessage *msg)
         // Otherwise the self-message shouldn't exist.
         assert(!scheduledEvents.empty());
 
-        std::shared_ptr<OscillatorBase::TickImpl> tickEvent = scheduledEvents.front();
-        scheduledEvents.pop_front();
+        uint64_t currentTick = scheduledEvents.front()->getTick();
 
         // Invariant: Monotonic increasing tick count
-        assert(lastTick <= tickEvent->getTick());
+        assert(lastTick <= currentTick);
         assert(timeOfLastTick <= simTime());
 
         // Update last tick
-        if (lastTick < tickEvent->getTick()) {
+        if (lastTick < currentTick) {
             timeOfLastTick = simTime();
-            lastTick = tickEvent->getTick();
+            lastTick = currentTick;
         }
 
-        // Notify listener
-        tickEvent->getListener().onTick(*this, tickEvent);
+        tickMessageCount++;
 
-        scheduleNextTick();
+        // Dispatch all events of the current tick with this message. Events
+        // subscribed for the current tick while dispatching are dispatched as
+        // well. Events are ordered by kind and first subscription of their
+        // listener.
+        while (!scheduledEvents.empty() && scheduledEvents.front()->getTick() == currentTick) {
+            std::shared_ptr<OscillatorBase::TickImpl> tickEvent = scheduledEvents.front();
+            scheduledEvents.pop_front();
+
+            domainEventCounts[tickEvent->getListenerId()]++;
+
+            // Notify listener
+            tickEvent->getListener().onTick(*this, tickEvent);
+        }
 
         tickEventNow = false;
+
+        scheduleNextTick();
     }
 }
 
@@ -90,6 +111,12 @@ simtime_t OscillatorBase::tickInterval() const
 }
 
 void OscillatorBase::scheduleNextTick() {
+    // The next tick is scheduled once after all events of the current tick
+    // were dispatched.
+    if (tickEventNow) {
+        return;
+    }
+
     // Cancel current self message
     if (tickMessage.isScheduled()) {
         cancelEvent(&tickMessage);
@@ -127,6 +154,35 @@ uint64_t OscillatorBase::updateAndGetTickCount()
     return currentTick;
 }
 
+uint64_t OscillatorBase::getOrAssignListenerId(IOscillator::TickListener& listener)
+{
+    auto it = listenerIds.find(&listener);
+    if (it != listenerIds.end()) {
+        return it->second;
+    }
+
+    uint64_t listenerId = listenerNames.size();
+    listenerIds[&listener] = listenerId;
+
+    // Clock domains are named after the module implementing the listener.
+    cModule* module = dynamic_cast<cModule*>(&listener);
+    std::string name = module != nullptr ? module->getFullPath() : "listener" + std::to_string(listenerId);
+    listenerNames.push_back(name);
+    domainEventCounts.push_back(0);
+
+    return listenerId;
+}
+
+bool OscillatorBase::findListenerId(IOscillator::TickListener& listener, uint64_t& listenerId) const
+{
+    auto it = listenerIds.find(&listener);
+    if (it == listenerIds.end()) {
+        return false;
+    }
+    listenerId = it->second;
+    return true;
+}
+
 std::shared_ptr<const IOscillator::Tick> OscillatorBase::subscribeTick(IOscillator::TickListener& listener, uint64_t idleTicks, uint64_t kind)
 {
     Enter_Method_Silent();
@@ -138,6 +194,7 @@ std::shared_ptr<const IOscillator::Tick> OscillatorBase::subscribeTick(IOscillat
     uint64_t tick = currentTick + idleTicks;
     std::shared_ptr<OscillatorBase::TickImpl> tickEvent = std::make_shared<OscillatorBase::TickImpl>(
             listener,
+            getOrAssignListenerId(listener),
             tick,
             kind,
             globalTimeFromTick(tick));
@@ -170,8 +227,15 @@ void OscillatorBase::unsubscribeTick(IOscillator::TickListener& listener, const
 {
     Enter_Method_Silent();
 
+    // Listeners that never subscribed can't have scheduled events
+    uint64_t listenerId;
+    if (!findListenerId(listener, listenerId)) {
+        return;
+    }
+
     std::shared_ptr<OscillatorBase::TickImpl> tickEvent = std::make_shared<OscillatorBase::TickImpl>(
         listener, 
+        listenerId,
         tick.getTick(), 
         tick.getKind(), 
         SimTime::ZERO);
@@ -218,7 +282,11 @@ void OscillatorBase::unsubscribeTicks(IOscillator::TickListener& listener)
 bool OscillatorBase::isTickScheduled(IOscillator::TickListener& listener, const IOscillator::Tick& tickEvent) const
 {
     Enter_Method_Silent();
-    std::shared_ptr<OscillatorBase::TickImpl> tick = std::make_shared<OscillatorBase::TickImpl>(listener, tickEvent);
+    uint64_t listenerId;
+    if (!findListenerId(listener, listenerId)) {
+        return false;
+    }
+    std::shared_ptr<OscillatorBase::TickImpl> tick = std::make_shared<OscillatorBase::TickImpl>(listener, listenerId, tickEvent);
     auto it = std::lower_bound(
             scheduledEvents.begin(),
             scheduledEvents.end(),
@@ -270,16 +338,18 @@ void OscillatorBase::unsubscribeConfigChanges(IOscillator::ConfigListener& liste
     configListeners.erase(&listener);
 }
 
-OscillatorBase::TickImpl::TickImpl(IOscillator::TickListener& listener, uint64_t tick, uint64_t kind, simtime_t globalSchedulingTime)
+OscillatorBase::TickImpl::TickImpl(IOscillator::TickListener& listener, uint64_t listenerId, uint64_t tick, uint64_t kind, simtime_t globalSchedulingTime)
     : listener(listener)
+    , listenerId(listenerId)
     , tick(tick)
     , kind(kind)
     , globalSchedulingTime(globalSchedulingTime)
 {
 }
 
-OscillatorBase::TickImpl::TickImpl(IOscillator::TickListener& listener, const IOscillator::Tick& tickEvent)
+OscillatorBase::TickImpl::TickImpl(IOscillator::TickListener& listener, uint64_t listenerId, const IOscillator::Tick& tickEvent)
     : listener(listener)
+    , listenerId(listenerId)
     , tick(tickEvent.getTick())
     , kind(tickEvent.getKind())
     , globalSchedulingTime(tickEvent.getGlobalSchedulingTime())
@@ -300,6 +370,11 @@ void OscillatorBase::TickImpl::setListener(IOscillator::TickListener& listener)
     this->listener = listener;
 }
 
+uint64_t OscillatorBase::TickImpl::getListenerId() const
+{
+    return listenerId;
+}
+
 uint64_t OscillatorBase::TickImpl::getTick() const
 {
     return tick;
@@ -338,7 +413,7 @@ bool OscillatorBase::TickImpl::operator<(const OscillatorBase::TickImpl& tickEve
         if (this->kind < tickEvent.getKind()) {
             return true;
         } else if (this->kind == tickEvent.getKind()) {
-            return &(this->listener) < &(tickEvent.getListener());
+            return this->listenerId < tickEvent.getListenerId();
         }
     }
     return false;
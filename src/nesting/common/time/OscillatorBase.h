@@ -22,7 +22,10 @@
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <vector>
 #include <set>
+#include <map>
+#include <string>
 #include <functional>
 
 #include "nesting/common/time/IOscillator.h"
@@ -39,15 +42,22 @@ protected:
     protected:
         TickListener& listener;
 
+        /**
+         * Position of the listener in the order of first subscription. Used
+         * instead of the listener address to order events of the same tick
+         * deterministically.
+         */
+        uint64_t listenerId;
+
         uint64_t tick;
 
         uint64_t kind;
 
         simtime_t globalSchedulingTime;
     public:
-        TickImpl(TickListener& listener, uint64_t tick, uint64_t kind, simtime_t globalSchedulingTime);
+        TickImpl(TickListener& listener, uint64_t listenerId, uint64_t tick, uint64_t kind, simtime_t globalSchedulingTime);
 
-        TickImpl(TickListener& listener, const Tick& tickEvent);
+        TickImpl(TickListener& listener, uint64_t listenerId, const Tick& tickEvent);
 
         virtual ~TickImpl();
 
@@ -56,6 +66,8 @@ protected:
 
         virtual void setListener(TickListener& listener);
 
+        virtual uint64_t getListenerId() const;
+
         /** @copydoc Tick::getTick() */
         virtual uint64_t getTick() const override;
 
@@ -104,6 +116,27 @@ protected:
 
     /** Used as self message to notify the component of the next tick event */
     cMessage tickMessage;
+
+    /**
+     * Ids of all tick listeners (clock domains) in the order of their first
+     * subscription.
+     */
+    std::map<TickListener*, uint64_t> listenerIds;
+
+    /** Names of tick listeners, indexed by listener id. */
+    std::vector<std::string> listenerNames;
+
+    /**
+     * Number of dispatched tick events per clock domain, indexed by listener
+     * id.
+     */
+    std::vector<uint64_t> domainEventCounts;
+
+    /**
+     * Number of tick messages. All tick events of the same tick are
+     * dispatched with a single tick message.
+     */
+    uint64_t tickMessageCount;
 public:
     OscillatorBase();
 
@@ -158,6 +191,18 @@ protected:
      */
     virtual void scheduleNextTick();
 
+    /**
+     * Returns the id of a tick listener and assigns a new one if the
+     * listener subscribes for the first time.
+     */
+    virtual uint64_t getOrAssignListenerId(TickListener& listener);
+
+    /**
+     * Looks up the id of a tick listener. Returns false if the listener has
+     * never subscribed a tick.
+     */
+    virtual bool findListenerId(TickListener& listener, uint64_t& listenerId) const;
+
     virtual simtime_t globalTimeFromTick(uint64_t idleTicks) = 0;
 
     virtual uint64_t tickFromGlobalTime(simtime_t globalTime) = 0;
@@ -17,6 +17,8 @@
 
 #include <cmath>
 #include <algorithm>
+#include <map>
+#include <vector>
 
 namespace nesting {
 
@@ -45,10 +47,23 @@ void RealtimeClock::initialize()
     WATCH(driftRate);
     WATCH(lastTick);
     WATCH_LIST(scheduledEvents);
+    WATCH(tickEventCount);
+    WATCH(timestampEventCount);
+}
+
+void RealtimeClock::finish()
+{
+    recordScalar("tick events", tickEventCount);
+    recordScalar("timestamp events", timestampEventCount);
 }
 
 void RealtimeClock::scheduleNextTimestamp()
 {
+    // Rescheduling is done once after a phase jump was processed.
+    if (tickReschedulingDeferred) {
+        return;
+    }
+
     // Cancel next tick.
     if (nextTick != nullptr) {
         oscillator->unsubscribeTick(*this, *nextTick);
@@ -59,6 +74,10 @@ void RealtimeClock::scheduleNextTimestamp()
     if (!scheduledEvents.empty() && !isStopped()) {
         std::shared_ptr<TimestampImpl>& nextTimestamp = scheduledEvents.front();
         simtime_t idleTime = nextTimestamp->getLocalTime() - updateAndGetLocalTime();
+        // Timestamps subscribed in the past are due immediately
+        if (idleTime < SimTime::ZERO) {
+            idleTime = SimTime::ZERO;
+        }
         // We have to round up to the next highest tick
         uint64_t idleTicks = static_cast<uint64_t>(std::ceil(idleTime / timeIncrementPerTick()));
         nextTick = oscillator->subscribeTick(*this, idleTicks);
@@ -70,6 +89,17 @@ simtime_t RealtimeClock::timeIncrementPerTick() const
     return SimTime(1, SIMTIME_S) / (oscillator->getFrequency() + driftRate);
 }
 
+uint64_t RealtimeClock::getOrAssignListenerId(IClock2::TimestampListener& listener)
+{
+    auto it = listenerIds.find(&listener);
+    if (it != listenerIds.end()) {
+        return it->second;
+    }
+    uint64_t listenerId = listenerIds.size();
+    listenerIds[&listener] = listenerId;
+    return listenerId;
+}
+
 std::shared_ptr<const IClock2::Timestamp> RealtimeClock::subscribeDelta(IClock2::TimestampListener& listener, simtime_t delta, uint64_t kind)
 {
     Enter_Method_Silent();
@@ -81,7 +111,7 @@ std::shared_ptr<const IClock2::Timestamp> RealtimeClock::subscribeDelta(IClock2:
 std::shared_ptr<const IClock2::Timestamp> RealtimeClock::subscribeTimestamp(IClock2::TimestampListener& listener, simtime_t eventTime, uint64_t kind)
 {
     Enter_Method_Silent();
-    std::shared_ptr<TimestampImpl> event = std::make_shared<TimestampImpl>(listener, eventTime, kind);
+    std::shared_ptr<TimestampImpl> event = std::make_shared<TimestampImpl>(listener, getOrAssignListenerId(listener), eventTime, kind);
     std::list<std::shared_ptr<TimestampImpl>>::iterator it = std::lower_bound(scheduledEvents.begin(), scheduledEvents.end(), event);
     if (it == scheduledEvents.end() || **it != *event) {
         scheduledEvents.insert(it, event);
@@ -95,7 +125,14 @@ std::shared_ptr<const IClock2::Timestamp> RealtimeClock::subscribeTimestamp(IClo
 void RealtimeClock::unsubscribeTimestamp(IClock2::TimestampListener& listener, const IClock2::Timestamp& timestamp)
 {
     Enter_Method_Silent();
-    std::shared_ptr<TimestampImpl> event = std::make_shared<TimestampImpl>(listener, timestamp.getLocalTime(), timestamp.getKind());
+
+    // Listeners that never subscribed can't have scheduled events
+    auto listenerIt = listenerIds.find(&listener);
+    if (listenerIt == listenerIds.end()) {
+        return;
+    }
+
+    std::shared_ptr<TimestampImpl> event = std::make_shared<TimestampImpl>(listener, listenerIt->second, timestamp.getLocalTime(), timestamp.getKind());
     std::list<std::shared_ptr<TimestampImpl>>::iterator it = std::lower_bound(scheduledEvents.begin(), scheduledEvents.end(), event);
 
     if (it != scheduledEvents.end() && **it == *event) {
@@ -130,12 +167,14 @@ void RealtimeClock::setLocalTime(simtime_t newTime)
 {
     Enter_Method_Silent();
 
-    // Update time
-    simtime_t oldTime = localTime;
+    // Account for ticks elapsed since the last update before the jump.
+    simtime_t oldTime = updateAndGetLocalTime();
     localTime = newTime;
 
     // If the new local time is in the future, then we have to fast forward all
-    // events that are scheduled before the new time value.
+    // events that are scheduled before the new time value. They are moved out
+    // of the event queue in one step.
+    std::list<std::shared_ptr<TimestampImpl>> skippedEvents;
     if (oldTime < localTime) {
         auto bound = std::upper_bound(
                 scheduledEvents.begin(), 
@@ -144,19 +183,45 @@ void RealtimeClock::setLocalTime(simtime_t newTime)
                 [](simtime_t time, std::shared_ptr<TimestampImpl> event) {
                     return time < event->getLocalTime();
                 });
-        // Notify listeners
-        for (auto it = scheduledEvents.begin(); it != bound; it++) {
-            std::shared_ptr<TimestampImpl> event = *it;
-            event->getListener().onTimestamp(*this, event);
-        }
-        // Remove events
-        scheduledEvents.erase(scheduledEvents.begin(), bound);
+        skippedEvents.splice(skippedEvents.end(), scheduledEvents, scheduledEvents.begin(), bound);
     }
 
+    // Listeners typically resubscribe while they are notified. The oscillator
+    // tick is only rescheduled once after all notifications.
+    bool wasDeferred = tickReschedulingDeferred;
+    tickReschedulingDeferred = true;
+
+    notifySkippedTimestamps(skippedEvents);
+
     // Notify config listeners
     for (IClock2::ConfigListener* listener : configListeners) {
         listener->onPhaseJump(*this, oldTime, newTime);
     }
+
+    tickReschedulingDeferred = wasDeferred;
+
+    // The idle time of the next timestamp has changed in any case.
+    scheduleNextTimestamp();
+}
+
+void RealtimeClock::notifySkippedTimestamps(const std::list<std::shared_ptr<TimestampImpl>>& skippedEvents)
+{
+    // Group skipped timestamps by listener. Listeners are notified in the
+    // order of their earliest skipped timestamp.
+    std::vector<IClock2::TimestampListener*> listenerOrder;
+    std::map<IClock2::TimestampListener*, std::vector<std::shared_ptr<const IClock2::Timestamp>>> timestampsByListener;
+    for (const std::shared_ptr<TimestampImpl>& event : skippedEvents) {
+        IClock2::TimestampListener* listener = &(event->getListener());
+        std::vector<std::shared_ptr<const IClock2::Timestamp>>& timestamps = timestampsByListener[listener];
+        if (timestamps.empty()) {
+            listenerOrder.push_back(listener);
+        }
+        timestamps.push_back(event);
+    }
+
+    for (IClock2::TimestampListener* listener : listenerOrder) {
+        listener->onTimestampsSkipped(*this, timestampsByListener[listener]);
+    }
 }
 
 double RealtimeClock::getClockRate() const
@@ -181,6 +246,9 @@ void RealtimeClock::setDriftRate(double driftRate)
 {
     Enter_Method_Silent();
 
+    // Local time up to now advanced with the old drift rate
+    updateAndGetLocalTime();
+
     // Update drift rate
     double oldDriftRate = this->driftRate;
     this->driftRate = driftRate;
@@ -211,21 +279,30 @@ void RealtimeClock::onTick(IOscillator& oscillator, std::shared_ptr<const IOscil
     // Invariant
     assert(&oscillator == this->oscillator);
 
-    // Pop next event from queue
-    std::shared_ptr<TimestampImpl> currentEvent = scheduledEvents.front();
-    scheduledEvents.pop_front();
-
     // Invariant: There must not be any timestamp event scheduled with
     // timestamp in the past.
-    assert(localTime <= currentEvent->getLocalTime());
+    assert(localTime <= scheduledEvents.front()->getLocalTime());
 
     // Update local time
     updateAndGetLocalTime();
 
-    scheduleNextTimestamp();
+    tickEventCount++;
+
+    // Dispatch all timestamps that are due with this tick. The oscillator
+    // tick is rescheduled once afterwards.
+    bool wasDeferred = tickReschedulingDeferred;
+    tickReschedulingDeferred = true;
+    while (!scheduledEvents.empty() && scheduledEvents.front()->getLocalTime() <= localTime) {
+        std::shared_ptr<TimestampImpl> currentEvent = scheduledEvents.front();
+        scheduledEvents.pop_front();
+        timestampEventCount++;
+
+        // Notify listener
+        currentEvent->getListener().onTimestamp(*this, currentEvent);
+    }
+    tickReschedulingDeferred = wasDeferred;
 
-    // Notify listener
-    currentEvent->getListener().onTimestamp(*this, currentEvent);
+    scheduleNextTimestamp();
 }
 
 void RealtimeClock::onFrequencyChange(IOscillator& oscillator, double oldFrequency, double newFrequency)
@@ -241,8 +318,9 @@ void RealtimeClock::onFrequencyChange(IOscillator& oscillator, double oldFrequen
     }
 }
 
-RealtimeClock::TimestampImpl::TimestampImpl(IClock2::TimestampListener& listener, simtime_t localTime, uint64_t kind)
+RealtimeClock::TimestampImpl::TimestampImpl(IClock2::TimestampListener& listener, uint64_t listenerId, simtime_t localTime, uint64_t kind)
     : listener(listener)
+    , listenerId(listenerId)
     , localTime(localTime)
     , kind(kind)
 {
@@ -263,6 +341,11 @@ IClock2::TimestampListener& RealtimeClock::TimestampImpl::getListener() const
     return listener;
 }
 
+uint64_t RealtimeClock::TimestampImpl::getListenerId() const
+{
+    return listenerId;
+}
+
 bool RealtimeClock::TimestampImpl::operator==(const TimestampImpl& other) const
 {
     return this->localTime == other.localTime
@@ -283,7 +366,7 @@ bool RealtimeClock::TimestampImpl::operator<(const TimestampImpl& other) const
         if (this->kind < other.kind) {
             return true;
         } else if (this->kind == other.kind) {
-            return &(this->listener) < &(other.listener);
+            return this->listenerId < other.listenerId;
         }
     }
     return false;
@@ -20,6 +20,7 @@
 
 #include <list>
 #include <set>
+#include <map>
 #include <iostream>
 
 #include "inet/common/ModuleAccess.h"
@@ -44,11 +45,14 @@ protected:
         simtime_t localTime;
         uint64_t kind;
         IClock2::TimestampListener& listener;
+        /** Orders timestamps of the same time and kind deterministically. */
+        uint64_t listenerId;
     public:
-        TimestampImpl(IClock2::TimestampListener& listener, simtime_t localTime, uint64_t kind);
+        TimestampImpl(IClock2::TimestampListener& listener, uint64_t listenerId, simtime_t localTime, uint64_t kind);
         virtual simtime_t getLocalTime() const override;
         virtual uint64_t getKind() const override;
         virtual IClock2::TimestampListener& getListener() const;
+        virtual uint64_t getListenerId() const;
         bool operator==(const TimestampImpl& other) const;
         bool operator!=(const TimestampImpl& other) const;
         bool operator<(const TimestampImpl& other) const;
@@ -65,6 +69,18 @@ protected:
     std::set<IClock2::ConfigListener*> configListeners;
     std::list<std::shared_ptr<TimestampImpl>> scheduledEvents;
     std::shared_ptr<const IOscillator::Tick> nextTick;
+    /**
+     * True while listeners are notified about a phase jump. Resubscriptions
+     * of listeners don't reschedule the oscillator tick in this phase; the
+     * tick is rescheduled once after all listeners were notified.
+     */
+    bool tickReschedulingDeferred = false;
+    /** Ids of timestamp listeners in the order of their first subscription. */
+    std::map<IClock2::TimestampListener*, uint64_t> listenerIds;
+    /** Number of oscillator ticks handled by this clock domain. */
+    uint64_t tickEventCount = 0;
+    /** Number of timestamp events dispatched by this clock domain. */
+    uint64_t timestampEventCount = 0;
     /** 
      * If the clockRate + driftRate is smaller than this threshold, the clock
      * is stopped instead of running really slow to prevent numeric errors.
@@ -72,8 +88,11 @@ protected:
     const double minEffectiveClockRate = 1e-12;
 protected:
     virtual void initialize();
+    virtual void finish();
     virtual void scheduleNextTimestamp();
+    virtual void notifySkippedTimestamps(const std::list<std::shared_ptr<TimestampImpl>>& skippedEvents);
     virtual simtime_t timeIncrementPerTick() const;
+    virtual uint64_t getOrAssignListenerId(IClock2::TimestampListener& listener);
 public:
     RealtimeClock();
     virtual ~RealtimeClock();
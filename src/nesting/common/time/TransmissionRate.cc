@@ -0,0 +1,112 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/common/time/TransmissionRate.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace nesting {
+
+TransmissionRate::TransmissionRate(double bitsPerSecond)
+{
+    update(bitsPerSecond);
+}
+
+bool TransmissionRate::update(double bitsPerSecond)
+{
+    if (bitsPerSecond < 0) {
+        throw cRuntimeError("Transmission rate must not be negative.");
+    }
+    uint64_t newBitsPerSecond = static_cast<uint64_t>(std::llround(bitsPerSecond));
+    if (newBitsPerSecond == this->bitsPerSecond) {
+        return false;
+    }
+
+    this->bitsPerSecond = newBitsPerSecond;
+    if (newBitsPerSecond == 0) {
+        bits = 0;
+        picoseconds = 1;
+    } else {
+        uint64_t divisor = gcd(newBitsPerSecond, kPicosecondsPerSecond);
+        bits = newBitsPerSecond / divisor;
+        picoseconds = kPicosecondsPerSecond / divisor;
+    }
+    exact = picoseconds <= UINT64_MAX / std::max<uint64_t>(bits, 1);
+    return true;
+}
+
+uint64_t TransmissionRate::getBitsPerSecond() const
+{
+    return bitsPerSecond;
+}
+
+bool TransmissionRate::isZero() const
+{
+    return bitsPerSecond == 0;
+}
+
+int64_t TransmissionRate::bitsForDuration(simtime_t duration) const
+{
+    int64_t ps = toPicoseconds(duration);
+    bool negative = ps < 0;
+    uint64_t magnitude = static_cast<uint64_t>(negative ? -ps : ps);
+    uint64_t result;
+    if (exact) {
+        // Split multiplication to avoid overflows for long durations.
+        result = (magnitude / picoseconds) * bits
+                + ((magnitude % picoseconds) * bits) / picoseconds;
+    } else {
+        result = static_cast<uint64_t>(std::floor(static_cast<long double>(magnitude) * bits / picoseconds));
+    }
+    return negative ? -static_cast<int64_t>(result) : static_cast<int64_t>(result);
+}
+
+simtime_t TransmissionRate::durationForBits(uint64_t bits) const
+{
+    if (isZero()) {
+        throw cRuntimeError("Can't transmit bits with a transmission rate of zero.");
+    }
+    uint64_t ps;
+    if (exact) {
+        uint64_t remainder = ((bits % this->bits) * picoseconds + this->bits - 1) / this->bits;
+        ps = (bits / this->bits) * picoseconds + remainder;
+    } else {
+        ps = static_cast<uint64_t>(std::ceil(static_cast<long double>(bits) * picoseconds / this->bits));
+    }
+    return fromPicoseconds(static_cast<int64_t>(ps));
+}
+
+int64_t TransmissionRate::toPicoseconds(simtime_t duration)
+{
+    return duration.inUnit(SIMTIME_PS);
+}
+
+simtime_t TransmissionRate::fromPicoseconds(int64_t picoseconds)
+{
+    return SimTime(picoseconds, SIMTIME_PS);
+}
+
+uint64_t TransmissionRate::gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+} // namespace nesting
@@ -0,0 +1,85 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_COMMON_TIME_TRANSMISSIONRATE_H_
+#define NESTING_COMMON_TIME_TRANSMISSIONRATE_H_
+
+#include <omnetpp.h>
+
+#include <cstdint>
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Fixed-point representation of a transmission rate in bits per second.
+ *
+ * The rate is kept as reduced fraction of bits per picosecond, so that
+ * conversions between bit lengths and durations are exact integer operations.
+ * For common link speeds (10Mbps up to 100Gbps, including 2.5, 5, 25 and
+ * 50Gbps) one bit takes an integral number of picoseconds.
+ */
+class TransmissionRate
+{
+public:
+    static const int64_t kPicosecondsPerSecond = 1000000000000LL;
+protected:
+    uint64_t bitsPerSecond = 0;
+    /** Numerator of the rate in bits per picosecond. */
+    uint64_t bits = 0;
+    /** Denominator of the rate in bits per picosecond. */
+    uint64_t picoseconds = 1;
+    /**
+     * False for odd rates whose fraction would overflow 64-bit intermediate
+     * products. Conversions fall back to extended precision in this case.
+     */
+    bool exact = true;
+public:
+    TransmissionRate() {};
+
+    /** Creates a rate that is rounded to an integral number of bits per second. */
+    explicit TransmissionRate(double bitsPerSecond);
+
+    /**
+     * Updates the rate if the given value differs from the current rate.
+     * Returns true if the rate changed.
+     */
+    bool update(double bitsPerSecond);
+
+    uint64_t getBitsPerSecond() const;
+
+    bool isZero() const;
+
+    /**
+     * Returns the number of bits that are completely transmitted within the
+     * given duration. Negative durations yield negative bit counts.
+     */
+    int64_t bitsForDuration(simtime_t duration) const;
+
+    /** Returns the duration to transmit the given number of bits, rounded up. */
+    simtime_t durationForBits(uint64_t bits) const;
+
+    /** Converts a duration to integral picoseconds. */
+    static int64_t toPicoseconds(simtime_t duration);
+
+    static simtime_t fromPicoseconds(int64_t picoseconds);
+
+    static uint64_t gcd(uint64_t a, uint64_t b);
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_TIME_TRANSMISSIONRATE_H_ */
@@ -49,8 +49,11 @@ const int kMinSupportedQueues = 1;
 const int selfMessageSchedulingPriority = 1;
 
 const inet::B kFramePreemptionMinFinalPayloadSize = inet::B(60);
-// TODO make MinNonFinalPayloadSize a parameter
-const inet::B kFramePreemptionMinNonFinalPayloadSize = inet::B(60); //or 124,188,252
+// Minimum non-final payload for addFragSize 0, every increment of addFragSize
+// adds kFramePreemptionAddFragSizeUnit (124, 188 or 252 bytes)
+const inet::B kFramePreemptionMinNonFinalPayloadSize = inet::B(60);
+const inet::B kFramePreemptionAddFragSizeUnit = inet::B(64);
+const int kFramePreemptionMaxAddFragSize = 3;
 
 const inet::B ETHER_MAC_FRAME_BYTES = inet::B(18);
 const inet::B PREAMBLE_BYTES = inet::B(7);
@@ -14,6 +14,7 @@
 // 
 
 #include "nesting/ieee8021q/queue/TransmissionSelection.h"
+#include "nesting/ieee8021q/Ieee8021q.h"
 #include "nesting/ieee8021q/queue/framePreemption/ExpressFrameTag_m.h"
 
 #include "inet/common/packet/Packet.h"
@@ -22,11 +23,18 @@ namespace nesting {
 
 Define_Module(TransmissionSelection);
 
+/** Largest frame charged to a deficit: MTU, MAC header and VLAN tag. */
+static const int64_t kMaxEtsFrameBitLength =
+        (kEthernet2MaximumTransmissionUnitBitLength + kVLANTagBitLength).get() + 14 * 8;
+
 TransmissionSelection::TransmissionSelection() {
     requestPacketMsg.setSchedulingPriority(selfMessageSchedulingPriority);
     packetEnqueuedMsg.setSchedulingPriority(selfMessageSchedulingPriority);
     WATCH(packetRequestedFromUs);
     WATCH(packetRequestedFromInputs);
+    WATCH(inputRequestInFlight);
+    WATCH(numPacketsPrefetched);
+    WATCH(numPrefetchedPacketsRequeued);
 }
 
 TransmissionSelection::~TransmissionSelection() {
@@ -48,6 +56,75 @@ void TransmissionSelection::initialize() {
             tGates.push_back(tg);
         }
     }
+    if (tGates.size() > 64) {
+        throw cRuntimeError("TransmissionSelection supports at most 64 queues.");
+    }
+    activeQueues = tGates.size() == 64 ? ~UINT64_C(0) : (UINT64_C(1) << tGates.size()) - 1;
+
+    std::string mode = par("selectionMode").stdstringValue();
+    if (mode == "strictPriority") {
+        selectionMode = SelectionMode::STRICT_PRIORITY;
+    } else if (mode == "ets") {
+        selectionMode = SelectionMode::ETS;
+        initializeEts();
+    } else {
+        throw cRuntimeError("Unknown selection mode \"%s\".", mode.c_str());
+    }
+
+    prefetchLimit = par("prefetchLimit");
+    if (prefetchLimit < 0) {
+        throw cRuntimeError("Parameter prefetchLimit must not be negative.");
+    }
+    if (prefetchLimit > 0 && selectionMode == SelectionMode::ETS) {
+        throw cRuntimeError("Prefetching is not supported in ETS selection mode.");
+    }
+}
+
+void TransmissionSelection::initializeEts() {
+    std::vector<int> weights = cStringTokenizer(par("etsWeights")).asIntVector();
+    if (weights.size() > tGates.size()) {
+        throw cRuntimeError("Parameter etsWeights has more values than there are queues.");
+    }
+
+    // Queues without a weight are strict priority queues. The quantum of the
+    // queue with the smallest weight is etsQuantum, the others are scaled
+    // proportionally.
+    int minWeight = 0;
+    for (int weight : weights) {
+        if (weight < 0) {
+            throw cRuntimeError("Parameter etsWeights must not contain negative values.");
+        }
+        if (weight > 0 && (minWeight == 0 || weight < minWeight)) {
+            minWeight = weight;
+        }
+    }
+    int64_t quantum = par("etsQuantum");
+    // Every turn has to send a frame, otherwise queues with a weight take
+    // turns without sending. The quanta of the other queues are larger.
+    if (minWeight > 0 && quantum < kMaxEtsFrameBitLength) {
+        throw cRuntimeError("Parameter etsQuantum is %lldb, but must be at least the maximum frame length of %lldb.",
+                (long long) quantum, (long long) kMaxEtsFrameBitLength);
+    }
+    etsQuanta.assign(tGates.size(), 0);
+    etsDeficits.assign(tGates.size(), 0);
+    for (unsigned int i = 0; i < weights.size(); i++) {
+        if (weights[i] > 0) {
+            etsQuanta[i] = (quantum * weights[i] + minWeight - 1) / minWeight;
+            etsQueues |= UINT64_C(1) << i;
+        }
+    }
+    WATCH_VECTOR(etsDeficits);
+    WATCH(etsTurn);
+}
+
+void TransmissionSelection::initializeQueueBitmaps() {
+    expressQueues = 0;
+    for (unsigned int i = 0; i < tGates.size(); i++) {
+        if (tGates[i]->isExpressQueue()) {
+            expressQueues |= UINT64_C(1) << i;
+        }
+    }
+    queueBitmapsInitialized = true;
 }
 
 void TransmissionSelection::handleMessage(cMessage* msg) {
@@ -73,15 +150,41 @@ void TransmissionSelection::handleMessage(cMessage* msg) {
                              << " which is express: "
                              << transmissionGate->isExpressQueue() << endl;
         }
-        ASSERT(packetRequestedFromUs);
-        packetRequestedFromUs = false;
+        ASSERT(inputRequestInFlight);
+        inputRequestInFlight = false;
 
-        // Tag frame from express queues
-        if (transmissionGate->isExpressQueue()) {
-            packet->addTagIfAbsent<ExpressFrameReq>();
-        }
-        
-        send(packet, "out");
+        sendPacket(packet, gateId, false);
+        prefetchPackets();
+    }
+}
+
+void TransmissionSelection::sendPacket(Packet* packet, int gateId, bool prefetched) {
+    ASSERT(packetRequestedFromUs);
+    packetRequestedFromUs = false;
+
+    // The queue counts a prefetched frame as dequeued only now
+    if (prefetched) {
+        tGates[gateId]->commitPacket(packet);
+    }
+
+    // Charge the frame to the deficit of its round robin queue
+    if (selectionMode == SelectionMode::ETS
+            && (etsQueues & (UINT64_C(1) << gateId))) {
+        etsDeficits[gateId] -= packet->getBitLength();
+    }
+
+    // Tag frame from express queues
+    if (tGates[gateId]->isExpressQueue()) {
+        packet->addTagIfAbsent<ExpressFrameReq>();
+    }
+
+    send(packet, "out");
+}
+
+void TransmissionSelection::finish() {
+    if (prefetchLimit > 0) {
+        recordScalar("packets prefetched", numPacketsPrefetched);
+        recordScalar("prefetched packets requeued", numPrefetchedPacketsRequeued);
     }
 }
 
@@ -93,26 +196,232 @@ void TransmissionSelection::refreshDisplay() const {
 }
 
 bool TransmissionSelection::schedulePacket() {
-    //Try to request express packet
-    for (auto it = tGates.rbegin(); it != tGates.rend(); it++) {
-        TransmissionGate* transmissionGate = *it;
-        if (transmissionGate->isExpressQueue()
-                && !transmissionGate->isEmpty()) {
-            transmissionGate->requestPacket();
+    bool success;
+    if (selectionMode == SelectionMode::ETS) {
+        success = scheduleEtsPacket();
+    } else {
+        success = scheduleStrictPriorityPacket();
+    }
+    if (success) {
+        inputRequestInFlight = true;
+    }
+    return success;
+}
+
+bool TransmissionSelection::scheduleStrictPriorityPacket() {
+    int index = selectStrictPriorityQueue();
+    if (index < 0) {
+        return false;
+    }
+    tGates[index]->requestPacket();
+    return true;
+}
+
+int TransmissionSelection::selectStrictPriorityQueue() {
+    if (!queueBitmapsInitialized) {
+        initializeQueueBitmaps();
+    }
+    //Try to select express queue, then any queue
+    int index = highestReadyQueue(eligibleQueues() & expressQueues);
+    if (index < 0) {
+        index = highestReadyQueue(eligibleQueues());
+    }
+    return index;
+}
+
+void TransmissionSelection::prefetchPackets() {
+    if (prefetchLimit == 0 || packetRequestedFromUs || inputRequestInFlight) {
+        return;
+    }
+    while (static_cast<int>(prefetchedPackets.size()) < prefetchLimit) {
+        int index = selectStrictPriorityQueue();
+        if (index < 0 || !tGates[index]->isPrefetchable()) {
+            return;
+        }
+        cPacket* packet = tGates[index]->prefetchPacket();
+        if (packet == nullptr) {
+            // Shouldn't happen, the gate was found ready
+            deactivateQueue(index);
+            continue;
+        }
+        EV_TRACE << getFullPath() << ": Prefetched packet " << packet->getName()
+                        << " from queue " << index << "." << endl;
+        take(packet);
+        prefetchedPackets.push_back(PrefetchedPacket { check_and_cast<Packet*>(packet), index });
+        numPacketsPrefetched++;
+    }
+}
+
+int TransmissionSelection::bestPrefetchedPacket(bool expressOnly) {
+    // Express frames first, then the highest queue index
+    int best = -1;
+    for (size_t i = 0; i < prefetchedPackets.size(); i++) {
+        int gateId = prefetchedPackets[i].gateId;
+        bool express = expressQueues & (UINT64_C(1) << gateId);
+        if (expressOnly && !express) {
+            continue;
+        }
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        int bestGateId = prefetchedPackets[best].gateId;
+        bool bestExpress = expressQueues & (UINT64_C(1) << bestGateId);
+        if ((express && !bestExpress)
+                || (express == bestExpress && gateId > bestGateId)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool TransmissionSelection::isPrefetchedPacketValid(const PrefetchedPacket& prefetched) {
+    int gateId = prefetched.gateId;
+    if ((pausedQueues & (UINT64_C(1) << gateId))
+            || !tGates[gateId]->canTransmit(prefetched.packet->getBitLength())) {
+        return false;
+    }
+    // No frame that would have been selected before may have become ready
+    uint64_t preceding = gateId == 63 ? 0 : ~UINT64_C(0) << (gateId + 1);
+    if (expressQueues & (UINT64_C(1) << gateId)) {
+        preceding &= expressQueues;
+    } else {
+        preceding |= expressQueues;
+    }
+    return highestReadyQueue(eligibleQueues() & preceding) < 0;
+}
+
+int TransmissionSelection::findValidPrefetchedPacket(bool expressOnly) {
+    int best;
+    while ((best = bestPrefetchedPacket(expressOnly)) >= 0) {
+        if (isPrefetchedPacketValid(prefetchedPackets[best])) {
+            return best;
+        }
+        // Later frames of the same queue are invalid as well
+        int gateId = prefetchedPackets[best].gateId;
+        EV_DETAIL << getFullPath() << ": Prefetched packets from queue "
+                         << gateId << " are no longer eligible, requeuing." << endl;
+        requeuePrefetchedPackets(gateId);
+    }
+    return -1;
+}
+
+void TransmissionSelection::requeuePrefetchedPackets(int gateId) {
+    // Requeue from the back, so the queue order is preserved
+    for (size_t i = prefetchedPackets.size(); i-- > 0;) {
+        if (prefetchedPackets[i].gateId == gateId) {
+            Packet* packet = prefetchedPackets[i].packet;
+            prefetchedPackets.erase(prefetchedPackets.begin() + i);
+            tGates[gateId]->requeuePacket(packet);
+            numPrefetchedPacketsRequeued++;
+        }
+    }
+}
+
+bool TransmissionSelection::hasValidPrefetchedPacket(bool expressOnly) {
+    return findValidPrefetchedPacket(expressOnly) >= 0;
+}
+
+bool TransmissionSelection::servePacketRequest() {
+    ASSERT(packetRequestedFromUs);
+    int index = findValidPrefetchedPacket(false);
+    if (index >= 0) {
+        PrefetchedPacket prefetched = prefetchedPackets[index];
+        prefetchedPackets.erase(prefetchedPackets.begin() + index);
+        sendPacket(prefetched.packet, prefetched.gateId, true);
+        return true;
+    }
+    if (inputRequestInFlight) {
+        // Frame in flight serves this request
+        return false;
+    }
+    packetRequestedFromInputs = true;
+    if (schedulePacket()) {
+        packetRequestedFromInputs = false;
+    }
+    return false;
+}
+
+bool TransmissionSelection::scheduleEtsPacket() {
+    if (!queueBitmapsInitialized) {
+        initializeQueueBitmaps();
+    }
+    // Express queues are served first, within the express and the preemptable
+    // class strict priority queues take precedence over weighted queues.
+    uint64_t classes[] = { expressQueues, ~expressQueues };
+    for (uint64_t trafficClass : classes) {
+        if (requestStrictPriority(eligibleQueues() & trafficClass & ~etsQueues)
+                || requestDeficitRoundRobin(eligibleQueues() & trafficClass & etsQueues)) {
             return true;
         }
     }
-    //Try to request any packet
-    for (auto it = tGates.rbegin(); it != tGates.rend(); it++) {
-        TransmissionGate* transmissionGate = *it;
-        if (!transmissionGate->isEmpty()) {
-            transmissionGate->requestPacket();
+    return false;
+}
+
+int TransmissionSelection::highestReadyQueue(uint64_t candidates) {
+    while (candidates) {
+        int index = highestQueue(candidates);
+        if (!tGates[index]->isEmpty()) {
+            return index;
+        }
+        deactivateQueue(index);
+        candidates &= ~(UINT64_C(1) << index);
+    }
+    return -1;
+}
+
+bool TransmissionSelection::requestStrictPriority(uint64_t candidates) {
+    int index = highestReadyQueue(candidates);
+    if (index < 0) {
+        return false;
+    }
+    tGates[index]->requestPacket();
+    return true;
+}
+
+bool TransmissionSelection::requestDeficitRoundRobin(uint64_t candidates) {
+    while (candidates) {
+        // Start the turn of the next queue if the current one is over
+        if (etsTurn < 0 || !(candidates & (UINT64_C(1) << etsTurn))) {
+            etsTurn = nextQueue(candidates, etsTurn + 1);
+            etsDeficits[etsTurn] += etsQuanta[etsTurn];
+        }
+        if (tGates[etsTurn]->isEmpty()) {
+            deactivateQueue(etsTurn);
+            candidates &= ~(UINT64_C(1) << etsTurn);
+        } else if (etsDeficits[etsTurn] > 0) {
+            tGates[etsTurn]->requestPacket();
             return true;
+        } else {
+            // The quantum is not smaller than a frame, so the next turn of
+            // this queue starts with a positive deficit again.
+            etsTurn = nextQueue(candidates, etsTurn + 1);
+            etsDeficits[etsTurn] += etsQuanta[etsTurn];
         }
     }
     return false;
 }
 
+void TransmissionSelection::deactivateQueue(int index) {
+    activeQueues &= ~(UINT64_C(1) << index);
+    // Like in deficit round robin, an idle queue doesn't save up credit.
+    if (!etsDeficits.empty() && etsDeficits[index] > 0) {
+        etsDeficits[index] = 0;
+    }
+}
+
+int TransmissionSelection::highestQueue(uint64_t bitmap) {
+    return bitmap ? 63 - __builtin_clzll(bitmap) : -1;
+}
+
+int TransmissionSelection::nextQueue(uint64_t bitmap, int index) {
+    if (!bitmap) {
+        return -1;
+    }
+    uint64_t upper = index < 64 ? bitmap & (~UINT64_C(0) << index) : 0;
+    return __builtin_ctzll(upper ? upper : bitmap);
+}
+
 void TransmissionSelection::handleRequestPacketEvent() {
     EV_TRACE << getFullPath() << ": Handle request-packet-event." << endl;
 
@@ -129,12 +438,11 @@ void TransmissionSelection::handleRequestPacketEvent() {
     ASSERT(!packetRequestedFromUs && !packetRequestedFromInputs);
 
     packetRequestedFromUs = true;
-    packetRequestedFromInputs = true;
 
-    // Try to request a packet from inputs if possible
-    bool success = schedulePacket();
-    if (success) {
-        packetRequestedFromInputs = false;
+    // Serve prefetched packet or try to request a packet from inputs if
+    // possible
+    if (servePacketRequest()) {
+        prefetchPackets();
     }
 }
 
@@ -148,19 +456,61 @@ void TransmissionSelection::handlePacketEnqueuedEvent() {
         }
     } else if (!packetRequestedFromUs) {
         notifyPacketEnqueued();
+        prefetchPackets();
     }
 }
 
 void TransmissionSelection::packetEnqueued(TransmissionGate* transmissionGate) {
     Enter_Method("packetEnqueued()");
 
+    activeQueues |= UINT64_C(1) << transmissionGate->getIndex();
+
     cancelEvent(&packetEnqueuedMsg);
     scheduleAt(simTime(), &packetEnqueuedMsg);
 }
 
+void TransmissionSelection::gateClosed(TransmissionGate* transmissionGate) {
+    Enter_Method_Silent();
+
+    deactivateQueue(transmissionGate->getIndex());
+
+    // Hand frames prefetched from this gate back to their queue
+    requeuePrefetchedPackets(transmissionGate->getIndex());
+}
+
+void TransmissionSelection::setPausedQueues(uint64_t queues) {
+    Enter_Method_Silent();
+
+    uint64_t paused = queues & ~pausedQueues;
+    uint64_t resumed = pausedQueues & ~queues;
+    pausedQueues = queues;
+
+    // Frames prefetched from paused queues must not be sent
+    for (uint64_t bits = paused; bits; bits &= bits - 1) {
+        requeuePrefetchedPackets(__builtin_ctzll(bits));
+    }
+
+    // Resumed queues might hold frames, like after a packet-enqueued-event
+    if (resumed) {
+        activeQueues |= resumed;
+        cancelEvent(&packetEnqueuedMsg);
+        scheduleAt(simTime(), &packetEnqueuedMsg);
+    }
+}
+
 void TransmissionSelection::requestPacket() {
     Enter_Method("requestPacket()");
 
+    // Serve a prefetched frame right away, without a request-packet-event
+    if (!packetRequestedFromUs && !prefetchedPackets.empty()
+            && !requestPacketMsg.isScheduled()) {
+        packetRequestedFromUs = true;
+        if (servePacketRequest()) {
+            prefetchPackets();
+        }
+        return;
+    }
+
     cancelEvent(&requestPacketMsg);
     scheduleAt(simTime(), &requestPacketMsg);
 }
@@ -170,12 +520,7 @@ int TransmissionSelection::getNumPendingRequests() {
 }
 
 bool TransmissionSelection::isEmpty() {
-    for (auto transmissionGate : tGates) {
-        if (!transmissionGate->isEmpty()) {
-            return false;
-        }
-    }
-    return true;
+    return !hasValidPrefetchedPacket(false) && highestReadyQueue(eligibleQueues()) < 0;
 }
 
 void TransmissionSelection::removePendingRequests() {
@@ -207,13 +552,11 @@ void TransmissionSelection::notifyPacketEnqueued() {
 }
 
 bool TransmissionSelection::hasExpressPacketEnqueued() {
-    for (auto transmissionGate : tGates) {
-        if (transmissionGate->isExpressQueue()
-                && !transmissionGate->isEmpty()) {
-            return true;
-        }
+    if (!queueBitmapsInitialized) {
+        initializeQueueBitmaps();
     }
-    return false;
+    return hasValidPrefetchedPacket(true)
+            || highestReadyQueue(eligibleQueues() & expressQueues) >= 0;
 }
 
 } // namespace nesting
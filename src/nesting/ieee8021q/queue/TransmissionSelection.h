@@ -19,6 +19,7 @@
 #include <omnetpp.h>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
 
 #include "nesting/ieee8021q/queue/gating/TransmissionGate.h"
 
@@ -35,6 +36,21 @@ class TransmissionGate;
  * See the NED file for a detailed description.
  */
 class TransmissionSelection: public IPassiveQueue, public cSimpleModule {
+public:
+    /**
+     * Selection among the queues that are ready for transmission.
+     */
+    enum SelectionMode {
+        /** Serve the ready queue with the highest index. */
+        STRICT_PRIORITY,
+        /**
+         * Enhanced transmission selection: queues with a weight share the
+         * bandwidth left by strict priority queues by deficit weighted round
+         * robin.
+         */
+        ETS
+    };
+
 protected:
     /**
      * This data-structure keeps references to the transmission-gates that
@@ -86,6 +102,80 @@ protected:
      */
     cMessage packetEnqueuedMsg = cMessage("packetEnqueued");
 
+    /** Selection mode. */
+    SelectionMode selectionMode = STRICT_PRIORITY;
+
+    /**
+     * Bitmap of queues that might be ready for transmission, bit i stands for
+     * the transmission gate with index i. A bit is set when the transmission
+     * gate signals a packet-enqueued-event, which it does on enqueue, gate
+     * opening, hold release and credit changes of the transmission selection
+     * algorithm. It is cleared when the gate closes and when the queue is
+     * found empty during selection, so every ready queue is always included.
+     */
+    uint64_t activeQueues = 0;
+
+    /**
+     * Bitmap of queues paused by priority-based flow control (IEEE 802.1Qbb).
+     * Paused queues stay active, but are masked out of the selection.
+     */
+    uint64_t pausedQueues = 0;
+
+    /**
+     * Bitmap of express queues, initialized on the first selection. Masking
+     * activeQueues with it, or its complement, yields the express and
+     * preemptable candidates.
+     */
+    uint64_t expressQueues = 0;
+
+    /** Bitmap of queues that take part in deficit weighted round robin. */
+    uint64_t etsQueues = 0;
+
+    /** True once the express queue bitmap is initialized. */
+    bool queueBitmapsInitialized = false;
+
+    /** Bits credited to a queue at the start of its turn. */
+    std::vector<int64_t> etsQuanta;
+
+    /**
+     * Deficit counter per queue in bits. Frames are charged after they are
+     * received, so the deficit might become negative.
+     */
+    std::vector<int64_t> etsDeficits;
+
+    /** Queue whose round robin turn is in progress, -1 if none. */
+    int etsTurn = -1;
+
+    /**
+     * A frame taken from a transmission gate ahead of a packet request of the
+     * Mac module that is not yet passed to the Mac module.
+     */
+    struct PrefetchedPacket {
+        Packet* packet;
+        int gateId;
+    };
+
+    /**
+     * Maximum number of frames that are taken from the transmission gates
+     * ahead of a packet request of the Mac module, e.g. while the Mac module
+     * is transmitting. Zero disables prefetching.
+     */
+    int prefetchLimit = 0;
+
+    /** Prefetched frames in order of arrival. */
+    std::vector<PrefetchedPacket> prefetchedPackets;
+
+    /**
+     * This flag is set if a packet was requested from a transmission gate and
+     * has not been received yet.
+     */
+    bool inputRequestInFlight = false;
+
+    long numPacketsPrefetched = 0;
+
+    /** Number of prefetched frames handed back to their queues. */
+    long numPrefetchedPacketsRequeued = 0;
+
 protected:
     /**
      * @see cSimpleModule::initialize()
@@ -102,6 +192,11 @@ protected:
      */
     virtual void refreshDisplay() const override;
 
+    /**
+     * @see cSimpleModule::finish()
+     */
+    virtual void finish() override;
+
     /**
      * This method tries to request a packet from the highest priority input
      * module (transmission gate). If no packet is available for transmission,
@@ -111,6 +206,111 @@ protected:
      */
     virtual bool schedulePacket();
 
+    /**
+     * Requests a packet from the highest priority queue that is ready for
+     * transmission, express queues first.
+     *
+     * @return True if a packet was requested, false otherwise.
+     */
+    virtual bool scheduleStrictPriorityPacket();
+
+    /**
+     * Requests a packet according to enhanced transmission selection: express
+     * queues first, within each class strict priority queues before queues
+     * with a weight.
+     *
+     * @return True if a packet was requested, false otherwise.
+     */
+    virtual bool scheduleEtsPacket();
+
+    /**
+     * Returns the highest priority queue in the given bitmap of active queues
+     * that is ready for transmission, or -1 if there is none. Queues found
+     * empty are deactivated, so each queue is checked once per activation.
+     */
+    virtual int highestReadyQueue(uint64_t candidates);
+
+    /**
+     * Requests a packet from the highest priority ready queue in the given
+     * bitmap of active queues. Queues found empty are deactivated.
+     */
+    virtual bool requestStrictPriority(uint64_t candidates);
+
+    /**
+     * Requests a packet by deficit weighted round robin among the given
+     * bitmap of active queues. Queues found empty are deactivated.
+     */
+    virtual bool requestDeficitRoundRobin(uint64_t candidates);
+
+    /** Removes a queue from the active bitmap. */
+    virtual void deactivateQueue(int index);
+
+    /** Returns the active queues that aren't paused. */
+    uint64_t eligibleQueues() const { return activeQueues & ~pausedQueues; }
+
+    /** Reads the ETS weights and quanta from the NED parameters. */
+    virtual void initializeEts();
+
+    /** Initializes the express queue bitmap. */
+    virtual void initializeQueueBitmaps();
+
+    /**
+     * Returns the queue strict priority selection would request a packet
+     * from, or -1 if no queue is ready.
+     */
+    virtual int selectStrictPriorityQueue();
+
+    /**
+     * Takes frames from the transmission gates ahead of a packet request of
+     * the Mac module until prefetchLimit frames are buffered, if no request
+     * is in flight. Frames are taken in selection order by direct method
+     * calls, so they need no request-packet events. Stops at the first
+     * selected queue that doesn't support prefetching.
+     */
+    virtual void prefetchPackets();
+
+    /**
+     * Returns the index of the prefetched frame that would be selected first,
+     * or -1 if there is none.
+     */
+    virtual int bestPrefetchedPacket(bool expressOnly);
+
+    /**
+     * Returns true if a prefetched frame can still be transmitted: its gate
+     * allows the frame and no frame that would have been selected before it
+     * became ready in the meantime.
+     */
+    virtual bool isPrefetchedPacketValid(const PrefetchedPacket& prefetched);
+
+    /**
+     * Returns the index of the prefetched frame to pass on next, or -1 if
+     * there is none. Frames that are no longer valid are handed back to
+     * their queues.
+     */
+    virtual int findValidPrefetchedPacket(bool expressOnly);
+
+    /**
+     * Hands all frames prefetched from a transmission gate back to its queue.
+     */
+    virtual void requeuePrefetchedPackets(int gateId);
+
+    /** Returns true if a valid prefetched frame is available. */
+    virtual bool hasValidPrefetchedPacket(bool expressOnly);
+
+    /**
+     * Serves the pending packet request of the Mac module with a prefetched
+     * frame or requests a frame from the transmission gates.
+     *
+     * @return True if a frame was passed to the Mac module.
+     */
+    virtual bool servePacketRequest();
+
+    /**
+     * Passes a frame to the Mac module. A prefetched frame is committed to
+     * its queue before.
+     */
+    virtual void sendPacket(Packet* packet, int gateId, bool prefetched);
+
     /**
      * This method handles a request-packet-event. This means possibly
      * requesting a packet from one of the input modules or if that is not
@@ -130,6 +330,15 @@ protected:
     virtual void notifyPacketEnqueued();
 
 public:
+    /** Returns the index of the most significant bit set, -1 if none. */
+    static int highestQueue(uint64_t bitmap);
+
+    /**
+     * Returns the index of the first bit set at or after a given index,
+     * wrapping around. Returns -1 if no bit is set.
+     */
+    static int nextQueue(uint64_t bitmap, int index);
+
     TransmissionSelection();
 
     virtual ~TransmissionSelection();
@@ -140,6 +349,27 @@ public:
      */
     virtual void packetEnqueued(TransmissionGate* transmissioGate);
 
+    /**
+     * This method is called by an transmission-gate-input-module when its
+     * gate closes, so that it is no longer considered for selection.
+     */
+    virtual void gateClosed(TransmissionGate* transmissionGate);
+
+    /**
+     * Sets the queues paused by priority-based flow control, bit i stands for
+     * the queue with index i. A frame already passed to the Mac module is
+     * still sent, frames prefetched from paused queues are handed back.
+     */
+    virtual void setPausedQueues(uint64_t queues);
+
+    virtual uint64_t getPausedQueues() const { return pausedQueues; }
+
+    /** Returns the bitmap of queues that might be ready for transmission. */
+    virtual uint64_t getActiveQueues() const { return activeQueues; }
+
+    /** Returns the deficit counter of a queue in bits, ETS mode only. */
+    virtual int64_t getEtsDeficit(int index) const { return etsDeficits.at(index); }
+
     /**
      * @see IPassiveQueue::requestPacket()
      */
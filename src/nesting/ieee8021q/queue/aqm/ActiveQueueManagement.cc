@@ -0,0 +1,39 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/aqm/ActiveQueueManagement.h"
+#include "nesting/ieee8021q/queue/aqm/RedQueueManagement.h"
+#include "nesting/ieee8021q/queue/aqm/CoDelQueueManagement.h"
+#include "nesting/ieee8021q/queue/aqm/PieQueueManagement.h"
+
+#include <cstring>
+
+namespace nesting {
+
+ActiveQueueManagement* ActiveQueueManagement::create(const char* name,
+        cComponent* owner) {
+    if (strcmp(name, "none") == 0) {
+        return nullptr;
+    } else if (strcmp(name, "red") == 0) {
+        return new RedQueueManagement(owner);
+    } else if (strcmp(name, "codel") == 0) {
+        return new CoDelQueueManagement(owner);
+    } else if (strcmp(name, "pie") == 0) {
+        return new PieQueueManagement(owner);
+    }
+    throw cRuntimeError("Unknown active queue management \"%s\".", name);
+}
+
+} // namespace nesting
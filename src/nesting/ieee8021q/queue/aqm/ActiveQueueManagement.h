@@ -0,0 +1,72 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_AQM_ACTIVEQUEUEMANAGEMENT_H_
+#define NESTING_IEEE8021Q_QUEUE_AQM_ACTIVEQUEUEMANAGEMENT_H_
+
+#include <omnetpp.h>
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Base class of active queue management policies of the ~LengthAwareQueue.
+ * A policy decides whether a frame is dropped when it is enqueued or
+ * dequeued. Policies keep constant state per queue and read their
+ * parameters from the owning queue module.
+ */
+class ActiveQueueManagement {
+protected:
+    /** Queue module owning this policy, used for parameters and RNG. */
+    cComponent* owner;
+
+public:
+    ActiveQueueManagement(cComponent* owner) : owner(owner) {}
+
+    virtual ~ActiveQueueManagement() {}
+
+    /**
+     * Creates the policy with the given name ("red", "codel" or "pie").
+     * Returns nullptr for "none".
+     */
+    static ActiveQueueManagement* create(const char* name, cComponent* owner);
+
+    /**
+     * Called for every frame arriving at the queue.
+     *
+     * @param queueLength Number of frames in the queue before the arrival.
+     * @return            True if the frame should be dropped.
+     */
+    virtual bool shouldDropOnEnqueue(size_t queueLength) {
+        return false;
+    }
+
+    /**
+     * Called for every frame leaving the queue.
+     *
+     * @param sojournTime Time the frame spent in the queue.
+     * @param canDrop     False if the frame must not be dropped, e.g. because
+     *                    no other frame could be sent instead.
+     * @return            True if the frame should be dropped.
+     */
+    virtual bool shouldDropOnDequeue(simtime_t sojournTime, bool canDrop) {
+        return false;
+    }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_AQM_ACTIVEQUEUEMANAGEMENT_H_ */
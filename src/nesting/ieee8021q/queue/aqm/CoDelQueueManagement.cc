@@ -0,0 +1,70 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/aqm/CoDelQueueManagement.h"
+
+#include <cmath>
+
+namespace nesting {
+
+CoDelQueueManagement::CoDelQueueManagement(cComponent* owner) :
+        ActiveQueueManagement(owner) {
+    target = owner->par("codelTarget");
+    interval = owner->par("codelInterval");
+    if (target <= SimTime::ZERO || interval <= SimTime::ZERO) {
+        throw cRuntimeError("Parameters codelTarget and codelInterval must be greater than zero.");
+    }
+}
+
+simtime_t CoDelQueueManagement::controlLaw(simtime_t time) const {
+    return time + interval / std::sqrt(static_cast<double>(count));
+}
+
+bool CoDelQueueManagement::shouldDropOnDequeue(simtime_t sojournTime,
+        bool canDrop) {
+    simtime_t now = simTime();
+
+    bool okToDrop = false;
+    if (sojournTime < target || !canDrop) {
+        // Went below target or too few frames queued to drop
+        firstAboveTime = SimTime::ZERO;
+    } else if (firstAboveTime == SimTime::ZERO) {
+        firstAboveTime = now + interval;
+    } else if (now >= firstAboveTime) {
+        okToDrop = true;
+    }
+
+    if (dropping) {
+        if (!okToDrop) {
+            dropping = false;
+        } else if (now >= dropNext) {
+            count++;
+            dropNext = controlLaw(dropNext);
+            return true;
+        }
+    } else if (okToDrop) {
+        // Start dropping, reuse the former drop rate if dropping state was
+        // left only recently.
+        dropping = true;
+        long delta = count - lastCount;
+        count = delta > 1 && now - dropNext < interval * 16 ? delta : 1;
+        lastCount = count;
+        dropNext = controlLaw(now);
+        return true;
+    }
+    return false;
+}
+
+} // namespace nesting
@@ -0,0 +1,67 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_AQM_CODELQUEUEMANAGEMENT_H_
+#define NESTING_IEEE8021Q_QUEUE_AQM_CODELQUEUEMANAGEMENT_H_
+
+#include <omnetpp.h>
+
+#include "nesting/ieee8021q/queue/aqm/ActiveQueueManagement.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Controlled delay according to RFC 8289. Frames are dropped on departure
+ * once the sojourn time stayed above codelTarget for at least codelInterval,
+ * with the time between drops decreasing with the inverse square root of the
+ * number of drops.
+ */
+class CoDelQueueManagement: public ActiveQueueManagement {
+protected:
+    /** Acceptable standing queue delay. */
+    simtime_t target;
+
+    /** Sliding window in which the minimum delay must exceed the target. */
+    simtime_t interval;
+
+    /** Time when the sojourn time will have been above target for interval. */
+    simtime_t firstAboveTime;
+
+    /** Time of the next drop in dropping state. */
+    simtime_t dropNext;
+
+    /** Drops since entering dropping state. */
+    long count = 0;
+
+    /** Drop count when last entering dropping state. */
+    long lastCount = 0;
+
+    /** True while in dropping state. */
+    bool dropping = false;
+
+    /** Returns the time of the next drop after the given point in time. */
+    virtual simtime_t controlLaw(simtime_t time) const;
+
+public:
+    CoDelQueueManagement(cComponent* owner);
+
+    virtual bool shouldDropOnDequeue(simtime_t sojournTime, bool canDrop) override;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_AQM_CODELQUEUEMANAGEMENT_H_ */
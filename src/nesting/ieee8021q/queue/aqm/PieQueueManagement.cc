@@ -0,0 +1,108 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/aqm/PieQueueManagement.h"
+
+#include <algorithm>
+
+namespace nesting {
+
+PieQueueManagement::PieQueueManagement(cComponent* owner) :
+        ActiveQueueManagement(owner) {
+    target = owner->par("pieTarget");
+    updateInterval = owner->par("pieUpdateInterval");
+    alpha = owner->par("pieAlpha");
+    beta = owner->par("pieBeta");
+    maxBurst = owner->par("pieMaxBurst");
+    if (target <= SimTime::ZERO || updateInterval <= SimTime::ZERO) {
+        throw cRuntimeError("Parameters pieTarget and pieUpdateInterval must be greater than zero.");
+    }
+    burstAllowance = maxBurst;
+    nextUpdate = simTime() + updateInterval;
+}
+
+void PieQueueManagement::updateProbability() {
+    double delay = currentDelay.dbl();
+    double previousDelay = oldDelay.dbl();
+
+    // Scale the gains down for small probabilities (RFC 8033, 5.2)
+    double scale = 1;
+    if (dropProbability < 0.000001) {
+        scale = 1.0 / 2048;
+    } else if (dropProbability < 0.00001) {
+        scale = 1.0 / 512;
+    } else if (dropProbability < 0.0001) {
+        scale = 1.0 / 128;
+    } else if (dropProbability < 0.001) {
+        scale = 1.0 / 32;
+    } else if (dropProbability < 0.01) {
+        scale = 1.0 / 8;
+    } else if (dropProbability < 0.1) {
+        scale = 1.0 / 2;
+    }
+    double delta = scale * (alpha * (delay - target.dbl())
+            + beta * (delay - previousDelay));
+    if (dropProbability >= 0.1 && delta > 0.02) {
+        delta = 0.02;
+    }
+    dropProbability += delta;
+    if (delay == 0 && previousDelay == 0) {
+        dropProbability *= 0.98;
+    }
+    if (delay > 0.25) {
+        dropProbability += 0.02;
+    }
+    dropProbability = std::min(1.0, std::max(0.0, dropProbability));
+
+    burstAllowance = std::max(SimTime::ZERO, burstAllowance - updateInterval);
+    if (dropProbability == 0 && currentDelay < target / 2 && oldDelay < target / 2) {
+        burstAllowance = maxBurst;
+    }
+    oldDelay = currentDelay;
+}
+
+bool PieQueueManagement::shouldDropOnEnqueue(size_t queueLength) {
+    simtime_t now = simTime();
+    if (queueLength == 0) {
+        currentDelay = SimTime::ZERO;
+    }
+    if (now >= nextUpdate) {
+        // Missed updates while idle are not caught up one by one
+        updateProbability();
+        nextUpdate += updateInterval;
+        if (nextUpdate <= now) {
+            nextUpdate = now + updateInterval;
+        }
+    }
+
+    if (burstAllowance > SimTime::ZERO) {
+        return false;
+    }
+    if (oldDelay < target / 2 && dropProbability < 0.2) {
+        return false;
+    }
+    if (queueLength < 2) {
+        return false;
+    }
+    return owner->uniform(0, 1) < dropProbability;
+}
+
+bool PieQueueManagement::shouldDropOnDequeue(simtime_t sojournTime,
+        bool canDrop) {
+    currentDelay = sojournTime;
+    return false;
+}
+
+} // namespace nesting
@@ -0,0 +1,70 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_AQM_PIEQUEUEMANAGEMENT_H_
+#define NESTING_IEEE8021Q_QUEUE_AQM_PIEQUEUEMANAGEMENT_H_
+
+#include <omnetpp.h>
+
+#include "nesting/ieee8021q/queue/aqm/ActiveQueueManagement.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Proportional integral controller enhanced according to RFC 8033. Frames
+ * are dropped on arrival with a probability that is adjusted every
+ * pieUpdateInterval based on the deviation of the queueing delay from
+ * pieTarget. The queueing delay is the sojourn time of the last departed
+ * frame. The probability is updated lazily on arrival instead of by a timer.
+ */
+class PieQueueManagement: public ActiveQueueManagement {
+protected:
+    simtime_t target;
+    simtime_t updateInterval;
+    double alpha;
+    double beta;
+    simtime_t maxBurst;
+
+    /** Current drop probability. */
+    double dropProbability = 0;
+
+    /** Queueing delay of the last departed frame. */
+    simtime_t currentDelay;
+
+    /** Queueing delay at the last probability update. */
+    simtime_t oldDelay;
+
+    /** Time of the next probability update. */
+    simtime_t nextUpdate;
+
+    /** Remaining time in which bursts are let through without drops. */
+    simtime_t burstAllowance;
+
+    /** Recalculates the drop probability. */
+    virtual void updateProbability();
+
+public:
+    PieQueueManagement(cComponent* owner);
+
+    virtual bool shouldDropOnEnqueue(size_t queueLength) override;
+
+    virtual bool shouldDropOnDequeue(simtime_t sojournTime, bool canDrop) override;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_AQM_PIEQUEUEMANAGEMENT_H_ */
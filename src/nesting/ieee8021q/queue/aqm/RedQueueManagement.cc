@@ -0,0 +1,66 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/aqm/RedQueueManagement.h"
+
+namespace nesting {
+
+RedQueueManagement::RedQueueManagement(cComponent* owner) :
+        ActiveQueueManagement(owner) {
+    weight = owner->par("redWeight");
+    minThreshold = owner->par("redMinThreshold");
+    maxThreshold = owner->par("redMaxThreshold");
+    maxProbability = owner->par("redMaxProbability");
+    if (weight <= 0 || weight > 1) {
+        throw cRuntimeError("Parameter redWeight must be in the range (0,1].");
+    }
+    if (minThreshold < 0 || maxThreshold <= minThreshold) {
+        throw cRuntimeError("RED thresholds must satisfy 0 <= redMinThreshold < redMaxThreshold.");
+    }
+    if (maxProbability <= 0 || maxProbability > 1) {
+        throw cRuntimeError("Parameter redMaxProbability must be in the range (0,1].");
+    }
+}
+
+bool RedQueueManagement::shouldDropOnEnqueue(size_t queueLength) {
+    averageQueueLength = (1 - weight) * averageQueueLength + weight * queueLength;
+
+    if (averageQueueLength < minThreshold) {
+        count = -1;
+        return false;
+    }
+    if (averageQueueLength >= maxThreshold) {
+        count = 0;
+        return true;
+    }
+
+    // Spread drops evenly by increasing the probability with the number of
+    // frames accepted since the last drop.
+    count++;
+    double probability = maxProbability * (averageQueueLength - minThreshold)
+            / (maxThreshold - minThreshold);
+    if (count * probability < 1) {
+        probability /= 1 - count * probability;
+    } else {
+        probability = 1;
+    }
+    if (owner->uniform(0, 1) < probability) {
+        count = 0;
+        return true;
+    }
+    return false;
+}
+
+} // namespace nesting
@@ -0,0 +1,61 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_AQM_REDQUEUEMANAGEMENT_H_
+#define NESTING_IEEE8021Q_QUEUE_AQM_REDQUEUEMANAGEMENT_H_
+
+#include <omnetpp.h>
+
+#include "nesting/ieee8021q/queue/aqm/ActiveQueueManagement.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Random early detection (Floyd and Jacobson, 1993). Frames are dropped on
+ * arrival with a probability that grows linearly with the exponentially
+ * weighted average queue length between redMinThreshold and
+ * redMaxThreshold. The average is updated on every arrival.
+ */
+class RedQueueManagement: public ActiveQueueManagement {
+protected:
+    /** Weight of the current queue length in the average. */
+    double weight;
+
+    /** Average queue length in frames below which no frame is dropped. */
+    double minThreshold;
+
+    /** Average queue length in frames above which all frames are dropped. */
+    double maxThreshold;
+
+    /** Drop probability at maxThreshold. */
+    double maxProbability;
+
+    /** Average queue length in frames. */
+    double averageQueueLength = 0;
+
+    /** Frames accepted since the last drop, -1 below minThreshold. */
+    long count = -1;
+
+public:
+    RedQueueManagement(cComponent* owner);
+
+    virtual bool shouldDropOnEnqueue(size_t queueLength) override;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_AQM_REDQUEUEMANAGEMENT_H_ */
@@ -15,16 +15,26 @@
 
 #include "nesting/ieee8021q/queue/framePreemption/LengthAwareQueue.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "inet/common/packet/Packet.h"
+
+#include "nesting/common/LatencyTag_m.h"
+
 namespace nesting {
 
 Define_Module(LengthAwareQueue);
 
 LengthAwareQueue::~LengthAwareQueue() {
     cancelEvent(&requestPacketMsg);
-    while (!queue.isEmpty()) {
-        delete queue.pop();
+    // No buffer accounting on teardown, the buffer manager and the Mac
+    // modules it notifies may already be deleted
+    for (size_t i = 0; i < ringLength; i++) {
+        delete ring[(ringHead + i) % ring.size()].packet;
     }
-    queue.clear();
+    ringLength = 0;
+    delete aqm;
 }
 
 void LengthAwareQueue::initialize() {
@@ -35,28 +45,72 @@ void LengthAwareQueue::initialize() {
     queueingTimeSignal = registerSignal("queueingTime");
     queueLengthSignal = registerSignal("queueLength");
 
-    queue.setName(par("queueName"));
     availableBufferCapacity = par("bufferCapacity");
+    if (availableBufferCapacity < 0) {
+        throw cRuntimeError("Parameter bufferCapacity must not be negative.");
+    }
     expressQueue = par("expressQueue");
+
+    const char* bufferManagerPath = par("bufferManagerModule");
+    uint64_t bufferBound = availableBufferCapacity;
+    if (*bufferManagerPath != '\0') {
+        bufferManager = getModuleFromPar<SharedBufferManager>(
+                par("bufferManagerModule"), this);
+        bufferManagerQueueId = bufferManager->registerQueue(getParentModule(),
+                isVector() ? getIndex() : 0);
+        bufferBound = bufferManager->getBufferSize();
+    }
+
+    // Enough slots for minimum size frames filling the buffer. The ring
+    // starts small, because with a shared buffer the bound is the size of
+    // the whole switch memory.
+    maxRingSize = bufferBound / minFrameBitLength + 1;
+    ring.resize(std::min(maxRingSize, static_cast<size_t>(64)));
+
+    std::string mode = par("statisticsMode").stdstringValue();
+    if (mode == "perPacket") {
+        statisticsMode = StatisticsMode::PER_PACKET;
+    } else if (mode == "sampled") {
+        statisticsMode = StatisticsMode::SAMPLED;
+    } else if (mode == "aggregate") {
+        statisticsMode = StatisticsMode::AGGREGATE;
+    } else {
+        throw cRuntimeError("Unknown statistics mode \"%s\".", mode.c_str());
+    }
+    statisticsSampleInterval = par("statisticsSampleInterval");
+    if (statisticsSampleInterval < 1) {
+        throw cRuntimeError("Parameter statisticsSampleInterval must be at least 1.");
+    }
+    lastQueueLengthChange = simTime();
+
+    const char* aqmName = par("aqm");
+    if (!expressQueue) {
+        aqm = ActiveQueueManagement::create(aqmName, this);
+    } else if (strcmp(aqmName, "none") != 0) {
+        EV_WARN << getFullPath() << ": Active queue management is not applied to express queues." << endl;
+    }
+
     WATCH(numPacketsReceived);
     WATCH(numPacketsDropped);
     WATCH(numPacketsEnqueued);
+    WATCH(numPacketsDequeued);
     WATCH(availableBufferCapacity);
+    WATCH(ringLength);
 
-    //for drop message
-//    EV_INFO << "!!!!!!!!" << std::endl;
-//    EV_INFO << getParentModule()->getFullName() << std::endl;
-//    EV_INFO << getParentModule()->getParentModule()->getFullName() << std::endl;
-//    EV_INFO << getParentModule()->getParentModule()->getParentModule()->getFullName() << std::endl;
-    targetModule =  getParentModule()->getParentModule()->getParentModule()->getSubmodule("relayUnit");
-    EV_INFO << "Drop signal listener: " << targetModule->getFullName() << std::endl;
+    const char* misbehaviorListenerPath = par("misbehaviorListenerModule");
+    if (*misbehaviorListenerPath != '\0') {
+        misbehaviorListener = getModuleFromPar<IMisbehaviorListener>(
+                par("misbehaviorListenerModule"), this);
+    }
 
     // module references
     tsAlgorithm = getModuleFromPar<TSAlgorithm>(
             par("transmissionSelectionAlgorithmModule"), this);
 
     // statistics
-    emit(queueLengthSignal, queue.getLength());
+    if (statisticsMode != StatisticsMode::AGGREGATE) {
+        emit(queueLengthSignal, queueLength());
+    }
 }
 
 void LengthAwareQueue::handleMessage(cMessage* msg) {
@@ -66,67 +120,123 @@ void LengthAwareQueue::handleMessage(cMessage* msg) {
         }
     } else {
         cPacket* packet = check_and_cast<cPacket*>(msg);
-        emit(rcvdPkSignal, packet->getTreeId()); // getting tree id, because it doenn't get changed when packet is copied
         numPacketsReceived++;
+        if (isSampled(numPacketsReceived)) {
+            emit(rcvdPkSignal, packet->getTreeId()); // getting tree id, because it doenn't get changed when packet is copied
+        }
         enqueue(packet);
     }
 }
 
 void LengthAwareQueue::enqueue(cPacket* packet) {
-    if (availableBufferCapacity >= packet->getBitLength()) {
-        emit(enqueuePkSignal, packet->getTreeId());
+    uint64_t bitLength = packet->getBitLength();
+    bool sampled = isSampled(numPacketsReceived);
+    if (aqm != nullptr && !isAqmExempt(packet)
+            && aqm->shouldDropOnEnqueue(queueLength())) {
+        numPacketsDroppedByAqm++;
+        dropPacket(packet);
+    } else if (queueLength() < maxRingSize
+            && reserveSlot() && allocateBuffer(bitLength)) {
+        // Slots of prefetched packets stay reserved for requeuing
         numPacketsEnqueued++;
-        sendDropMessage(packet);
-        queue.insert(packet);
-        availableBufferCapacity -= packet->getBitLength();
+        if (sampled) {
+            emit(enqueuePkSignal, packet->getTreeId());
+        }
+        updateQueueLengthStatistics();
+        pushPacket(BufferedPacket { packet, bitLength, simTime() });
+        ringLength++;
+        maxQueueLength = std::max(maxQueueLength, queueLength());
         handlePacketEnqueuedEvent(packet);
     } else {
+        dropPacket(packet);
+    }
+    if (sampled) {
+        emit(queueLengthSignal, queueLength());
+    }
+}
+
+void LengthAwareQueue::dropPacket(cPacket* packet) {
+    numPacketsDropped++;
+    if (statisticsMode != StatisticsMode::AGGREGATE) {
         emit(dropPkByQueueSignal, packet->getTreeId());
-        numPacketsDropped++;
-        sendDropMessage(packet);
-        handlePacketEnqueuedEvent(packet);
-        delete packet;
     }
-    emit(queueLengthSignal, queue.getLength());
+    if (misbehaviorListener != nullptr) {
+        misbehaviorListener->onMisbehavior(DISCARD,
+                IMisbehaviorListener::getFlowId(packet), this);
+    }
+    delete packet;
 }
 
-void LengthAwareQueue::sendDropMessage(cPacket* packet){
-    char msgname[20];
-    sprintf(msgname, "drop-%ld", packet->getTreeId());
-    MisbehaviorMsg * msg = new MisbehaviorMsg(msgname);
-    msg->setType(MisbehaviorType::DISCARD);
-    msg->setFid(packet->getTreeId());
-    sendDirect(msg, targetModule, "DirectDropIn"); // send directly to the relay unit.
+bool LengthAwareQueue::isAqmExempt(cPacket* packet) const {
+    return IMisbehaviorListener::getFlowId(packet) != IMisbehaviorListener::UNKNOWN_FLOW_ID;
 }
 
 
 cPacket* LengthAwareQueue::dequeue() {
-    if (queue.isEmpty()) {
+    if (ringLength == 0) {
         return nullptr;
     }
-    cPacket* packet = static_cast<cPacket*>(queue.pop());
-    availableBufferCapacity += packet->getBitLength();
-    
-    emit(queueLengthSignal, queue.getLength());
+    updateQueueLengthStatistics();
+    BufferedPacket bufferedPacket = popPacket();
+    releaseBuffer(bufferedPacket.bitLength);
+    ringLength--;
 
-    return packet;
+    return bufferedPacket.packet;
+}
+
+LengthAwareQueue::BufferedPacket LengthAwareQueue::dequeueForTransmission(uint64_t maxBits) {
+    updateQueueLengthStatistics();
+    BufferedPacket bufferedPacket = popPacket();
+    ringLength--;
+
+    // Drop on dequeue only if another frame can be sent instead
+    while (aqm != nullptr) {
+        simtime_t queueingTime = simTime() - bufferedPacket.enqueueTime;
+        bool canDrop = !isAqmExempt(bufferedPacket.packet) && !isEmpty(maxBits);
+        if (!aqm->shouldDropOnDequeue(queueingTime, canDrop) || !canDrop) {
+            break;
+        }
+        numPacketsDroppedByAqm++;
+        releaseBuffer(bufferedPacket.bitLength);
+        dropPacket(bufferedPacket.packet);
+        bufferedPacket = popPacket();
+        ringLength--;
+    }
+    return bufferedPacket;
+}
+
+void LengthAwareQueue::completeDequeue(const BufferedPacket& bufferedPacket) {
+    releaseBuffer(bufferedPacket.bitLength);
+    numPacketsDequeued++;
+
+    simtime_t queueingTime = simTime() - bufferedPacket.enqueueTime;
+    totalQueueingTime += queueingTime;
+    maxQueueingTime = std::max(maxQueueingTime, queueingTime);
+
+    // Latencies of an earlier hop are replaced, the Mac fills in the rest
+    if (inet::Packet* packet = dynamic_cast<inet::Packet*>(bufferedPacket.packet)) {
+        auto latencyTag = packet->addTagIfAbsent<LatencyTag>();
+        latencyTag->setQueueingTime(queueingTime);
+        latencyTag->setMacDelay(SIMTIME_ZERO);
+        latencyTag->setPreemptionDelay(SIMTIME_ZERO);
+    }
+    if (isSampled(numPacketsDequeued)) {
+        emit(dequeuePkSignal, bufferedPacket.packet->getTreeId());
+        emit(queueingTimeSignal, queueingTime);
+        emit(queueLengthSignal, queueLength());
+    }
 }
 
 void LengthAwareQueue::handleRequestPacketEvent(uint64_t maxBits) {
     ASSERT(!isEmpty(maxBits));
 
-    cPacket* nextPacket = static_cast<cPacket*>(queue.front());
     EV_INFO << getFullPath() << ": Packet requested with max length of "
                     << maxBits << "bits. Next packet has "
-                    << static_cast<uint64_t>(nextPacket->getBitLength())
-                    << "bits." << endl;
-
-    cPacket* packetToSend = dequeue();
+                    << frontPacket().bitLength << "bits." << endl;
 
-    emit(dequeuePkSignal, packetToSend->getTreeId());
-    emit(queueingTimeSignal, simTime() - packetToSend->getArrivalTime());
-    
-    send(packetToSend, "out");
+    BufferedPacket bufferedPacket = dequeueForTransmission(maxBits);
+    completeDequeue(bufferedPacket);
+    send(bufferedPacket.packet, "out");
 }
 
 void LengthAwareQueue::handlePacketEnqueuedEvent(cPacket* packet) {
@@ -135,15 +245,13 @@ void LengthAwareQueue::handlePacketEnqueuedEvent(cPacket* packet) {
 }
 
 bool LengthAwareQueue::isEmpty(uint64_t maxBits) {
-    if (queue.isEmpty()) {
+    if (ringLength == 0) {
         return true;
     }
 
-    cPacket* nextPacket = static_cast<cPacket*>(queue.front());
-
     // Overhead 8Byte from preamble
     unsigned preambleSize = 8*8;
-    return static_cast<uint64_t>(nextPacket->getBitLength() + preambleSize) > maxBits;
+    return frontPacket().bitLength + preambleSize > maxBits;
 }
 
 void LengthAwareQueue::requestPacket(uint64_t maxBits) {
@@ -155,5 +263,201 @@ void LengthAwareQueue::requestPacket(uint64_t maxBits) {
 bool LengthAwareQueue::isExpressQueue() {
     return expressQueue;
 }
+
+cPacket* LengthAwareQueue::prefetchPacket(uint64_t maxBits) {
+    Enter_Method("prefetchPacket()");
+    if (isEmpty(maxBits)) {
+        return nullptr;
+    }
+    BufferedPacket bufferedPacket = dequeueForTransmission(maxBits);
+    prefetchedPackets.push_back(bufferedPacket);
+    return bufferedPacket.packet;
+}
+
+void LengthAwareQueue::commitPacket(cPacket* packet) {
+    Enter_Method("commitPacket()");
+    // Packets of a queue are passed on in order
+    updateQueueLengthStatistics();
+    completeDequeue(removePrefetchedPacket(packet, true));
+}
+
+void LengthAwareQueue::requeue(cPacket* packet) {
+    Enter_Method("requeue()");
+    take(packet);
+
+    // Packets of a queue are handed back from the last one
+    BufferedPacket bufferedPacket = removePrefetchedPacket(packet, false);
+    if (!reserveSlot()) {
+        throw cRuntimeError("No slot left to requeue a prefetched packet.");
+    }
+    // Still counted as queued, so the queue length doesn't change
+    pushFrontPacket(bufferedPacket);
+    ringLength++;
+    handlePacketEnqueuedEvent(packet);
+}
+
+cPacket* LengthAwareQueue::holdPacket() {
+    Enter_Method("holdPacket()");
+    if (ringLength == 0) {
+        return nullptr;
+    }
+    BufferedPacket bufferedPacket = popPacket();
+    ringLength--;
+    prefetchedPackets.push_back(bufferedPacket);
+    return bufferedPacket.packet;
+}
+
+bool LengthAwareQueue::releaseHeldPacket(cPacket* packet, bool canDrop) {
+    Enter_Method("releaseHeldPacket()");
+    updateQueueLengthStatistics();
+    BufferedPacket bufferedPacket = removePrefetchedPacket(packet, true);
+
+    // Drop on dequeue only if another frame can be sent instead
+    if (aqm != nullptr) {
+        simtime_t queueingTime = simTime() - bufferedPacket.enqueueTime;
+        canDrop = canDrop && !isAqmExempt(packet);
+        if (aqm->shouldDropOnDequeue(queueingTime, canDrop) && canDrop) {
+            take(packet);
+            numPacketsDroppedByAqm++;
+            releaseBuffer(bufferedPacket.bitLength);
+            dropPacket(packet);
+            return false;
+        }
+    }
+    completeDequeue(bufferedPacket);
+    return true;
+}
+
+void LengthAwareQueue::discardHeldPacket(cPacket* packet) {
+    Enter_Method("discardHeldPacket()");
+    take(packet);
+    updateQueueLengthStatistics();
+    BufferedPacket bufferedPacket = removePrefetchedPacket(packet, true);
+    releaseBuffer(bufferedPacket.bitLength);
+    if (statisticsMode == StatisticsMode::PER_PACKET) {
+        emit(queueLengthSignal, queueLength());
+    }
+    // Counted and reported like any other drop of the queue
+    dropPacket(packet);
+}
+
+LengthAwareQueue::BufferedPacket LengthAwareQueue::removePrefetchedPacket(cPacket* packet, bool fromFront) {
+    size_t size = prefetchedPackets.size();
+    for (size_t i = 0; i < size; i++) {
+        size_t index = fromFront ? i : size - 1 - i;
+        if (prefetchedPackets[index].packet == packet) {
+            BufferedPacket bufferedPacket = prefetchedPackets[index];
+            prefetchedPackets.erase(prefetchedPackets.begin() + index);
+            return bufferedPacket;
+        }
+    }
+    throw cRuntimeError("Packet %s was not handed out by this queue.", packet->getName());
+}
+
+bool LengthAwareQueue::allocateBuffer(uint64_t bitLength) {
+    if (bufferManager != nullptr) {
+        return bufferManager->admit(bufferManagerQueueId, bitLength);
+    }
+    if (availableBufferCapacity < static_cast<long>(bitLength)) {
+        return false;
+    }
+    availableBufferCapacity -= bitLength;
+    return true;
+}
+
+void LengthAwareQueue::releaseBuffer(uint64_t bitLength) {
+    if (bufferManager != nullptr) {
+        bufferManager->release(bufferManagerQueueId, bitLength);
+    } else {
+        availableBufferCapacity += bitLength;
+    }
+}
+
+bool LengthAwareQueue::reserveSlot() {
+    return ringLength < ring.size() || growRing();
+}
+
+void LengthAwareQueue::pushPacket(const BufferedPacket& bufferedPacket) {
+    ring[(ringHead + ringLength) % ring.size()] = bufferedPacket;
+}
+
+void LengthAwareQueue::pushFrontPacket(const BufferedPacket& bufferedPacket) {
+    ringHead = (ringHead + ring.size() - 1) % ring.size();
+    ring[ringHead] = bufferedPacket;
+}
+
+LengthAwareQueue::BufferedPacket LengthAwareQueue::popPacket() {
+    BufferedPacket bufferedPacket = ring[ringHead];
+    ring[ringHead].packet = nullptr;
+    ringHead = (ringHead + 1) % ring.size();
+    return bufferedPacket;
+}
+
+const LengthAwareQueue::BufferedPacket& LengthAwareQueue::frontPacket() const {
+    return ring[ringHead];
+}
+
+bool LengthAwareQueue::growRing() {
+    if (ring.size() >= maxRingSize) {
+        return false;
+    }
+    std::vector<BufferedPacket> grown(std::min(ring.size() * 2, maxRingSize));
+    for (size_t i = 0; i < ringLength; i++) {
+        grown[i] = ring[(ringHead + i) % ring.size()];
+    }
+    ring.swap(grown);
+    ringHead = 0;
+    return true;
+}
+
+size_t LengthAwareQueue::getLength() const {
+    return ringLength;
+}
+
+bool LengthAwareQueue::isSampled(long n) const {
+    switch (statisticsMode) {
+    case StatisticsMode::PER_PACKET:
+        return true;
+    case StatisticsMode::SAMPLED:
+        return n % statisticsSampleInterval == 0;
+    default:
+        return false;
+    }
+}
+
+void LengthAwareQueue::updateQueueLengthStatistics() {
+    simtime_t now = simTime();
+    queueLengthIntegral += queueLength() * (now - lastQueueLengthChange).dbl();
+    lastQueueLengthChange = now;
+}
+
+void LengthAwareQueue::refreshDisplay() const {
+    char buf[80];
+    sprintf(buf, "q: %zu\ndropped: %ld", ringLength, numPacketsDropped);
+    getDisplayString().setTagArg("t", 0, buf);
+}
+
+void LengthAwareQueue::finish() {
+    if (aqm != nullptr) {
+        recordScalar("packets dropped by aqm", numPacketsDroppedByAqm);
+    }
+    if (statisticsMode == StatisticsMode::PER_PACKET) {
+        return;
+    }
+    updateQueueLengthStatistics();
+    simtime_t duration = simTime() - getSimulation()->getWarmupPeriod();
+    recordScalar("packets received", numPacketsReceived);
+    recordScalar("packets enqueued", numPacketsEnqueued);
+    recordScalar("packets dropped", numPacketsDropped);
+    recordScalar("packets dequeued", numPacketsDequeued);
+    recordScalar("max queue length", maxQueueLength);
+    if (duration > SimTime::ZERO) {
+        recordScalar("mean queue length", queueLengthIntegral / duration.dbl());
+    }
+    if (numPacketsDequeued > 0) {
+        recordScalar("mean queueing time", totalQueueingTime / numPacketsDequeued, "s");
+        recordScalar("max queueing time", maxQueueingTime, "s");
+    }
+}
 }
 // namespace nesting
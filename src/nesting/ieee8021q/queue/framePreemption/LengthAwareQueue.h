@@ -17,14 +17,18 @@
 #define __MAIN_LENGTHAWAREQUEUE_H_
 
 #include <omnetpp.h>
+#include <deque>
 #include <list>
+#include <vector>
 
 #include "inet/common/ModuleAccess.h"
 
 #include "nesting/ieee8021q/Ieee8021q.h"
 #include "nesting/ieee8021q/queue/transmissionSelectionAlgorithms/TSAlgorithm.h"
 #include "nesting/ieee8021q/queue/framePreemption/IPreemptableQueue.h"
-#include "nesting/common/misbehavior_m.h"
+#include "nesting/common/IMisbehaviorListener.h"
+#include "nesting/ieee8021q/queue/sharedBuffer/SharedBufferManager.h"
+#include "nesting/ieee8021q/queue/aqm/ActiveQueueManagement.h"
 
 using namespace omnetpp;
 using namespace inet;
@@ -38,6 +42,32 @@ class TSAlgorithm;
  */
 class LengthAwareQueue: public cSimpleModule, public IPreemptableQueue {
 protected:
+    /** Selects which statistics are collected. */
+    enum class StatisticsMode {
+        /** Signals are emitted for every packet. */
+        PER_PACKET,
+        /**
+         * Signals are only emitted for every n-th packet, drops are always
+         * emitted. Aggregated counters are recorded as scalars.
+         */
+        SAMPLED,
+        /** Only aggregated counters are recorded as scalars. */
+        AGGREGATE
+    };
+
+    /** Buffered packet with its cached length and time of enqueuing. */
+    struct BufferedPacket {
+        cPacket* packet;
+        uint64_t bitLength;
+        simtime_t enqueueTime;
+    };
+
+    /**
+     * Minimum length of a frame in the queue. Used to derive the number of
+     * ring slots from the buffer capacity.
+     */
+    static const uint64_t minFrameBitLength = 64 * 8;
+
     /**
      * Reference to transmission-selection-algorithm module
      */
@@ -63,10 +93,49 @@ protected:
 
     uint64_t maxTransmittableBits = 0;
 
+    long numPacketsDequeued = 0;
+
+    /**
+     * Ring buffer of queued packets. It grows on demand up to
+     * maxRingSize.
+     */
+    std::vector<BufferedPacket> ring;
+
+    /**
+     * Upper bound of the ring buffer size, given by the number of minimum
+     * size frames fitting into the buffer capacity.
+     */
+    size_t maxRingSize = 0;
+
     /**
-     * Internal queue datastructure.
+     * Packets handed out by prefetchPacket() or holdPacket() that didn't
+     * leave the queue yet, in the order they were handed out. Their buffer
+     * memory and storage slots stay reserved, so they can always be requeued,
+     * and they count as queued for the statistics. The packets are owned by
+     * the module they were handed to.
      */
-    cQueue queue;
+    std::deque<BufferedPacket> prefetchedPackets;
+
+    /** Index of the first packet in the ring buffer. */
+    size_t ringHead = 0;
+
+    /**
+     * Number of queued packets. Maintained by the callers of the storage
+     * methods below, so subclasses with another storage can use it as well.
+     */
+    size_t ringLength = 0;
+
+    StatisticsMode statisticsMode = StatisticsMode::PER_PACKET;
+
+    /** Every n-th packet emits signals in sampled statistics mode. */
+    long statisticsSampleInterval = 1;
+
+    // aggregated statistics
+    size_t maxQueueLength = 0;
+    simtime_t lastQueueLengthChange;
+    double queueLengthIntegral = 0;
+    simtime_t totalQueueingTime;
+    simtime_t maxQueueingTime;
 
     /**
      * Output gate reference.
@@ -82,7 +151,27 @@ protected:
     simsignal_t queueingTimeSignal;
     simsignal_t queueLengthSignal;
 
-    cModule *targetModule; // relay unit
+    /**
+     * Listener notified about dropped frames. Can be null.
+     */
+    IMisbehaviorListener* misbehaviorListener = nullptr;
+
+    /**
+     * Shared switch memory. If set, the bufferCapacity parameter is ignored
+     * and admission is decided by the buffer manager. Can be null.
+     */
+    SharedBufferManager* bufferManager = nullptr;
+
+    /** Queue id at the buffer manager. */
+    int bufferManagerQueueId = -1;
+
+    /**
+     * Active queue management policy. Null if disabled, which is always the
+     * case for express queues.
+     */
+    ActiveQueueManagement* aqm = nullptr;
+
+    long numPacketsDroppedByAqm = 0;
 
 protected:
     virtual void initialize() override;
@@ -93,11 +182,100 @@ protected:
 
     virtual cPacket* dequeue();
 
+    /**
+     * Removes the next packet for transmission. Active queue management may
+     * drop packets on dequeue before. The buffer memory of the returned
+     * packet is still allocated.
+     */
+    virtual BufferedPacket dequeueForTransmission(uint64_t maxBits);
+
+    /**
+     * Frees the buffer memory of a packet leaving the queue towards the Mac
+     * and records its queueing time. The queue length statistics must be
+     * updated before the packet was removed.
+     */
+    virtual void completeDequeue(const BufferedPacket& bufferedPacket);
+
+    /**
+     * Removes a packet from the prefetched packets, searching from the front
+     * or from the back.
+     */
+    virtual BufferedPacket removePrefetchedPacket(cPacket* packet, bool fromFront);
+
     virtual void handleRequestPacketEvent(uint64_t maxBits);
 
     virtual void handlePacketEnqueuedEvent(cPacket* packet);
 
-    void sendDropMessage(cPacket* packet);
+    /**
+     * Drops a packet and notifies the misbehavior listener.
+     */
+    virtual void dropPacket(cPacket* packet);
+
+    /**
+     * Returns true if active queue management must not drop the packet,
+     * which is the case for frames of scheduled streams, i.e. frames with a
+     * FlowMetaTag.
+     */
+    virtual bool isAqmExempt(cPacket* packet) const;
+
+    /**
+     * Returns true if a packet of the given length fits into the buffer and
+     * allocates the memory in this case.
+     */
+    virtual bool allocateBuffer(uint64_t bitLength);
+
+    /** Frees buffer memory of a dequeued packet. */
+    virtual void releaseBuffer(uint64_t bitLength);
+
+    /**
+     * Returns true if another packet can be stored, growing the storage if
+     * needed.
+     */
+    virtual bool reserveSlot();
+
+    /**
+     * Stores a packet behind all queued packets. A slot must have been
+     * reserved before.
+     */
+    virtual void pushPacket(const BufferedPacket& bufferedPacket);
+
+    /**
+     * Stores a packet so it is the next one to be dequeued. A slot must have
+     * been reserved before.
+     */
+    virtual void pushFrontPacket(const BufferedPacket& bufferedPacket);
+
+    /** Removes the next packet to be dequeued. The queue must not be empty. */
+    virtual BufferedPacket popPacket();
+
+    /** Returns the next packet to be dequeued. The queue must not be empty. */
+    virtual const BufferedPacket& frontPacket() const;
+
+    /**
+     * Doubles the ring buffer size, bounded by maxRingSize.
+     *
+     * @return False if the ring buffer has already reached its maximum size.
+     */
+    virtual bool growRing();
+
+    /**
+     * Returns true if per-packet signals should be emitted for the n-th
+     * packet in the current statistics mode.
+     */
+    virtual bool isSampled(long n) const;
+
+    /**
+     * Integrates the queue length for the time average. Must be called
+     * before the queue length changes.
+     */
+    virtual void updateQueueLengthStatistics();
+
+    /** Returns the number of queued packets including handed out ones. */
+    size_t queueLength() const { return ringLength + prefetchedPackets.size(); }
+
+    virtual void refreshDisplay() const override;
+
+    virtual void finish() override;
 
 public:
     virtual ~LengthAwareQueue();
@@ -107,6 +285,57 @@ public:
     virtual void requestPacket(uint64_t maxBits);
 
     virtual bool isExpressQueue();
+
+    /**
+     * Hands the next packet out right away, without a request-packet event,
+     * or returns nullptr if the queue is empty for maxBits. The packet keeps
+     * its buffer memory until it is passed on with commitPacket() or put back
+     * with requeue(). Used to prefetch frames ahead of the Mac.
+     */
+    virtual cPacket* prefetchPacket(uint64_t maxBits);
+
+    /**
+     * Counts a prefetched packet as dequeued once it is passed to the Mac and
+     * frees its buffer memory.
+     */
+    virtual void commitPacket(cPacket* packet);
+
+    /**
+     * Puts a prefetched packet back to the head of the queue, e.g. because
+     * its gate closed. Its buffer memory is still reserved, so this can't
+     * fail, and its queueing time still counts from its first enqueuing.
+     */
+    virtual void requeue(cPacket* packet);
+
+    /**
+     * Hands the next packet out to a transmission selection algorithm that
+     * holds frames itself, e.g. a shaper, or returns nullptr if the queue is
+     * empty. The packet stays charged to the buffer until it is passed on
+     * with releaseHeldPacket() or discarded with discardHeldPacket(), so the
+     * buffer capacity also bounds the held packets.
+     */
+    virtual cPacket* holdPacket();
+
+    /**
+     * Counts a held packet as dequeued once it is passed to the Mac. Active
+     * queue management on dequeue is applied here, with the queueing time
+     * since enqueuing, and may drop the packet if canDrop is true.
+     *
+     * @return False if the packet was dropped.
+     */
+    virtual bool releaseHeldPacket(cPacket* packet, bool canDrop);
+
+    /**
+     * Frees the buffer memory of a held packet and drops it, so it is
+     * counted and reported to the misbehavior listener like other drops.
+     */
+    virtual void discardHeldPacket(cPacket* packet);
+
+    /**
+     * Returns the number of packets in the queue, without the ones handed
+     * out.
+     */
+    virtual size_t getLength() const;
 };
 
 } // namespace nesting
@@ -0,0 +1,355 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/framePreemption/PerStreamQueue.h"
+
+#include <algorithm>
+
+#include "inet/common/packet/Packet.h"
+#include "inet/linklayer/ethernet/EtherFrame_m.h"
+#include "inet/linklayer/ieee8021q/Ieee8021qHeader_m.h"
+
+namespace nesting {
+
+Define_Module(PerStreamQueue);
+
+PerStreamQueue::~PerStreamQueue() {
+    // The base class destructor can't reach the sub-queues anymore. Like
+    // there, the packets are deleted without buffer accounting.
+    for (Slot& slot : slots) {
+        delete slot.bufferedPacket.packet;
+    }
+    ringLength = 0;
+}
+
+void PerStreamQueue::initialize() {
+    LengthAwareQueue::initialize();
+
+    std::string scheduling = par("streamScheduling").stdstringValue();
+    if (scheduling == "roundRobin") {
+        streamScheduling = StreamScheduling::ROUND_ROBIN;
+    } else if (scheduling == "edf") {
+        streamScheduling = StreamScheduling::EARLIEST_DEADLINE_FIRST;
+    } else {
+        throw cRuntimeError("Unknown stream scheduling \"%s\".", scheduling.c_str());
+    }
+
+    std::string identification = par("streamIdentification").stdstringValue();
+    if (identification == "flowId") {
+        streamIdentification = StreamIdentification::FLOW_ID;
+    } else if (identification == "destination") {
+        streamIdentification = StreamIdentification::DESTINATION;
+    } else {
+        throw cRuntimeError("Unknown stream identification \"%s\".", identification.c_str());
+    }
+
+    numStreams = par("numStreams");
+    if (numStreams < 1) {
+        throw cRuntimeError("Parameter numStreams must be at least 1.");
+    }
+
+    std::vector<std::string> streamIds = cStringTokenizer(par("streamIds")).asVector();
+    if (!streamIds.empty() && streamIdentification != StreamIdentification::FLOW_ID) {
+        throw cRuntimeError("Parameter streamIds requires stream identification by flow id.");
+    }
+    if (streamIds.size() > static_cast<size_t>(numStreams)) {
+        throw cRuntimeError("Parameter streamIds has more entries than numStreams.");
+    }
+    for (size_t i = 0; i < streamIds.size(); i++) {
+        streamSubQueues.push_back({std::stoull(streamIds[i]), static_cast<int>(i)});
+    }
+    std::sort(streamSubQueues.begin(), streamSubQueues.end(),
+            [](const StreamEntry& lhs, const StreamEntry& rhs) {
+                return lhs.streamId < rhs.streamId;
+            });
+    for (size_t i = 1; i < streamSubQueues.size(); i++) {
+        if (streamSubQueues[i].streamId == streamSubQueues[i - 1].streamId) {
+            throw cRuntimeError("Flow id %s is listed twice in parameter streamIds.",
+                    std::to_string(streamSubQueues[i].streamId).c_str());
+        }
+    }
+    streamsConfigured = !streamIds.empty();
+
+    // One more sub-queue for unidentified frames
+    int numSubQueues = numStreams + 1;
+    streamHeads.assign(numSubQueues, -1);
+    streamTails.assign(numSubQueues, -1);
+    nextActiveStreams.assign(numSubQueues, -1);
+    previousActiveStreams.assign(numSubQueues, -1);
+    heapPositions.assign(numSubQueues, -1);
+    deadlineHeap.reserve(numSubQueues);
+
+    simtime_t defaultDeadline = par("defaultDeadline");
+    streamDeadlines.assign(numSubQueues, defaultDeadline);
+    std::vector<double> deadlines = cStringTokenizer(par("streamDeadlines")).asDoubleVector();
+    if (deadlines.size() > static_cast<size_t>(numStreams)) {
+        throw cRuntimeError("Parameter streamDeadlines has more entries than numStreams.");
+    }
+    // Without streamIds, sub-queues are taken by streams in order of arrival
+    if (deadlines.size() > streamIds.size()) {
+        throw cRuntimeError("Parameter streamDeadlines requires a stream in parameter streamIds for every deadline.");
+    }
+    for (size_t i = 0; i < deadlines.size(); i++) {
+        if (deadlines[i] < 0) {
+            throw cRuntimeError("Stream deadlines must not be negative.");
+        }
+        streamDeadlines[i] = deadlines[i];
+    }
+
+    // Packets are kept in the pool of this class instead
+    ring.clear();
+    ring.shrink_to_fit();
+
+    WATCH(numStreamsActive);
+    WATCH(numStreamCollisions);
+    WATCH(numUnlistedStreamFrames);
+}
+
+void PerStreamQueue::finish() {
+    LengthAwareQueue::finish();
+    recordScalar("stream collisions", numStreamCollisions);
+    recordScalar("unlisted stream frames", numUnlistedStreamFrames);
+}
+
+int PerStreamQueue::classify(cPacket* packet) {
+    if (streamIdentification == StreamIdentification::FLOW_ID) {
+        uint64_t flowId = IMisbehaviorListener::getFlowId(packet);
+        if (flowId == IMisbehaviorListener::UNKNOWN_FLOW_ID) {
+            return numStreams;
+        }
+        return streamSubQueue(flowId);
+    }
+
+    inet::Packet* inetPacket = dynamic_cast<inet::Packet*>(packet);
+    if (inetPacket == nullptr) {
+        return numStreams;
+    }
+    const auto& frame = inetPacket->peekAtFront<inet::EthernetMacHeader>();
+    const inet::Ieee8021qHeader* qHeader = frame->getCTag();
+    if (qHeader == nullptr) {
+        qHeader = frame->getSTag();
+    }
+    uint64_t key = frame->getDest().getInt() << 12;
+    if (qHeader != nullptr) {
+        key |= qHeader->getVid();
+    }
+    return streamSubQueue(key);
+}
+
+int PerStreamQueue::streamSubQueue(uint64_t streamId) {
+    auto it = std::lower_bound(streamSubQueues.begin(), streamSubQueues.end(), streamId,
+            [](const StreamEntry& entry, uint64_t id) {
+                return entry.streamId < id;
+            });
+    if (it != streamSubQueues.end() && it->streamId == streamId) {
+        return it->subQueue;
+    }
+    if (streamsConfigured) {
+        numUnlistedStreamFrames++;
+        return numStreams;
+    }
+
+    int subQueue = static_cast<int>(streamSubQueues.size());
+    if (subQueue >= numStreams) {
+        // Fibonacci hashing spreads neighboring ids over the sub-queues
+        subQueue = static_cast<int>((streamId * UINT64_C(0x9E3779B97F4A7C15) >> 32) % numStreams);
+        numStreamCollisions++;
+        EV_WARN << getFullPath() << ": Stream " << streamId << " shares sub-queue " << subQueue
+                << " with another stream, increase numStreams." << endl;
+    }
+    // A stream is inserted once, lookups of its further frames are binary
+    // searches
+    streamSubQueues.insert(it, {streamId, subQueue});
+    return subQueue;
+}
+
+int PerStreamQueue::nextStream() const {
+    if (streamScheduling == StreamScheduling::ROUND_ROBIN) {
+        return activeHead;
+    }
+    return deadlineHeap.empty() ? -1 : deadlineHeap[0];
+}
+
+bool PerStreamQueue::reserveSlot() {
+    if (freeSlot >= 0) {
+        return true;
+    }
+    if (slots.size() >= maxRingSize) {
+        return false;
+    }
+    size_t oldSize = slots.size();
+    size_t newSize = std::min(std::max(oldSize * 2, static_cast<size_t>(64)), maxRingSize);
+    slots.resize(newSize);
+    for (size_t i = oldSize; i < newSize; i++) {
+        slots[i].next = i + 1 < newSize ? static_cast<int>(i + 1) : -1;
+    }
+    freeSlot = static_cast<int>(oldSize);
+    return true;
+}
+
+void PerStreamQueue::pushPacket(const BufferedPacket& bufferedPacket) {
+    int stream = classify(bufferedPacket.packet);
+    int slot = freeSlot;
+    freeSlot = slots[slot].next;
+    slots[slot].bufferedPacket = bufferedPacket;
+    slots[slot].deadline = simTime() + streamDeadlines[stream];
+    slots[slot].next = -1;
+
+    if (streamTails[stream] < 0) {
+        streamHeads[stream] = slot;
+        streamTails[stream] = slot;
+        activateStream(stream, false);
+    } else {
+        slots[streamTails[stream]].next = slot;
+        streamTails[stream] = slot;
+    }
+}
+
+void PerStreamQueue::pushFrontPacket(const BufferedPacket& bufferedPacket) {
+    int stream = classify(bufferedPacket.packet);
+    int slot = freeSlot;
+    freeSlot = slots[slot].next;
+    slots[slot].bufferedPacket = bufferedPacket;
+    // The frame has been selected before, so it is served first again
+    slots[slot].deadline = SimTime::ZERO;
+    slots[slot].next = streamHeads[stream];
+
+    bool wasEmpty = streamHeads[stream] < 0;
+    streamHeads[stream] = slot;
+    if (wasEmpty) {
+        streamTails[stream] = slot;
+    } else {
+        deactivateStream(stream);
+    }
+    activateStream(stream, true);
+}
+
+LengthAwareQueue::BufferedPacket PerStreamQueue::popPacket() {
+    int stream = nextStream();
+    ASSERT(stream >= 0);
+    int slot = streamHeads[stream];
+    BufferedPacket bufferedPacket = slots[slot].bufferedPacket;
+    streamHeads[stream] = slots[slot].next;
+    slots[slot].bufferedPacket.packet = nullptr;
+    slots[slot].next = freeSlot;
+    freeSlot = slot;
+
+    if (streamHeads[stream] < 0) {
+        streamTails[stream] = -1;
+        deactivateStream(stream);
+    } else if (streamScheduling == StreamScheduling::ROUND_ROBIN) {
+        deactivateStream(stream);
+        activateStream(stream, false);
+    } else {
+        // Deadlines within a sub-queue don't decrease
+        siftDown(heapPositions[stream]);
+    }
+    return bufferedPacket;
+}
+
+const LengthAwareQueue::BufferedPacket& PerStreamQueue::frontPacket() const {
+    return slots[streamHeads[nextStream()]].bufferedPacket;
+}
+
+void PerStreamQueue::activateStream(int stream, bool front) {
+    numStreamsActive++;
+    if (streamScheduling == StreamScheduling::EARLIEST_DEADLINE_FIRST) {
+        heapPositions[stream] = static_cast<int>(deadlineHeap.size());
+        deadlineHeap.push_back(stream);
+        siftUp(heapPositions[stream]);
+    } else if (activeHead < 0) {
+        previousActiveStreams[stream] = -1;
+        nextActiveStreams[stream] = -1;
+        activeHead = stream;
+        activeTail = stream;
+    } else if (front) {
+        previousActiveStreams[stream] = -1;
+        nextActiveStreams[stream] = activeHead;
+        previousActiveStreams[activeHead] = stream;
+        activeHead = stream;
+    } else {
+        previousActiveStreams[stream] = activeTail;
+        nextActiveStreams[stream] = -1;
+        nextActiveStreams[activeTail] = stream;
+        activeTail = stream;
+    }
+}
+
+void PerStreamQueue::deactivateStream(int stream) {
+    numStreamsActive--;
+    if (streamScheduling == StreamScheduling::EARLIEST_DEADLINE_FIRST) {
+        int position = heapPositions[stream];
+        int last = static_cast<int>(deadlineHeap.size()) - 1;
+        if (position != last) {
+            swapHeapEntries(position, last);
+        }
+        deadlineHeap.pop_back();
+        heapPositions[stream] = -1;
+        if (position < last) {
+            siftDown(position);
+            siftUp(position);
+        }
+        return;
+    }
+
+    int previous = previousActiveStreams[stream];
+    int next = nextActiveStreams[stream];
+    if (previous < 0) {
+        activeHead = next;
+    } else {
+        nextActiveStreams[previous] = next;
+    }
+    if (next < 0) {
+        activeTail = previous;
+    } else {
+        previousActiveStreams[next] = previous;
+    }
+}
+
+void PerStreamQueue::siftUp(int position) {
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (headDeadline(deadlineHeap[position]) >= headDeadline(deadlineHeap[parent])) {
+            break;
+        }
+        swapHeapEntries(position, parent);
+        position = parent;
+    }
+}
+
+void PerStreamQueue::siftDown(int position) {
+    int size = static_cast<int>(deadlineHeap.size());
+    while (true) {
+        int smallest = position;
+        for (int child = 2 * position + 1; child <= 2 * position + 2 && child < size; child++) {
+            if (headDeadline(deadlineHeap[child]) < headDeadline(deadlineHeap[smallest])) {
+                smallest = child;
+            }
+        }
+        if (smallest == position) {
+            break;
+        }
+        swapHeapEntries(position, smallest);
+        position = smallest;
+    }
+}
+
+void PerStreamQueue::swapHeapEntries(int a, int b) {
+    std::swap(deadlineHeap[a], deadlineHeap[b]);
+    heapPositions[deadlineHeap[a]] = a;
+    heapPositions[deadlineHeap[b]] = b;
+}
+
+} // namespace nesting
@@ -0,0 +1,178 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_PERSTREAMQUEUE_H_
+#define NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_PERSTREAMQUEUE_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "nesting/ieee8021q/queue/framePreemption/LengthAwareQueue.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class PerStreamQueue: public LengthAwareQueue {
+protected:
+    /** Order in which the sub-queues are served. */
+    enum class StreamScheduling {
+        ROUND_ROBIN,
+        EARLIEST_DEADLINE_FIRST
+    };
+
+    /** How frames are assigned to sub-queues. */
+    enum class StreamIdentification {
+        /** By the flow id of the FlowMetaTag. */
+        FLOW_ID,
+        /** By destination MAC address and VLAN id. */
+        DESTINATION
+    };
+
+    /** Sub-queue assigned to a stream. */
+    struct StreamEntry {
+        uint64_t streamId;
+        int subQueue;
+    };
+
+    /** Packet slot of the packet pool. */
+    struct Slot {
+        BufferedPacket bufferedPacket;
+        /** Absolute deadline, only used for earliest deadline first. */
+        simtime_t deadline;
+        /** Next slot of the same sub-queue or of the free list, -1 if none. */
+        int next;
+    };
+
+    StreamScheduling streamScheduling = StreamScheduling::ROUND_ROBIN;
+
+    StreamIdentification streamIdentification = StreamIdentification::FLOW_ID;
+
+    /**
+     * Number of sub-queues for identified streams. Unidentified frames use
+     * an additional sub-queue with index numStreams.
+     */
+    int numStreams = 0;
+
+    /**
+     * Sub-queue of every stream listed in streamIds or seen so far, sorted
+     * by stream id for binary search.
+     */
+    std::vector<StreamEntry> streamSubQueues;
+
+    /**
+     * Whether the streams are listed in the streamIds parameter. Frames of
+     * other streams go into the sub-queue for unidentified frames then.
+     */
+    bool streamsConfigured = false;
+
+    /** Number of frames of streams that are not listed in streamIds. */
+    long numUnlistedStreamFrames = 0;
+
+    /** Number of streams that had to share a sub-queue with another one. */
+    long numStreamCollisions = 0;
+
+    /**
+     * Packet pool shared by all sub-queues. It grows on demand up to
+     * maxRingSize slots.
+     */
+    std::vector<Slot> slots;
+
+    /** First slot of the free list, -1 if none. */
+    int freeSlot = -1;
+
+    /** First and last slot of every sub-queue, -1 if empty. */
+    std::vector<int> streamHeads;
+    std::vector<int> streamTails;
+
+    /** Relative deadline of every sub-queue. */
+    std::vector<simtime_t> streamDeadlines;
+
+    /**
+     * Doubly linked list of non-empty sub-queues in round robin order. The
+     * head is served next.
+     */
+    std::vector<int> nextActiveStreams;
+    std::vector<int> previousActiveStreams;
+    int activeHead = -1;
+    int activeTail = -1;
+
+    /**
+     * Binary min-heap of non-empty sub-queues ordered by the deadline of
+     * their first frame, used for earliest deadline first.
+     */
+    std::vector<int> deadlineHeap;
+
+    /** Position of every sub-queue in the deadline heap, -1 if absent. */
+    std::vector<int> heapPositions;
+
+    long numStreamsActive = 0;
+
+protected:
+    virtual void initialize() override;
+
+    virtual void finish() override;
+
+    /** Returns the sub-queue of a packet. */
+    virtual int classify(cPacket* packet);
+
+    /**
+     * Returns the sub-queue of a stream, assigns one to a stream seen for
+     * the first time unless the streams are configured.
+     */
+    virtual int streamSubQueue(uint64_t streamId);
+
+    /** Returns the sub-queue that is served next, -1 if all are empty. */
+    virtual int nextStream() const;
+
+    virtual bool reserveSlot() override;
+
+    virtual void pushPacket(const BufferedPacket& bufferedPacket) override;
+
+    virtual void pushFrontPacket(const BufferedPacket& bufferedPacket) override;
+
+    virtual BufferedPacket popPacket() override;
+
+    virtual const BufferedPacket& frontPacket() const override;
+
+    /** Makes a sub-queue that became non-empty eligible for service. */
+    virtual void activateStream(int stream, bool front);
+
+    /** Removes an empty sub-queue from service. */
+    virtual void deactivateStream(int stream);
+
+    /** Moves an element of the deadline heap towards the root. */
+    void siftUp(int position);
+
+    /** Moves an element of the deadline heap towards the leaves. */
+    void siftDown(int position);
+
+    /** Returns the deadline of the first frame of a sub-queue. */
+    simtime_t headDeadline(int stream) const {
+        return slots[streamHeads[stream]].deadline;
+    }
+
+    void swapHeapEntries(int a, int b);
+
+public:
+    virtual ~PerStreamQueue();
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_PERSTREAMQUEUE_H_ */
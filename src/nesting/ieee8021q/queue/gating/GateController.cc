@@ -15,10 +15,15 @@
 
 #include "nesting/ieee8021q/queue/gating/GateController.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace nesting {
 
 Define_Module(GateController);
 
+simsignal_t GateController::guardBandSavedSignal = registerSignal("guardBandSaved");
+
 GateController::~GateController() {
     transmissionGates.clear();
     
@@ -54,20 +59,17 @@ void GateController::initialize(int stage) {
             }
         }
 
-        cModule* macMod = getModuleFromPar<cModule>(par("macModule"), this);
+        mac = check_and_cast<ITsnMac*>(getModuleFromPar<cModule>(par("macModule"), this));
 
-        EtherMACFullDuplexPreemptable* macTmp =
-                dynamic_cast<EtherMACFullDuplexPreemptable*>(macMod);
-        if (macTmp != nullptr) {
-            preemptMacModule = check_and_cast<EtherMACFullDuplexPreemptable*>(
-                    macMod);
-            macModule = nullptr;
-        } else {
-            macModule = check_and_cast<inet::EtherMacFullDuplex*>(macMod);
-            preemptMacModule = nullptr;
+        holdAdvance = par("holdAdvance");
+        releaseAdvance = par("releaseAdvance");
+        if (releaseAdvance < SIMTIME_ZERO) {
+            throw cRuntimeError("releaseAdvance must not be negative");
         }
 
         WATCH(scheduleIndex);
+        WATCH(holdPlannedUntil);
+        WATCH(releasePlannedUntil);
     }
     //initialize schedule in second stage when clock is initialized
     else if (stage == INITSTAGE_LINK_LAYER) {
@@ -85,21 +87,9 @@ void GateController::initialize(int stage) {
 
         cXMLElement* xml = par("initialSchedule").xmlValue();
         loadScheduleOrDefault(xml);
-        if (par("enableHoldAndRelease")) {
-            //Schedule hold for the first entry if needed.
-            //This is needed because hold is only always requested for the following entry,
-            //but not for the current one. Therefore the first entry would not be held.
-            for (TransmissionGate* transmissionGate : transmissionGates) {
-                if ((!currentSchedule->isEmpty()
-                        && currentSchedule->getScheduledObject(0).test(
-                                transmissionGate->getIndex()))
-                        && transmissionGate->isExpressQueue()) {
-                    preemptMacModule->hold(SIMTIME_ZERO);
-                    break;
-                }
-            }
-        }
-        clock->subscribeTick(this, 0);
+        // Holds of the first cycle, also for a first entry opening an express
+        // gate, are planned when the schedule is loaded at the first tick
+        clock->subscribeTick(this, 0, SCHEDULE_TICK);
     }
 }
 
@@ -117,7 +107,13 @@ void GateController::handleMessage(cMessage *msg) {
 
 void GateController::tick(IClock *clock, short kind) {
     Enter_Method("tick()");
-    scheduleAt(simTime(), &updateScheduleMsg);
+    if (kind == HOLD_RELEASE_TICK) {
+        // Handled within the tick, before the gates of an entry starting
+        // with it are set
+        handleHoldReleaseTick();
+    } else {
+        scheduleAt(simTime(), &updateScheduleMsg);
+    }
 }
 
 simtime_t GateController::scheduleNextTickEvent() {
@@ -131,19 +127,18 @@ simtime_t GateController::scheduleNextTickEvent() {
     return 0;
 }
 
+const LinkTiming& GateController::getLinkTiming() {
+    return mac->getLinkTiming();
+}
+
 unsigned int GateController::calculateMaxBit(int gateIndex) {
-    double transmitRate;
-    if (preemptMacModule != nullptr) {
-        transmitRate = preemptMacModule->getTxRate();
-    } else {
-        transmitRate = macModule->getTxRate();
-    }
-    if (transmitRate <= 0) {
+    const TransmissionRate& transmitRate = getLinkTiming().getRate();
+    if (transmitRate.isZero()) {
         return 0;
     }
     simtime_t timeSinceLastChange = clock->getTime() - lastChange;
 
-    double bits = 0;
+    int64_t bits = 0;
     //Has the lookahead already touched the next Schedule
     bool touchedNextSchedule = false;
     int currentIndex = (scheduleIndex + currentSchedule->getControlListLength() - 1)
@@ -175,15 +170,13 @@ unsigned int GateController::calculateMaxBit(int gateIndex) {
                 simtime_t timeLeftInCycle = currentSchedule->getCycleTime()
                         - (timeSinceLastChange + cumSumGateLength
                                 - currentSchedule->getTimeInterval(currentIndex));
-                bits = bits
-                        + (timeLeftInCycle
-                                / (SimTime(1, SIMTIME_S) / transmitRate));
+                bits = bits + transmitRate.bitsForDuration(timeLeftInCycle);
                 currentIndex = 0;
             } else { // else take bitvector length as upper limit
                 bits = bits
-                        + ((currentSchedule->getTimeInterval(currentIndex))
-                                - timeSinceLastChange)
-                                / (SimTime(1, SIMTIME_S) / transmitRate);
+                        + transmitRate.bitsForDuration(
+                                currentSchedule->getTimeInterval(currentIndex)
+                                        - timeSinceLastChange);
                 currentIndex = (currentIndex + 1) % currentSchedule->getControlListLength();
             }
             timeSinceLastChange = SIMTIME_ZERO;
@@ -203,15 +196,13 @@ unsigned int GateController::calculateMaxBit(int gateIndex) {
                     simtime_t timeLeftInCycle = currentSchedule->getCycleTime()
                             - (timeSinceLastChange + cumSumGateLength
                                     - currentSchedule->getTimeInterval(currentIndex));
-                    bits = bits
-                            + (timeLeftInCycle
-                                    / (SimTime(1, SIMTIME_S) / transmitRate));
+                    bits = bits + transmitRate.bitsForDuration(timeLeftInCycle);
                     hitCycleEnd = true;
                 } else {
                     bits = bits
-                            + (currentSchedule->getTimeInterval(currentIndex)
-                                    - timeSinceLastChange)
-                                    / (SimTime(1, SIMTIME_S) / transmitRate);
+                            + transmitRate.bitsForDuration(
+                                    currentSchedule->getTimeInterval(currentIndex)
+                                            - timeSinceLastChange);
                 }
                 timeSinceLastChange = SIMTIME_ZERO;
                 //if currentIndex is not the last index in currentSchedule and cycle end not hit
@@ -243,14 +234,13 @@ unsigned int GateController::calculateMaxBit(int gateIndex) {
                     simtime_t timeLeftInCycle = currentSchedule->getCycleTime()
                     - (timeSinceLastChange + cumSumGateLength
                             - currentSchedule->getTimeInterval(currentIndex));
-                    bits = bits + (timeLeftInCycle
-                            / (SimTime(1, SIMTIME_S) / transmitRate));
+                    bits = bits + transmitRate.bitsForDuration(timeLeftInCycle);
                     currentIndex = 0;
                 } else {
                     bits = bits
-                    + ((nextSchedule->getTimeInterval(currentIndex))
-                            - timeSinceLastChange)
-                    / (SimTime(1, SIMTIME_S) / transmitRate);
+                    + transmitRate.bitsForDuration(
+                            nextSchedule->getTimeInterval(currentIndex)
+                                    - timeSinceLastChange);
                     currentIndex = (currentIndex + 1) % nextSchedule->getControlListLength();
                 }
                 timeSinceLastChange = SIMTIME_ZERO;
@@ -278,6 +268,7 @@ void GateController::loadScheduleOrDefault(cXMLElement* xml) {
 }
 
 void GateController::setGateStates(GateBitvector bitvector, bool release) {
+    gateStates = bitvector;
     for (TransmissionGate* transmissionGate : transmissionGates) { 
         transmissionGate->setGateState(bitvector.test(transmissionGate->getIndex()), release);
     }
@@ -290,23 +281,22 @@ void GateController::updateSchedule()
     // case a new schedule is loaded if available.
     // If cycleStart + cycleTime is greater than the current time
     // , a new cycle hast started and the scheduleIndex needs to be reset to 0.
+    bool scheduleChanged = false;
     if (scheduleIndex == 0 && nextSchedule) {
-
-        // Print warning if the feature is used in combination with frame preemption
-        if(preemptMacModule != nullptr) {
-            if( preemptMacModule->isFramePreemptionEnabled() && par("enableHoldAndRelease")) {
-                EV_WARN << "Using schedule swap in combination with Hold&Release (Frame Preemption) can lead to wrong hold periods."<<endl;
-            }
-        }
-
         // Load new schedule and delete the old one if there is new schedule.
         delete currentSchedule;
         currentSchedule = nextSchedule;
         nextSchedule = nullptr;
+        scheduleChanged = true;
 
         // If an empty schedule was loaded, all gates are opened and there is no
         // need to subscribe to clock ticks
         if (currentSchedule->isEmpty()) {
+            holdReleasePlan.clear();
+            nextHoldReleaseEvent = 0;
+            if (currentlyOnHold()) {
+                mac->release();
+            }
             openAllGates();
             return;
         }
@@ -319,61 +309,214 @@ void GateController::updateSchedule()
     }
     if(scheduleIndex == 0) {
         cycleStart = clock->getTime();
+        // Hold and release requests are planned for a whole cycle, before
+        // the gates of its first entry are opened
+        planHoldAndRelease(scheduleChanged);
     }
 
     // Get next gatestate bitvector
     GateBitvector bitvector = currentSchedule->getScheduledObject(scheduleIndex);
-    bool releaseNeeded = false;
-    if(par("enableHoldAndRelease")) {
-        //Check whether some express gate is open
-        bool someExpressGateOpen=false;
-        for (TransmissionGate* transmissionGate : transmissionGates) {
-            if(bitvector.test(transmissionGate->getIndex()) && transmissionGate->isExpressQueue()) {
-                someExpressGateOpen=true;
-                break;
-            }
-        }
-        //If the Mac component was on hold and no express gate is opened, release it
-        releaseNeeded = !someExpressGateOpen && currentlyOnHold();
-        if(releaseNeeded) {
-            if(preemptMacModule != nullptr) {
-                preemptMacModule->release();
-            }
-        }
-    }
     //Set gate states for every gate
-    setGateStates(bitvector, releaseNeeded);
+    setGateStates(bitvector, false);
     // from high prio to low prio
     EV_INFO << "Setting gates to "<< bitvector << " at t="
             << clock->getTime().inUnit(SIMTIME_US) << "us." << endl;
 
     // Subscribe to the tick, on which a new schedule entry is loaded.
-    clock->subscribeTick(this, scheduleNextTickEvent() / clock->getClockRate());
+    clock->subscribeTick(this, scheduleNextTickEvent() / clock->getClockRate(), SCHEDULE_TICK);
     lastChange = clock->getTime();
 
-    if(par("enableHoldAndRelease")) {
-        //Get following bitvector to be able to schedule hold with advance
-        GateBitvector nextVector;
-        if(nextSchedule && scheduleIndex == currentSchedule->getControlListLength()-1) {
-            //If we are at the last entry of the current schedule, look at the first entry of the next one
-            nextVector = nextSchedule->getScheduledObject(0);
+    // Switch to next schedule entry
+    scheduleIndex = (scheduleIndex + 1) % currentSchedule->getControlListLength();
+}
+
+bool GateController::opensExpressGate(const GateBitvector& bitvector) {
+    for (TransmissionGate* transmissionGate : transmissionGates) {
+        if (bitvector.test(transmissionGate->getIndex()) && transmissionGate->isExpressQueue()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<GateController::ExpressWindow> GateController::findExpressWindows(
+        Schedule<GateBitvector>* schedule, simtime_t cycleStart) {
+    std::vector<ExpressWindow> windows;
+    if (schedule->isEmpty()) {
+        return windows;
+    }
+    // Entries are cut at the end of the cycle, like in scheduleNextTickEvent()
+    simtime_t cycleTime = schedule->getCycleTime();
+    simtime_t offset = SIMTIME_ZERO;
+    bool inWindow = false;
+    for (unsigned int i = 0; i < schedule->getControlListLength() && offset < cycleTime; i++) {
+        simtime_t end = std::min(offset + schedule->getTimeInterval(i), cycleTime);
+        bool express = opensExpressGate(schedule->getScheduledObject(i));
+        if (express && inWindow) {
+            windows.back().end = cycleStart + end;
+        } else if (express) {
+            windows.push_back({cycleStart + offset, cycleStart + end, SIMTIME_ZERO});
+        }
+        inWindow = express;
+        offset = end;
+    }
+    // Gaps before the windows, the first one wraps around the cycle
+    for (size_t i = 0; i < windows.size(); i++) {
+        simtime_t previousEnd = i > 0 ? windows[i - 1].end : windows.back().end - cycleTime;
+        windows[i].gap = windows[i].start - previousEnd;
+    }
+    return windows;
+}
+
+void GateController::planHoldAndRelease(bool scheduleChanged) {
+    // Requests due until now still belong to the cycle that just ended
+    while (nextHoldReleaseEvent < holdReleasePlan.size()
+            && holdReleasePlan[nextHoldReleaseEvent].time <= clock->getTime()) {
+        handleHoldReleaseEvent();
+    }
+    holdReleasePlan.clear();
+    nextHoldReleaseEvent = 0;
+
+    if (scheduleChanged) {
+        // Windows of the former schedule are void, the new one is planned
+        // from scratch
+        holdPlannedUntil = -1;
+        releasePlannedUntil = -1;
+    }
+    planHoldReleaseEvents();
+
+    // A hold issued in the former cycle for the first window of the former
+    // schedule has no release in the new plan. The Mac is released, unless
+    // the new schedule holds it right away.
+    if (scheduleChanged && currentlyOnHold()) {
+        if (!holdReleasePlan.empty() && holdReleasePlan.front().hold
+                && holdReleasePlan.front().time <= clock->getTime()) {
+            nextHoldReleaseEvent++;
         } else {
-            nextVector = currentSchedule->getScheduledObject((scheduleIndex + 1) % currentSchedule->getControlListLength());
+            EV_INFO << "Releasing hold of the former schedule at t="
+                    << clock->getTime().inUnit(SIMTIME_US) << "us." << endl;
+            mac->release();
+            setGateStates(gateStates, true);
         }
+    }
+    scheduleNextHoldReleaseEvent();
+}
 
-        for (TransmissionGate* transmissionGate : transmissionGates) {
-            //Schedule hold if any express gate is open in the next schdule state
-            if(nextVector.test(transmissionGate->getIndex()) && transmissionGate->isExpressQueue()) {
-                if(preemptMacModule!=nullptr) {
-                    preemptMacModule->hold((currentSchedule->getTimeInterval(scheduleIndex)) - preemptMacModule->getHoldAdvance());
-                    break;
-                }
+void GateController::planHoldReleaseEvents() {
+    if (!par("enableHoldAndRelease").boolValue() || !mac->isFramePreemptionEnabled()) {
+        return;
+    }
+    if (getLinkTiming().isZero()) {
+        return;
+    }
+    // A negative holdAdvance parameter means the worst case of the Mac
+    simtime_t advance = holdAdvance >= SIMTIME_ZERO ? holdAdvance : mac->getHoldAdvance();
+    simtime_t guardBand = mac->getGuardBandWithoutPreemption();
+
+    // Windows of this cycle and the first window of the following one, whose
+    // hold may be due in this cycle. A schedule loaded in the meantime takes
+    // over when this cycle ends.
+    simtime_t cycleEnd = cycleStart + currentSchedule->getCycleTime();
+    std::vector<ExpressWindow> windows = findExpressWindows(currentSchedule, cycleStart);
+    Schedule<GateBitvector>* followingSchedule = nextSchedule ? nextSchedule : currentSchedule;
+    std::vector<ExpressWindow> followingWindows = findExpressWindows(followingSchedule, cycleEnd);
+    if (!followingWindows.empty()) {
+        ExpressWindow window = followingWindows.front();
+        if (!windows.empty()) {
+            window.gap = window.start - windows.back().end;
+        }
+        windows.push_back(window);
+    }
+
+    // The Mac stays on hold between windows if the release would not come
+    // before the next hold
+    std::vector<ExpressWindow> heldWindows;
+    std::vector<simtime_t> lastStarts;
+    for (const ExpressWindow& window : windows) {
+        if (!heldWindows.empty()
+                && window.start - advance <= heldWindows.back().end - releaseAdvance) {
+            heldWindows.back().end = window.end;
+            lastStarts.back() = window.start;
+        } else {
+            heldWindows.push_back(window);
+            lastStarts.push_back(window.start);
+        }
+    }
+
+    for (size_t i = 0; i < heldWindows.size(); i++) {
+        const ExpressWindow& window = heldWindows[i];
+        // Windows already held in the previous cycle are skipped
+        simtime_t holdTime = window.start - advance;
+        if (holdTime < cycleEnd && window.start > holdPlannedUntil) {
+            // Without preemption, the guard band takes up to a maximum frame
+            // of the gap before the window, with Hold&Release only holdAdvance
+            simtime_t saved = std::min(guardBand, window.gap) - std::min(advance, window.gap);
+            holdReleasePlan.push_back({std::max(holdTime, cycleStart), true, saved});
+            EV_DETAIL << getFullPath() << ": Express window from "
+                             << window.start.inUnit(SIMTIME_NS) << "ns to "
+                             << window.end.inUnit(SIMTIME_NS) << "ns saves "
+                             << saved.inUnit(SIMTIME_NS) << "ns of guard band." << endl;
+        }
+        if (holdTime < cycleEnd) {
+            holdPlannedUntil = std::max(holdPlannedUntil, lastStarts[i]);
+        }
+        simtime_t releaseTime = window.end - releaseAdvance;
+        if (releaseTime < cycleEnd && window.end > releasePlannedUntil) {
+            holdReleasePlan.push_back({std::max(releaseTime, cycleStart), false, SIMTIME_ZERO});
+            releasePlannedUntil = window.end;
+        }
+    }
+    std::stable_sort(holdReleasePlan.begin(), holdReleasePlan.end(),
+            [](const HoldReleaseEvent& lhs, const HoldReleaseEvent& rhs) {
+                return lhs.time < rhs.time;
+            });
+}
+
+void GateController::scheduleNextHoldReleaseEvent() {
+    // Requests due now are handled right away, so a hold at the start of an
+    // entry comes before its gates are opened
+    while (nextHoldReleaseEvent < holdReleasePlan.size()) {
+        simtime_t delay = holdReleasePlan[nextHoldReleaseEvent].time - clock->getTime();
+        if (delay > SIMTIME_ZERO) {
+            // The delay is clock time, so it is waited for in clock ticks,
+            // rounded up to the next one
+            int64_t tickLength = clock->getClockRate().raw();
+            int64_t idleTicks = (delay.raw() + tickLength - 1) / tickLength;
+            // Longer gaps than a subscription can take are waited for in
+            // several ones
+            idleTicks = std::min<int64_t>(idleTicks, std::numeric_limits<unsigned>::max());
+            simtime_t tickTime = clock->getTime() + SimTime::fromRaw(idleTicks * tickLength);
+            if (tickTime != holdReleaseTickTime) {
+                clock->subscribeTick(this, static_cast<unsigned>(idleTicks), HOLD_RELEASE_TICK);
+                holdReleaseTickTime = tickTime;
             }
+            return;
         }
+        handleHoldReleaseEvent();
     }
+}
 
-    // Switch to next schedule entry
-    scheduleIndex = (scheduleIndex + 1) % currentSchedule->getControlListLength();
+void GateController::handleHoldReleaseTick() {
+    if (clock->getTime() >= holdReleaseTickTime) {
+        holdReleaseTickTime = -1;
+    }
+    scheduleNextHoldReleaseEvent();
+}
+
+void GateController::handleHoldReleaseEvent() {
+    const HoldReleaseEvent& event = holdReleasePlan[nextHoldReleaseEvent++];
+    if (event.hold) {
+        EV_INFO << "Requesting hold at t="
+                << clock->getTime().inUnit(SIMTIME_US) << "us." << endl;
+        emit(guardBandSavedSignal, event.guardBandSaved);
+        mac->hold(SIMTIME_ZERO);
+    } else {
+        EV_INFO << "Requesting release at t="
+                << clock->getTime().inUnit(SIMTIME_US) << "us." << endl;
+        mac->release();
+        // Open gates of preemptable queues can offer frames again
+        setGateStates(gateStates, true);
+    }
 }
 
 void GateController::openAllGates() {
@@ -382,11 +525,7 @@ void GateController::openAllGates() {
     setGateStates(bitvectorAllGatesOpen, true);
 }
 bool GateController::currentlyOnHold() {
-    if (preemptMacModule != nullptr) {
-        return preemptMacModule->isOnHold();
-    } else {
-        return false;
-    }
+    return mac->isOnHold();
 }
 }
 // namespace nesting
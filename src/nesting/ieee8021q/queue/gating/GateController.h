@@ -24,9 +24,7 @@
 
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/InitStages.h"
-#include "inet/linklayer/ethernet/EtherMacFullDuplex.h"
 
-#include "nesting/linklayer/framePreemption/EtherMACFullDuplexPreemptable.h"
 #include "nesting/common/schedule/Schedule.h"
 #include "nesting/common/schedule/ScheduleFactory.h"
 #include "nesting/ieee8021q/Ieee8021q.h"
@@ -34,11 +32,12 @@
 #include "nesting/ieee8021q/queue/gating/TransmissionGate.h"
 #include "nesting/common/time/IClock.h"
 #include "nesting/common/time/IClockListener.h"
+#include "nesting/common/time/LinkTiming.h"
+#include "nesting/linklayer/common/ITsnMac.h"
 
 using namespace omnetpp;
 
 class TransmissionGate;
-class EtherMACFullDuplexPreemptable;
 
 namespace nesting {
 
@@ -47,6 +46,30 @@ namespace nesting {
  */
 class GateController: public cSimpleModule, public IClockListener {
 private:
+    /** Time span in which some express gate is open, in clock time. */
+    struct ExpressWindow {
+        simtime_t start;
+        simtime_t end;
+        /** Time without open express gates before the window. */
+        simtime_t gap;
+    };
+
+    /** Kinds of the clock ticks the module subscribes to. */
+    enum TickKind : short {
+        /** Next entry of the gate control list. */
+        SCHEDULE_TICK = 0,
+        /** Next planned hold or release request. */
+        HOLD_RELEASE_TICK = 1
+    };
+
+    /** Hold or release request planned for the current cycle, in clock time. */
+    struct HoldReleaseEvent {
+        simtime_t time;
+        bool hold;
+        /** For holds, guard band saved compared to non-preemptive gating. */
+        simtime_t guardBandSaved;
+    };
+
     /** Current schedule. Is never null. */
     Schedule<GateBitvector>* currentSchedule;
 
@@ -73,13 +96,34 @@ private:
     /** Reference to transmission gate vector module */
     std::vector<TransmissionGate*> transmissionGates;
 
-    EtherMACFullDuplexPreemptable* preemptMacModule;
-    inet::EtherMacFullDuplex* macModule;
+    /** Mac module of the port, providing link timing, hold and release. */
+    ITsnMac* mac;
     std::string switchString;
     std::string portString;
     simtime_t lastChange;
 
     cMessage updateScheduleMsg = cMessage("updateSchedule");
+
+    // Hold and release requests of the current cycle, computed from the
+    // gate control list when the cycle starts
+    simtime_t holdAdvance;
+    simtime_t releaseAdvance;
+    std::vector<HoldReleaseEvent> holdReleasePlan;
+    size_t nextHoldReleaseEvent = 0;
+    /** Start of the last express window a hold was planned for. */
+    simtime_t holdPlannedUntil = -1;
+    /** End of the last express window a release was planned for. */
+    simtime_t releasePlannedUntil = -1;
+    /** Gate states currently set. */
+    GateBitvector gateStates;
+    /**
+     * Clock time of the last hold-release tick subscribed to, -1 if it was
+     * handled. Ticks of a replaced plan can't be unsubscribed and find no
+     * request due.
+     */
+    simtime_t holdReleaseTickTime = -1;
+
+    static simsignal_t guardBandSavedSignal;
 protected:
     /** @see cSimpleModule::initialize(int) */
     virtual void initialize(int stage) override;
@@ -100,6 +144,39 @@ protected:
 
     virtual void updateSchedule();
 
+    /** Returns the link timing of the Mac module. */
+    virtual const LinkTiming& getLinkTiming();
+
+    /** Returns true if the bitvector opens the gate of an express queue. */
+    virtual bool opensExpressGate(const GateBitvector& bitvector);
+
+    /** Returns the express windows of one cycle of a schedule starting at cycleStart. */
+    virtual std::vector<ExpressWindow> findExpressWindows(
+            Schedule<GateBitvector>* schedule, simtime_t cycleStart);
+
+    /**
+     * Plans the hold and release requests of the cycle that just started and
+     * subscribes to the first one. If the schedule changed with this cycle,
+     * a hold left from the former schedule is released.
+     */
+    virtual void planHoldAndRelease(bool scheduleChanged);
+
+    /**
+     * Computes the hold and release requests of the current cycle, including
+     * holds needed ahead of the following cycle's first window.
+     */
+    virtual void planHoldReleaseEvents();
+
+    /**
+     * Handles the requests that are due and subscribes to the clock tick of
+     * the next one, so hold and release follow the clock like gate changes.
+     */
+    virtual void scheduleNextHoldReleaseEvent();
+
+    virtual void handleHoldReleaseEvent();
+
+    virtual void handleHoldReleaseTick();
+
 public:
     virtual ~GateController();
 
@@ -134,6 +134,9 @@ void TransmissionGate::setGateState(bool gateOpen, bool release) {
 
     // Schedule gate-state-changed event
     if (gateStateChanged) {
+        if (!gateOpen) {
+            transmissionSelection->gateClosed(this);
+        }
         cancelEvent(&gateStateChangedMsg);
         scheduleAt(simTime(), &gateStateChangedMsg);
     } else if(release && gateOpen && !tsAlgorithm->isEmpty(maxTransferableBits()) && (isExpressQueue() || !gateController->currentlyOnHold())) {
@@ -147,6 +150,33 @@ bool TransmissionGate::isEmpty() {
             || tsAlgorithm->isEmpty(maxTransferableBits());
 }
 
+bool TransmissionGate::canTransmit(uint64_t bitLength) {
+    // Overhead 8Byte from preamble, see LengthAwareQueue::isEmpty()
+    unsigned preambleSize = 8*8;
+    return isGateOpen()
+            && (isExpressQueue() || !gateController->currentlyOnHold())
+            && bitLength + preambleSize <= maxTransferableBits();
+}
+
+bool TransmissionGate::isPrefetchable() {
+    return tsAlgorithm->isPrefetchable();
+}
+
+cPacket* TransmissionGate::prefetchPacket() {
+    Enter_Method("prefetchPacket()");
+    return tsAlgorithm->prefetchPacket(maxTransferableBits());
+}
+
+void TransmissionGate::commitPacket(cPacket* packet) {
+    Enter_Method("commitPacket()");
+    tsAlgorithm->commitPacket(packet);
+}
+
+void TransmissionGate::requeuePacket(cPacket* packet) {
+    Enter_Method("requeuePacket()");
+    tsAlgorithm->requeuePacket(packet);
+}
+
 void TransmissionGate::requestPacket() {
     Enter_Method("requestPacket()");
 
@@ -171,6 +171,30 @@ public:
     virtual void packetEnqueued();
 
     virtual bool isExpressQueue();
+
+    /**
+     * Returns true if a frame of the given length could be transmitted
+     * through this gate now, regardless of the queue content.
+     */
+    virtual bool canTransmit(uint64_t bitLength);
+
+    /**
+     * Returns true if frames can be prefetched from this gate.
+     */
+    virtual bool isPrefetchable();
+
+    /**
+     * Takes the next frame that fits into the gate window from the input
+     * queue right away, without request-packet events. Returns nullptr if
+     * there is none.
+     */
+    virtual cPacket* prefetchPacket();
+
+    /** Passes a prefetched frame on to the Mac. */
+    virtual void commitPacket(cPacket* packet);
+
+    /** Hands a prefetched frame back to the input queue. */
+    virtual void requeuePacket(cPacket* packet);
 };
 
 } // namespace nesting
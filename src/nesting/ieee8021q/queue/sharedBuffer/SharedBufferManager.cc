@@ -0,0 +1,223 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/sharedBuffer/SharedBufferManager.h"
+
+#include <algorithm>
+
+namespace nesting {
+
+Define_Module(SharedBufferManager);
+
+void SharedBufferManager::initialize() {
+    readParameters();
+
+    occupancySignal = registerSignal("occupancy");
+    pfcPauseSignal = registerSignal("pfcPause");
+    pfcResumeSignal = registerSignal("pfcResume");
+    lastOccupancyChange = simTime();
+
+    WATCH(totalReserved);
+    WATCH(sharedUsed);
+    WATCH(totalUsed);
+    WATCH(numAdmitted);
+    WATCH(numRejected);
+    WATCH(numPauses);
+}
+
+void SharedBufferManager::readParameters() {
+    if (parametersRead) {
+        return;
+    }
+    parametersRead = true;
+
+    int64_t size = par("bufferSize");
+    int64_t queueReserve = par("reservedPerQueue");
+    int64_t portReserve = par("reservedPerPort");
+    if (size <= 0 || queueReserve < 0 || portReserve < 0) {
+        throw cRuntimeError("Buffer size must be positive and reserved memory must not be negative.");
+    }
+    bufferSize = size;
+    reservedPerQueue = queueReserve;
+    reservedPerPort = portReserve;
+
+    alphas = cStringTokenizer(par("alpha")).asDoubleVector();
+    if (alphas.empty()) {
+        throw cRuntimeError("Parameter alpha must contain at least one value.");
+    }
+    for (double alpha : alphas) {
+        if (alpha <= 0) {
+            throw cRuntimeError("Alpha values must be positive.");
+        }
+    }
+
+    pfcEnabled = par("pfcEnabled");
+    pfcXoffRatio = par("pfcXoffRatio");
+    pfcXonRatio = par("pfcXonRatio");
+    if (pfcEnabled && (pfcXonRatio < 0 || pfcXonRatio > pfcXoffRatio)) {
+        throw cRuntimeError("PFC thresholds must satisfy 0 <= pfcXonRatio <= pfcXoffRatio.");
+    }
+    occupancySignalEnabled = par("occupancySignal");
+}
+
+void SharedBufferManager::handleMessage(cMessage* msg) {
+    throw cRuntimeError("SharedBufferManager doesn't handle messages.");
+}
+
+int SharedBufferManager::registerQueue(cModule* port, int priority) {
+    Enter_Method_Silent();
+    readParameters();
+
+    auto it = portIds.find(port);
+    if (it == portIds.end()) {
+        it = portIds.emplace(port, static_cast<int>(ports.size())).first;
+        ports.push_back(PortState());
+        totalReserved += reservedPerPort;
+    }
+    totalReserved += reservedPerQueue;
+    if (totalReserved > bufferSize) {
+        throw cRuntimeError("Reserved memory of %zu queues exceeds buffer size "
+                "of %lu bits.", queues.size() + 1, static_cast<unsigned long>(bufferSize));
+    }
+
+    QueueState queue;
+    queue.port = it->second;
+    queue.priority = priority;
+    queue.alpha = alphas[std::min(static_cast<size_t>(std::max(priority, 0)),
+            alphas.size() - 1)];
+    queues.push_back(queue);
+    return static_cast<int>(queues.size()) - 1;
+}
+
+bool SharedBufferManager::admit(int queueId, uint64_t bits) {
+    Enter_Method_Silent();
+    QueueState& queue = queues.at(queueId);
+    PortState& port = ports[queue.port];
+
+    if (queue.queueReservedBits + bits <= reservedPerQueue) {
+        queue.queueReservedBits += bits;
+    } else if (port.reservedBits + bits <= reservedPerPort) {
+        port.reservedBits += bits;
+        queue.portReservedBits += bits;
+    } else if (sharedUsed + bits <= getSharedSize()
+            && queue.sharedBits + bits <= getDynamicThreshold(queue)) {
+        sharedUsed += bits;
+        queue.sharedBits += bits;
+        maxSharedUsed = std::max(maxSharedUsed, sharedUsed);
+    } else {
+        numRejected++;
+        return false;
+    }
+
+    numAdmitted++;
+    updateOccupancyStatistics();
+    totalUsed += bits;
+    occupancyChanged();
+    updatePause(queue);
+    return true;
+}
+
+void SharedBufferManager::release(int queueId, uint64_t bits) {
+    Enter_Method_Silent();
+    QueueState& queue = queues.at(queueId);
+    PortState& port = ports[queue.port];
+    ASSERT(bits <= queue.sharedBits + queue.portReservedBits + queue.queueReservedBits);
+
+    updateOccupancyStatistics();
+    totalUsed -= bits;
+
+    // Give back shared memory first, so that reserved memory stays with the
+    // queue as long as possible.
+    uint64_t fromShared = std::min(bits, queue.sharedBits);
+    queue.sharedBits -= fromShared;
+    sharedUsed -= fromShared;
+    bits -= fromShared;
+
+    uint64_t fromPort = std::min(bits, queue.portReservedBits);
+    queue.portReservedBits -= fromPort;
+    port.reservedBits -= fromPort;
+    bits -= fromPort;
+
+    queue.queueReservedBits -= bits;
+
+    occupancyChanged();
+    updatePause(queue);
+}
+
+uint64_t SharedBufferManager::getSharedSize() const {
+    return bufferSize - totalReserved;
+}
+
+double SharedBufferManager::getDynamicThreshold(const QueueState& queue) const {
+    return queue.alpha * static_cast<double>(getSharedSize() - sharedUsed);
+}
+
+void SharedBufferManager::updatePause(QueueState& queue) {
+    if (!pfcEnabled) {
+        return;
+    }
+    // Same threshold as for admission, a queue can't grow beyond it
+    double threshold = getDynamicThreshold(queue);
+    if (!queue.paused && queue.sharedBits > pfcXoffRatio * threshold) {
+        queue.paused = true;
+        numPauses++;
+        EV_INFO << getFullPath() << ": Pause priority " << queue.priority
+                       << " of port " << queue.port << endl;
+        emit(pfcPauseSignal, queue.priority);
+    } else if (queue.paused && queue.sharedBits < pfcXonRatio * threshold) {
+        queue.paused = false;
+        EV_INFO << getFullPath() << ": Resume priority " << queue.priority
+                       << " of port " << queue.port << endl;
+        emit(pfcResumeSignal, queue.priority);
+    }
+}
+
+void SharedBufferManager::updateOccupancyStatistics() {
+    simtime_t now = simTime();
+    occupancyIntegral += totalUsed * (now - lastOccupancyChange).dbl();
+    lastOccupancyChange = now;
+}
+
+void SharedBufferManager::occupancyChanged() {
+    maxTotalUsed = std::max(maxTotalUsed, totalUsed);
+    if (occupancySignalEnabled) {
+        emit(occupancySignal, static_cast<long>(totalUsed));
+    }
+}
+
+uint64_t SharedBufferManager::getBufferSize() const {
+    return bufferSize;
+}
+
+bool SharedBufferManager::isPaused(int queueId) const {
+    return queues.at(queueId).paused;
+}
+
+void SharedBufferManager::finish() {
+    updateOccupancyStatistics();
+    simtime_t duration = simTime() - getSimulation()->getWarmupPeriod();
+    recordScalar("frames admitted", numAdmitted);
+    recordScalar("frames rejected", numRejected);
+    recordScalar("max shared occupancy", maxSharedUsed, "b");
+    recordScalar("max occupancy", maxTotalUsed, "b");
+    if (duration > SimTime::ZERO) {
+        recordScalar("mean occupancy", occupancyIntegral / duration.dbl(), "b");
+    }
+    if (pfcEnabled) {
+        recordScalar("pause events", numPauses);
+    }
+}
+
+} // namespace nesting
@@ -0,0 +1,151 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_SHAREDBUFFER_SHAREDBUFFERMANAGER_H_
+#define NESTING_IEEE8021Q_QUEUE_SHAREDBUFFER_SHAREDBUFFERMANAGER_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <vector>
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class SharedBufferManager: public cSimpleModule {
+protected:
+    /** Memory accounting of a registered queue. */
+    struct QueueState {
+        int port;
+        int priority;
+        double alpha;
+        /** Bits taken from the queue's reserved minimum. */
+        uint64_t queueReservedBits = 0;
+        /** Bits taken from the port's reserved minimum. */
+        uint64_t portReservedBits = 0;
+        /** Bits taken from the shared pool. */
+        uint64_t sharedBits = 0;
+        bool paused = false;
+    };
+
+    /** Memory accounting of a port. */
+    struct PortState {
+        uint64_t reservedBits = 0;
+    };
+
+    std::vector<QueueState> queues;
+    std::vector<PortState> ports;
+
+    /** Port ids by the module containing the queues of a port. */
+    std::map<cModule*, int> portIds;
+
+    uint64_t bufferSize;
+    uint64_t reservedPerQueue;
+    uint64_t reservedPerPort;
+    std::vector<double> alphas;
+    bool pfcEnabled;
+    double pfcXoffRatio;
+    double pfcXonRatio;
+    bool occupancySignalEnabled;
+
+    /** True once the parameters are read. */
+    bool parametersRead = false;
+
+    /** Memory reserved by all registered queues and ports. */
+    uint64_t totalReserved = 0;
+
+    /** Bits used in the shared pool. */
+    uint64_t sharedUsed = 0;
+
+    /** Bits used in total. */
+    uint64_t totalUsed = 0;
+
+    // statistics
+    uint64_t numAdmitted = 0;
+    uint64_t numRejected = 0;
+    uint64_t numPauses = 0;
+    uint64_t maxSharedUsed = 0;
+    uint64_t maxTotalUsed = 0;
+    double occupancyIntegral = 0;
+    simtime_t lastOccupancyChange;
+    simsignal_t occupancySignal;
+    simsignal_t pfcPauseSignal;
+    simsignal_t pfcResumeSignal;
+
+protected:
+    virtual void initialize() override;
+
+    /**
+     * Reads the module parameters. Queues may register before this module
+     * is initialized, so this is done on demand.
+     */
+    virtual void readParameters();
+
+    virtual void handleMessage(cMessage* msg) override;
+
+    virtual void finish() override;
+
+    /** Returns the size of the shared pool. */
+    virtual uint64_t getSharedSize() const;
+
+    /** Returns the current dynamic threshold of a queue in the shared pool. */
+    virtual double getDynamicThreshold(const QueueState& queue) const;
+
+    /** Pauses or resumes a queue according to the PFC thresholds. */
+    virtual void updatePause(QueueState& queue);
+
+    /** Must be called before the total occupancy changes. */
+    virtual void updateOccupancyStatistics();
+
+    /** Must be called after the total occupancy changed. */
+    virtual void occupancyChanged();
+
+public:
+    /**
+     * Registers a queue and reserves its minimum memory.
+     *
+     * @param port     Module containing all queues of a port, e.g. the
+     *                 ~Queuing module.
+     * @param priority Priority of the queue, used to select alpha.
+     * @return Id used for admission and release.
+     */
+    virtual int registerQueue(cModule* port, int priority);
+
+    /**
+     * Admits a frame into a queue if there is enough memory. Memory is
+     * allocated if the frame is admitted.
+     *
+     * @return True if the frame is admitted, false if it must be dropped.
+     */
+    virtual bool admit(int queueId, uint64_t bits);
+
+    /**
+     * Releases memory of a frame that was admitted to a queue before.
+     */
+    virtual void release(int queueId, uint64_t bits);
+
+    /** Returns the size of the switch's packet memory. */
+    virtual uint64_t getBufferSize() const;
+
+    /** Returns true if PFC currently pauses a queue. */
+    virtual bool isPaused(int queueId) const;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_SHAREDBUFFER_SHAREDBUFFERMANAGER_H_ */
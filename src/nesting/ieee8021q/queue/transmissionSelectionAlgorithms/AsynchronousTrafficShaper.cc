@@ -0,0 +1,268 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/ieee8021q/queue/transmissionSelectionAlgorithms/AsynchronousTrafficShaper.h"
+#include "nesting/common/IMisbehaviorListener.h"
+
+#include "inet/linklayer/common/InterfaceTag_m.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace nesting {
+
+Define_Module(AsynchronousTrafficShaper);
+
+bool AsynchronousTrafficShaper::HeadEntry::operator>(const HeadEntry& other) const {
+    return eligibilityTime > other.eligibilityTime
+            || (eligibilityTime == other.eligibilityTime && shapedQueue > other.shapedQueue);
+}
+
+AsynchronousTrafficShaper::~AsynchronousTrafficShaper() {
+    cancelEvent(&eligibilityMsg);
+    for (ShapedQueue& shapedQueue : shapedQueues) {
+        for (ShapedFrame& frame : shapedQueue.frames) {
+            delete frame.packet;
+        }
+    }
+}
+
+void AsynchronousTrafficShaper::initialize() {
+    TSAlgorithm::initialize();
+
+    eligibilityDelaySignal = registerSignal("eligibilityDelay");
+    dropPkSignal = registerSignal("dropPk");
+
+    double committedInformationRate = par("committedInformationRate");
+    int64_t committedBurstSize = par("committedBurstSize");
+    if (committedInformationRate <= 0 || committedBurstSize <= 0) {
+        throw cRuntimeError("Committed information rate and burst size must be positive.");
+    }
+    defaultCommittedInformationRate = TransmissionRate(committedInformationRate);
+    defaultCommittedBurstSize = committedBurstSize;
+    maxResidenceTime = par("maxResidenceTime");
+    loadFlows(par("flows").xmlValue());
+
+    WATCH(numFramesShaped);
+    WATCH(numFramesDropped);
+}
+
+void AsynchronousTrafficShaper::loadFlows(cXMLElement* xml) {
+    for (cXMLElement* flowXml : xml->getChildrenByTagName("flow")) {
+        const char* id = flowXml->getAttribute("id");
+        const char* rate = flowXml->getAttribute("committedInformationRate");
+        const char* burstSize = flowXml->getAttribute("committedBurstSize");
+        if (!id || !rate || !burstSize) {
+            throw cRuntimeError("Flow at %s requires the attributes id, "
+                    "committedInformationRate and committedBurstSize.",
+                    flowXml->getSourceLocation());
+        }
+        double committedInformationRate = std::stod(rate);
+        uint64_t committedBurstSize = std::stoull(burstSize);
+        if (committedInformationRate <= 0 || committedBurstSize == 0) {
+            throw cRuntimeError("Invalid shaper parameters at %s.",
+                    flowXml->getSourceLocation());
+        }
+        flowShapers[std::stoull(id)] = createFlowShaper(committedInformationRate,
+                committedBurstSize);
+    }
+}
+
+AsynchronousTrafficShaper::FlowShaper AsynchronousTrafficShaper::createFlowShaper(
+        double committedInformationRate, uint64_t committedBurstSize) {
+    FlowShaper shaper;
+    shaper.committedInformationRate = TransmissionRate(committedInformationRate);
+    shaper.committedBurstSize = committedBurstSize;
+    shaper.emptyToFullDuration = shaper.committedInformationRate.durationForBits(
+            committedBurstSize);
+    shaper.bucketEmptyTime = SimTime::ZERO;
+    return shaper;
+}
+
+AsynchronousTrafficShaper::FlowShaper& AsynchronousTrafficShaper::getFlowShaper(
+        uint64_t flowId) {
+    auto it = flowShapers.find(flowId);
+    if (it == flowShapers.end()) {
+        it = flowShapers.emplace(flowId, createFlowShaper(
+                defaultCommittedInformationRate.getBitsPerSecond(),
+                defaultCommittedBurstSize)).first;
+    }
+    return it->second;
+}
+
+AsynchronousTrafficShaper::ShapedQueue& AsynchronousTrafficShaper::getShapedQueue(
+        int interfaceId, size_t& index) {
+    auto it = shapedQueueIndices.find(interfaceId);
+    if (it == shapedQueueIndices.end()) {
+        it = shapedQueueIndices.emplace(interfaceId, shapedQueues.size()).first;
+        shapedQueues.push_back(ShapedQueue());
+    }
+    index = it->second;
+    return shapedQueues[index];
+}
+
+void AsynchronousTrafficShaper::handleMessage(cMessage* msg) {
+    if (msg == &eligibilityMsg) {
+        updateEligibility();
+    } else if (msg->isSelfMessage()) {
+        TSAlgorithm::handleMessage(msg);
+    } else {
+        throw cRuntimeError("Frames are taken from the queue by method calls.");
+    }
+}
+
+void AsynchronousTrafficShaper::refreshDisplay() const {
+    char buf[80];
+    sprintf(buf, "ats\nshaped queues: %zu", shapedQueues.size());
+    getDisplayString().setTagArg("t", 0, buf);
+}
+
+void AsynchronousTrafficShaper::handlePacketEnqueuedEvent() {
+    EV_TRACE << getFullPath() << ": Handle packet enqueued event." << endl;
+    holdFrames();
+}
+
+void AsynchronousTrafficShaper::holdFrames() {
+    // The frames stay charged to the queue's buffer while they are shaped
+    while (cPacket* packet = queue->holdPacket()) {
+        take(packet);
+        shapeFrame(check_and_cast<Packet*>(packet));
+    }
+}
+
+void AsynchronousTrafficShaper::shapeFrame(Packet* packet) {
+    simtime_t arrivalTime = simTime();
+    uint64_t flowId = IMisbehaviorListener::getFlowId(packet);
+    FlowShaper& shaper = getFlowShaper(flowId);
+
+    int interfaceId = -1;
+    auto interfaceInd = packet->findTag<InterfaceInd>();
+    if (interfaceInd != nullptr) {
+        interfaceId = interfaceInd->getInterfaceId();
+    }
+    size_t shapedQueueIndex;
+    ShapedQueue& shapedQueue = getShapedQueue(interfaceId, shapedQueueIndex);
+
+    // Token bucket shaper state machine, see IEEE 802.1Qcr 8.6.11.3.10
+    uint64_t length = packet->getBitLength();
+    simtime_t schedulerEligibilityTime = shaper.bucketEmptyTime
+            + shaper.committedInformationRate.durationForBits(length);
+    simtime_t bucketFullTime = shaper.bucketEmptyTime + shaper.emptyToFullDuration;
+    simtime_t eligibilityTime = std::max(std::max(arrivalTime,
+            shapedQueue.groupEligibilityTime), schedulerEligibilityTime);
+
+    if (maxResidenceTime > SimTime::ZERO
+            && eligibilityTime > arrivalTime + maxResidenceTime) {
+        EV_INFO << getFullPath() << ": Discard frame " << packet->getName()
+                       << " of flow " << flowId << ", eligible at "
+                       << eligibilityTime << endl;
+        numFramesDropped++;
+        emit(dropPkSignal, packet->getTreeId());
+        queue->discardHeldPacket(packet);
+        return;
+    }
+
+    shapedQueue.groupEligibilityTime = eligibilityTime;
+    if (eligibilityTime < bucketFullTime) {
+        shaper.bucketEmptyTime = schedulerEligibilityTime;
+    } else {
+        shaper.bucketEmptyTime = schedulerEligibilityTime + eligibilityTime
+                - bucketFullTime;
+    }
+
+    if (par("verbose")) {
+        EV_DETAIL << getFullPath() << ": Frame " << packet->getName()
+                         << " of flow " << flowId << " eligible at "
+                         << eligibilityTime << endl;
+    }
+    numFramesShaped++;
+    emit(eligibilityDelaySignal, eligibilityTime - arrivalTime);
+
+    // Eligibility times within a shaped queue are non-decreasing, so only
+    // the head of a queue has to be in the heap.
+    shapedQueue.frames.push_back(ShapedFrame { packet, eligibilityTime });
+    if (shapedQueue.frames.size() == 1) {
+        heads.push_back(HeadEntry { eligibilityTime, shapedQueueIndex });
+        std::push_heap(heads.begin(), heads.end(), std::greater<HeadEntry>());
+        updateEligibility();
+    }
+}
+
+void AsynchronousTrafficShaper::handleRequestPacketEvent(uint64_t maxBits) {
+    EV_TRACE << getFullPath() << ": Handle request-packet event (" << maxBits
+                    << " bits)." << endl;
+    ASSERT(!isEmpty(maxBits));
+
+    // Active queue management of the queue may drop the frame if another
+    // eligible frame can be sent instead
+    Packet* packet = popHeadFrame();
+    while (!queue->releaseHeldPacket(packet, !isEmpty(maxBits))) {
+        packet = popHeadFrame();
+    }
+
+    send(packet, "out");
+    updateEligibility();
+}
+
+Packet* AsynchronousTrafficShaper::popHeadFrame() {
+    std::pop_heap(heads.begin(), heads.end(), std::greater<HeadEntry>());
+    size_t shapedQueueIndex = heads.back().shapedQueue;
+    heads.pop_back();
+
+    ShapedQueue& shapedQueue = shapedQueues[shapedQueueIndex];
+    Packet* packet = shapedQueue.frames.front().packet;
+    shapedQueue.frames.pop_front();
+    if (!shapedQueue.frames.empty()) {
+        heads.push_back(HeadEntry { shapedQueue.frames.front().eligibilityTime,
+                shapedQueueIndex });
+        std::push_heap(heads.begin(), heads.end(), std::greater<HeadEntry>());
+    }
+    return packet;
+}
+
+void AsynchronousTrafficShaper::updateEligibility() {
+    if (heads.empty()) {
+        cancelEvent(&eligibilityMsg);
+        return;
+    }
+    if (isHeadEligible()) {
+        cancelEvent(&eligibilityMsg);
+        transmissionGate->packetEnqueued();
+        return;
+    }
+    simtime_t eligibilityTime = heads.front().eligibilityTime;
+    if (!eligibilityMsg.isScheduled() || eligibilityMsg.getArrivalTime() != eligibilityTime) {
+        cancelEvent(&eligibilityMsg);
+        scheduleAt(eligibilityTime, &eligibilityMsg);
+    }
+}
+
+bool AsynchronousTrafficShaper::isHeadEligible() const {
+    return !heads.empty() && heads.front().eligibilityTime <= simTime();
+}
+
+bool AsynchronousTrafficShaper::isEmpty(uint64_t maxBits) {
+    if (!isHeadEligible()) {
+        return true;
+    }
+    const ShapedQueue& shapedQueue = shapedQueues[heads.front().shapedQueue];
+
+    // Overhead 8Byte from preamble
+    unsigned preambleSize = 8*8;
+    return static_cast<uint64_t>(shapedQueue.frames.front().packet->getBitLength())
+            + preambleSize > maxBits;
+}
+
+} // namespace nesting
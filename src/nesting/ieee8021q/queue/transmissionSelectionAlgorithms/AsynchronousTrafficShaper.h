@@ -0,0 +1,160 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_IEEE8021Q_QUEUE_TRANSMISSIONSELECTIONALGORITHMS_ASYNCHRONOUSTRAFFICSHAPER_H_
+#define NESTING_IEEE8021Q_QUEUE_TRANSMISSIONSELECTIONALGORITHMS_ASYNCHRONOUSTRAFFICSHAPER_H_
+
+#include <omnetpp.h>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "inet/common/packet/Packet.h"
+
+#include "nesting/common/time/TransmissionRate.h"
+#include "nesting/ieee8021q/queue/transmissionSelectionAlgorithms/TSAlgorithm.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class AsynchronousTrafficShaper: public TSAlgorithm {
+protected:
+    /** Token bucket shaper state of a flow. */
+    struct FlowShaper {
+        TransmissionRate committedInformationRate;
+        uint64_t committedBurstSize;
+        /** Time to fill an empty bucket, cached. */
+        simtime_t emptyToFullDuration;
+        /** Time at which the bucket was empty. */
+        simtime_t bucketEmptyTime;
+    };
+
+    /** Frame waiting in a shaped queue. */
+    struct ShapedFrame {
+        Packet* packet;
+        simtime_t eligibilityTime;
+    };
+
+    /** Shaped queue of an upstream port. */
+    struct ShapedQueue {
+        std::deque<ShapedFrame> frames;
+        /** Eligibility time of the last frame admitted to this queue. */
+        simtime_t groupEligibilityTime;
+    };
+
+    /** Entry of the release order heap, one per non-empty shaped queue. */
+    struct HeadEntry {
+        simtime_t eligibilityTime;
+        size_t shapedQueue;
+        bool operator>(const HeadEntry& other) const;
+    };
+
+    TransmissionRate defaultCommittedInformationRate;
+    uint64_t defaultCommittedBurstSize;
+    simtime_t maxResidenceTime;
+
+    /** Shaper states by flow id. */
+    std::unordered_map<uint64_t, FlowShaper> flowShapers;
+
+    std::vector<ShapedQueue> shapedQueues;
+
+    /** Shaped queue index by upstream interface id. */
+    std::unordered_map<int, size_t> shapedQueueIndices;
+
+    /** Min-heap of shaped queue heads ordered by eligibility time. */
+    std::vector<HeadEntry> heads;
+
+    /**
+     * Self message scheduled at the eligibility time of the earliest frame if
+     * it isn't eligible yet.
+     */
+    cMessage eligibilityMsg = cMessage("eligibility");
+
+    uint64_t numFramesShaped = 0;
+    uint64_t numFramesDropped = 0;
+    simsignal_t eligibilityDelaySignal;
+    simsignal_t dropPkSignal;
+
+protected:
+    virtual void initialize() override;
+
+    virtual void handleMessage(cMessage* msg) override;
+
+    virtual void refreshDisplay() const override;
+
+    /** Takes the frames from the input queue. */
+    virtual void handlePacketEnqueuedEvent() override;
+
+    /** Sends the earliest eligible frame. */
+    virtual void handleRequestPacketEvent(uint64_t maxBits) override;
+
+    /** Reads per-flow shaper parameters. */
+    virtual void loadFlows(cXMLElement* xml);
+
+    /** Returns the shaper of a flow, created with default parameters. */
+    virtual FlowShaper& getFlowShaper(uint64_t flowId);
+
+    /** Returns the shaped queue for an upstream interface. */
+    virtual ShapedQueue& getShapedQueue(int interfaceId, size_t& index);
+
+    /** Calculates the eligibility time and enqueues a frame from the input. */
+    virtual void shapeFrame(Packet* packet);
+
+    /**
+     * Takes all frames from the input queue by method calls. They stay
+     * charged to its buffer until they are sent or discarded.
+     */
+    virtual void holdFrames();
+
+    /** Removes the earliest frame from its shaped queue. */
+    virtual Packet* popHeadFrame();
+
+    /**
+     * Notifies the transmission gate if the earliest frame is eligible,
+     * otherwise points the eligibility timer to it.
+     */
+    virtual void updateEligibility();
+
+    /** Returns true if the earliest frame is eligible. */
+    virtual bool isHeadEligible() const;
+
+    static FlowShaper createFlowShaper(double committedInformationRate,
+            uint64_t committedBurstSize);
+
+public:
+    virtual ~AsynchronousTrafficShaper();
+
+    /**
+     * Returns true if no frame is eligible or the earliest eligible frame
+     * doesn't fit into maxBits.
+     */
+    virtual bool isEmpty(uint64_t maxBits) override;
+
+    /**
+     * Frames are held in the shaped queues and bucket state is updated when
+     * they pass, so frames can't be requeued.
+     */
+    virtual bool isPrefetchable() override {
+        return false;
+    }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_TRANSMISSIONSELECTIONALGORITHMS_ASYNCHRONOUSTRAFFICSHAPER_H_ */
@@ -15,13 +15,15 @@
 
 #include "nesting/ieee8021q/queue/transmissionSelectionAlgorithms/CreditBasedShaper.h"
 
+#include <cmath>
+#include <limits>
+
 namespace nesting {
 
 Define_Module(CreditBasedShaper);
 
 CreditBasedShaper::~CreditBasedShaper() {
-    cancelEvent(&endSpendingCreditMessage);
-    cancelEvent(&reachedZeroCreditMessage);
+    cancelEvent(&wakeUpMessage);
 }
 
 void CreditBasedShaper::initialize() {
@@ -38,6 +40,17 @@ void CreditBasedShaper::initialize() {
         throw cRuntimeError(
                 "Value of idleSlope for credit-based-shaper must be in the range (0,1)");
     }
+    WATCH(idleSlope);
+    WATCH(sendSlope);
+    WATCH(creditUnitsPerBit);
+
+    // Slopes are cached and only recalculated when the interface
+    // configuration (e.g. the datarate) changes. The Mac module might not know
+    // its transmission rate yet, see ensureSlopes().
+    if (getPortTransmitRate() > 0) {
+        updateSlopes();
+    }
+    getContainingNode(this)->subscribe(interfaceConfigChangedSignal, this);
 
     // Initialize state
     updateState(kIdle);
@@ -45,10 +58,8 @@ void CreditBasedShaper::initialize() {
 
 void CreditBasedShaper::handleMessage(cMessage* msg) {
     if (msg->isSelfMessage()) {
-        if (msg == &endSpendingCreditMessage) {
-            handleEndSpendingCreditEvent();
-        } else if (msg == &reachedZeroCreditMessage) {
-            handleZeroCreditReachedEvent();
+        if (msg == &wakeUpMessage) {
+            handleWakeUpEvent();
         } else {
             TSAlgorithm::handleMessage(msg);
         }
@@ -61,55 +72,172 @@ void CreditBasedShaper::handleMessage(cMessage* msg) {
 
 void CreditBasedShaper::refreshDisplay() const {
     char buf[80];
-    sprintf(buf, "credit-based\ncredit: %d", static_cast<int>(credit));
+    sprintf(buf, "credit-based\ncredit: %d", static_cast<int>(creditToBits(credit)));
     getDisplayString().setTagArg("t", 0, buf);
 }
 
-double CreditBasedShaper::getIdleSlope() {
-    return idleSlopeFactor * getPortTransmitRate();
+uint64_t CreditBasedShaper::getIdleSlope() {
+    ensureSlopes();
+    return idleSlope;
 }
 
-double CreditBasedShaper::getSendSlope() {
-    return getPortTransmitRate() - getIdleSlope();
+uint64_t CreditBasedShaper::getSendSlope() {
+    ensureSlopes();
+    return sendSlope;
 }
 
 double CreditBasedShaper::getPortTransmitRate() {
-    return mac->getTxRate();
+    // The rate cached by the Mac is only empty before the Mac has read its
+    // channel or while the link is down.
+    return mac->getLinkTiming().getRate().getBitsPerSecond();
+}
+
+void CreditBasedShaper::ensureSlopes() {
+    if (portTransmitRate.isZero()) {
+        updateSlopes();
+    }
+}
+
+void CreditBasedShaper::receiveSignal(cComponent *source, simsignal_t signalID,
+        cObject *obj, cObject *details) {
+    Enter_Method_Silent();
+    if (signalID != interfaceConfigChangedSignal || portTransmitRate.isZero()
+            || getPortTransmitRate() <= 0
+            || portTransmitRate.getBitsPerSecond() == getPortTransmitRate()) {
+        return;
+    }
+
+    // Account credit earned with the former rate before switching slopes.
+    advance();
+    if (state == kEarnCredit) {
+        earnCredits(simTime() - lastEventTimestamp);
+        updateState(kEarnCredit);
+    }
+    updateSlopes();
+    if (state == kEarnCredit && !isCreditPositive()) {
+        scheduleWakeUp(zeroCreditTime());
+    }
+}
+
+void CreditBasedShaper::updateSlopes() {
+    if (!portTransmitRate.update(getPortTransmitRate())) {
+        return;
+    }
+    if (portTransmitRate.isZero()) {
+        throw cRuntimeError("Credit-based shaper requires a port transmit rate greater than zero.");
+    }
+
+    const uint64_t ps = TransmissionRate::kPicosecondsPerSecond;
+    uint64_t rate = portTransmitRate.getBitsPerSecond();
+    idleSlope = std::min<uint64_t>(rate, std::llround(idleSlopeFactor * rate));
+    sendSlope = rate - idleSlope;
+
+    // Smallest credit unit for which both slopes are integral per picosecond.
+    // Both denominators divide one second in picoseconds, so does their lcm.
+    uint64_t idleDenominator = ps / TransmissionRate::gcd(idleSlope, ps);
+    uint64_t sendDenominator = ps / TransmissionRate::gcd(sendSlope, ps);
+    int64_t newCreditUnitsPerBit = idleDenominator
+            / TransmissionRate::gcd(idleDenominator, sendDenominator) * sendDenominator;
+
+    // Rescale credit that was accumulated with the former transmission rate.
+    if (credit != 0 && newCreditUnitsPerBit != creditUnitsPerBit) {
+        credit = static_cast<int64_t>(std::floor(static_cast<long double>(credit)
+                * newCreditUnitsPerBit / creditUnitsPerBit));
+    }
+
+    creditUnitsPerBit = newCreditUnitsPerBit;
+    idleSlopeCreditUnits = idleSlope / (ps / creditUnitsPerBit);
+    sendSlopeCreditUnits = sendSlope / (ps / creditUnitsPerBit);
 }
 
-double CreditBasedShaper::creditsForTime(double creditPerSecond,
+int64_t CreditBasedShaper::creditsForTime(int64_t creditUnitsPerPicosecond,
         simtime_t time) {
-    assert(creditPerSecond > 0);
+    assert(creditUnitsPerPicosecond > 0);
     assert(time >= SimTime::ZERO);
-    double timeInSeconds = time / SimTime(1, SIMTIME_S);
-    return timeInSeconds * creditPerSecond;
-
+    int64_t picoseconds = TransmissionRate::toPicoseconds(time);
+    if (picoseconds > std::numeric_limits<int64_t>::max() / creditUnitsPerPicosecond) {
+        return std::numeric_limits<int64_t>::max();
+    }
+    return picoseconds * creditUnitsPerPicosecond;
 }
 
-simtime_t CreditBasedShaper::timeForCredits(double creditPerSecond,
-        double credit) {
-    assert(creditPerSecond > 0);
+simtime_t CreditBasedShaper::timeForCredits(int64_t creditUnitsPerPicosecond,
+        int64_t credit) {
+    assert(creditUnitsPerPicosecond > 0);
     assert(credit >= 0);
 
-    double seconds = credit / creditPerSecond;
-    return seconds * SimTime(1, SIMTIME_S);
+    // Round up, so that at least the given amount of credit is earned/spent.
+    int64_t picoseconds = credit / creditUnitsPerPicosecond
+            + (credit % creditUnitsPerPicosecond != 0 ? 1 : 0);
+    return TransmissionRate::fromPicoseconds(picoseconds);
+}
+
+double CreditBasedShaper::creditToBits(int64_t credit) const {
+    return static_cast<double>(credit) / creditUnitsPerBit;
 }
 
 simtime_t CreditBasedShaper::zeroCreditTime() {
     assert(credit < 0);
-    return simTime() + timeForCredits(getIdleSlope(), 0 - credit);
+    ensureSlopes();
+    return lastEventTimestamp + timeForCredits(idleSlopeCreditUnits, 0 - credit);
+}
+
+int64_t CreditBasedShaper::getCreditAt(simtime_t time) {
+    assert(time >= lastEventTimestamp);
+    switch (state) {
+    case kEarnCredit: {
+        if (credit < 0) {
+            // Credit is reset to exactly zero when reaching zero credit.
+            simtime_t zeroTime = zeroCreditTime();
+            if (time < zeroTime) {
+                return credit + creditsForTime(idleSlopeCreditUnits, time - lastEventTimestamp);
+            }
+            return creditsForTime(idleSlopeCreditUnits, time - zeroTime);
+        }
+        int64_t earnedCredit = creditsForTime(idleSlopeCreditUnits, time - lastEventTimestamp);
+        if (credit > std::numeric_limits<int64_t>::max() - earnedCredit) {
+            return std::numeric_limits<int64_t>::max();
+        }
+        return credit + earnedCredit;
+    }
+    case kSpendCredit:
+        // The credit for the frame in transmission is committed when the
+        // transmission starts.
+        return credit;
+    case kIdle:
+    default:
+        return credit;
+    }
+}
+
+void CreditBasedShaper::advance() {
+    if (state == kSpendCredit && spendEndTime <= simTime()) {
+        handleEndSpendingCredit();
+    }
+    if (state == kEarnCredit && !isCreditPositive()) {
+        simtime_t zeroTime = zeroCreditTime();
+        if (zeroTime <= simTime()) {
+            handleZeroCreditReached(zeroTime);
+        }
+    }
+}
+
+void CreditBasedShaper::scheduleWakeUp(simtime_t time) {
+    cancelEvent(&wakeUpMessage);
+    scheduleAt(time, &wakeUpMessage);
 }
 
 simtime_t CreditBasedShaper::transmissionTime(Packet* packet) {
+    ensureSlopes();
     // Ieee8021q::getFinalEthernet2FrameBitLength(packet) is somehow wrong (1704B instead of correctly 1521B + 8B PHY + IFG)
-    int lengthInBits = packet->getBitLength() + (21 + 8 + 12) * 8;
-    simtime_t transmissionTime = timeForCredits(getPortTransmitRate(), lengthInBits);
+    uint64_t lengthInBits = packet->getBitLength() + (21 + 8 + 12) * 8;
+    simtime_t transmissionTime = portTransmitRate.durationForBits(lengthInBits);
     return transmissionTime;
 }
 
-void CreditBasedShaper::updateState(State newState) {
+void CreditBasedShaper::updateState(State newState, simtime_t time) {
     state = newState;
-    lastEventTimestamp = simTime();
+    lastEventTimestamp = time;
 
     EV_DEBUG << getFullPath() << ": New state: [state=";
     switch (state) {
@@ -123,24 +251,32 @@ void CreditBasedShaper::updateState(State newState) {
         EV_DEBUG << "earnCredit";
         break;
     }
-    EV_DEBUG << ",credit=" << credit << "]" << endl;
+    EV_DEBUG << ",credit=" << creditToBits(credit) << ",time=" << time << "]" << endl;
+}
+
+void CreditBasedShaper::updateState(State newState) {
+    updateState(newState, simTime());
 }
 
 void CreditBasedShaper::spendCredit(Packet* packet) {
-    double spendCredit = creditsForTime(getSendSlope(), transmissionTime(packet));
+    simtime_t time = transmissionTime(packet);
+    int64_t spendCredit = creditsForTime(sendSlopeCreditUnits, time);
     credit -= spendCredit;
+    spendEndTime = simTime() + time;
 
-    EV_DEBUG << getFullPath() << ": Spending " << spendCredit << " credit for " << packet->getBitLength() << " bits payload." << endl;
-    EV_WARN << getFullPath() << ": Spending " << spendCredit << " credit = "
-        << packet->getByteLength() + (21 + 8 + 12) << "B / " << getSendSlope() << " slope" << endl;
+    EV_DEBUG << getFullPath() << ": Spending " << creditToBits(spendCredit) << " credit for " << packet->getBitLength() << " bits payload." << endl;
 }
 
 void CreditBasedShaper::earnCredits(simtime_t time) {
-    double earnedCredit = creditsForTime(getIdleSlope(), time);
-    credit += earnedCredit;
+    ensureSlopes();
+    int64_t earnedCredit = creditsForTime(idleSlopeCreditUnits, time);
+    if (credit > std::numeric_limits<int64_t>::max() - earnedCredit) {
+        credit = std::numeric_limits<int64_t>::max();
+    } else {
+        credit += earnedCredit;
+    }
 
-    EV_DEBUG << getFullPath() << ": Earned " << earnedCredit << " credit." << endl;
-    EV_WARN << getFullPath() << ": Earned " << earnedCredit << " credit = " << time << " time * " << getIdleSlope() << " slope" << endl;
+    EV_DEBUG << getFullPath() << ": Earned " << creditToBits(earnedCredit) << " credit." << endl;
 }
 
 void CreditBasedShaper::resetCredit() {
@@ -150,7 +286,7 @@ void CreditBasedShaper::resetCredit() {
 }
 
 bool CreditBasedShaper::isCreditPositive() {
-    return credit >= 0.0;
+    return credit >= 0;
 }
 
 bool CreditBasedShaper::isPacketReadyForTransmission() {
@@ -159,15 +295,19 @@ bool CreditBasedShaper::isPacketReadyForTransmission() {
 }
 
 void CreditBasedShaper::handleGateStateChangedEvent() {
-    if (transmissionGate->isGateOpen()) {
+    // Transitions that were due before the gate changed still see the former
+    // gate state.
+    advance();
+    gateOpen = transmissionGate->isGateOpen();
+
+    if (gateOpen) {
         assert(state != kEarnCredit);
         EV_TRACE << getFullPath() << ": Handle gate opened event." << endl;
         if (state == kIdle && !isCreditPositive()) {
             EV_DEBUG << getFullPath() << ": Credit negative." << endl;
-            EV_DEBUG << getFullPath() << ": Zero credit scheduled for " << zeroCreditTime() << "(+" << timeForCredits(getIdleSlope(), 0 - credit) << ")" << endl;
             updateState(kEarnCredit);
-            scheduleAt(zeroCreditTime(), &reachedZeroCreditMessage);
-            // if isPacketReadyForTransmission() handle in reachedZeroCredit
+            scheduleWakeUp(zeroCreditTime());
+            // if isPacketReadyForTransmission() handle in handleWakeUpEvent
         }
         else if (state == kIdle && isPacketReadyForTransmission()) { // credit is positive
             updateState(kEarnCredit);
@@ -176,12 +316,12 @@ void CreditBasedShaper::handleGateStateChangedEvent() {
     } else {
         EV_TRACE << getFullPath() << ": Handle gate closed event." << endl;
         if (state == kEarnCredit) {
-            cancelEvent(&reachedZeroCreditMessage);
+            cancelEvent(&wakeUpMessage);
             earnCredits(simTime() - lastEventTimestamp);
             updateState(kIdle);
         }
     }
-    // if kSpendCredit: do nothing, handle in handleEndSpendingCreditEvent
+    // if kSpendCredit: do nothing, handled lazily at the end of spending
 }
 
 void CreditBasedShaper::handlePacketEnqueuedEvent() {
@@ -189,6 +329,7 @@ void CreditBasedShaper::handlePacketEnqueuedEvent() {
 
     EV_TRACE << getFullPath() << ": Handle packet enqueued event." << endl;
 
+    advance();
     if (state == kIdle && transmissionGate->isGateOpen()) { // queue was empty
         updateState(kEarnCredit);
         assert(isCreditPositive());
@@ -197,72 +338,78 @@ void CreditBasedShaper::handlePacketEnqueuedEvent() {
 }
 
 void CreditBasedShaper::handleSendPacketEvent(Packet* packet) {
+    advance();
+
     assert(state == kEarnCredit);
     assert(isCreditPositive());
-    assert(!reachedZeroCreditMessage.isScheduled());
 
     EV_TRACE << getFullPath() << ": Handle send packet event." << endl;
 
     earnCredits(simTime() - lastEventTimestamp);
     updateState(kSpendCredit);
     spendCredit(packet);
+    gateOpen = transmissionGate->isGateOpen();
 
-    EV_DEBUG << getFullPath() << ": handleEndSpendingCreditEvent scheduled for " << simTime() + transmissionTime(packet) << "(+" << transmissionTime(packet) << ")" << endl;
-    scheduleAt(simTime() + transmissionTime(packet), &endSpendingCreditMessage);
+    // With positive credit the shaper might become eligible again at the end
+    // of spending, otherwise not before zero credit is reached.
+    simtime_t wakeUpTime = spendEndTime;
+    if (!isCreditPositive()) {
+        wakeUpTime += timeForCredits(idleSlopeCreditUnits, 0 - credit);
+    }
+    EV_DEBUG << getFullPath() << ": Wake-up scheduled for " << wakeUpTime << endl;
+    scheduleWakeUp(wakeUpTime);
 }
 
-void CreditBasedShaper::handleEndSpendingCreditEvent() {
+void CreditBasedShaper::handleEndSpendingCredit() {
     assert(state == kSpendCredit);
 
-    EV_TRACE << getFullPath() << ": Handle end spending credit event." << endl;
-
-    if (!transmissionGate->isGateOpen()){
+    if (!gateOpen) {
         EV_DEBUG << getFullPath() << ": Gate not open." << endl;
-        updateState(kIdle);
+        updateState(kIdle, spendEndTime);
     }
-    else if (!isCreditPositive()){
+    else if (!isCreditPositive()) {
         EV_DEBUG << getFullPath() << ": Credit negative." << endl;
-        EV_DEBUG << getFullPath() << ": Zero credit scheduled for " << zeroCreditTime() << "(+" << timeForCredits(getIdleSlope(), 0 - credit) << ")" << endl;
-        updateState(kEarnCredit);
-        scheduleAt(zeroCreditTime(), &reachedZeroCreditMessage);
+        updateState(kEarnCredit, spendEndTime);
     }
     else if (!isPacketReadyForTransmission()) {
         EV_DEBUG << getFullPath() << ": Queue empty." << endl;
-        updateState(kIdle);
+        updateState(kIdle, spendEndTime);
         resetCredit();
-    } 
+    }
     else { // open positive ready => send
-        EV_DEBUG << getFullPath() << ": Ready to transmit." << endl;
-        updateState(kEarnCredit);
-        transmissionGate->packetEnqueued();
+        updateState(kEarnCredit, spendEndTime);
     }
 }
 
-void CreditBasedShaper::handleZeroCreditReachedEvent() {
+void CreditBasedShaper::handleZeroCreditReached(simtime_t time) {
     assert(state == kEarnCredit);
-    assert(transmissionGate->isGateOpen());
-
-    EV_TRACE << getFullPath() << ": Handle zero credit reached event." << endl;
 
-    earnCredits(simTime() - lastEventTimestamp);
-    EV_WARN << getFullPath() << ": credit " << credit << " isCreditPositive " << isCreditPositive() << endl;
-    assert(credit >= - 0.1); // allowed rounding error
+    // Zero credit time is rounded up, so the credit can't be negative here.
     resetCredit();
 
     if (isPacketReadyForTransmission()) {
-        EV_DEBUG << getFullPath() << ": Ready to transmit." << endl;
-        updateState(kEarnCredit);
-        transmissionGate->packetEnqueued();
+        updateState(kEarnCredit, time);
     }
     else { // queue empty
         EV_DEBUG << getFullPath() << ": Queue empty." << endl;
-        updateState(kIdle);
-        resetCredit();
-    } 
+        updateState(kIdle, time);
+    }
+}
+
+void CreditBasedShaper::handleWakeUpEvent() {
+    EV_TRACE << getFullPath() << ": Handle wake-up event." << endl;
+
+    advance();
+    if (state == kEarnCredit && isCreditPositive() && gateOpen
+            && isPacketReadyForTransmission()) {
+        EV_DEBUG << getFullPath() << ": Ready to transmit." << endl;
+        transmissionGate->packetEnqueued();
+    }
 }
 
 bool CreditBasedShaper::isEmpty(uint64_t maxBits) {
-    return !isCreditPositive() || queue->isEmpty(maxBits);
+    advance();
+    return getCreditAt(simTime()) < 0 || queue->isEmpty(maxBits);
 }
 
 } // namespace nesting
@@ -20,8 +20,10 @@
 
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/packet/Packet.h"
+#include "inet/common/Simsignals.h"
 
 #include "nesting/ieee8021q/Ieee8021q.h"
+#include "nesting/common/time/LinkTiming.h"
 #include "nesting/ieee8021q/queue/transmissionSelectionAlgorithms/TSAlgorithm.h"
 
 using namespace omnetpp;
@@ -31,7 +33,7 @@ namespace nesting {
 /**
  * See the NED file for a detailed description.
  */
-class CreditBasedShaper: public TSAlgorithm {
+class CreditBasedShaper: public TSAlgorithm, public cListener {
 protected:
     /**
      * Enumeration to represent the internal state of the credit-based-shaper
@@ -51,9 +53,35 @@ protected:
     double idleSlopeFactor;
 
     /**
-     * Credit balance.
+     * Fixed-point transmission rate of the Mac module. The slopes below are
+     * recalculated whenever the transmission rate changes.
      */
-    double credit;
+    TransmissionRate portTransmitRate;
+
+    /** Idle slope in bits per second. */
+    uint64_t idleSlope = 0;
+
+    /** Send slope in bits per second. */
+    uint64_t sendSlope = 0;
+
+    /**
+     * Credit is kept in integral units of 1/creditUnitsPerBit bits. The scale
+     * is chosen so that both slopes are integral credit units per picosecond,
+     * which makes earning and spending credit exact.
+     */
+    int64_t creditUnitsPerBit = 1;
+
+    /** Idle slope in credit units per picosecond. */
+    int64_t idleSlopeCreditUnits = 0;
+
+    /** Send slope in credit units per picosecond. */
+    int64_t sendSlopeCreditUnits = 0;
+
+    /**
+     * Credit balance in credit units at lastEventTimestamp. The credit at
+     * other points in time is derived from it, see getCreditAt().
+     */
+    int64_t credit;
 
     /**
      * Internal state.
@@ -67,16 +95,24 @@ protected:
     simtime_t lastEventTimestamp;
 
     /**
-     * Self message used to signal the end of a credit spending period.
+     * End of the current credit spending period. The transition at the end of
+     * spending is applied lazily by advance().
      */
-    cMessage endSpendingCreditMessage = cMessage("endSpendingCredit");
+    simtime_t spendEndTime;
 
     /**
-     * Self message used to signal that zero credits are reached. This is
-     * necessary because reaching a positive amount of credits can trigger a
-     * packet-enqueued event subsequent queuing components.
+     * Gate state as of the last transmission or handled gate state change.
+     * Used to apply the end of spending lazily.
      */
-    cMessage reachedZeroCreditMessage = cMessage("reachedZeroCredit");
+    bool gateOpen = false;
+
+    /**
+     * Self message scheduled at the next point in time at which the shaper
+     * might become eligible for transmission: the end of spending if credit
+     * is positive, otherwise the time zero credit is reached. There is at
+     * most one such event per transmitted frame.
+     */
+    cMessage wakeUpMessage = cMessage("wakeUp");
 
     /** @copydoc cSimpleModule::initialize() */
     virtual void initialize() override;
@@ -87,11 +123,32 @@ protected:
     /** @copydoc cSimpleModule::refreshDisplay() const */
     virtual void refreshDisplay() const override;
 
-    /** This method calculates the idleSlope value in credits per second. */
-    virtual double getIdleSlope();
+    /** This method returns the cached idleSlope value in bits per second. */
+    virtual uint64_t getIdleSlope();
+
+    /** This method returns the cached sendSlope value in bits per second. */
+    virtual uint64_t getSendSlope();
+
+    /**
+     * Recalculates the fixed-point slopes if the transmission rate of the Mac
+     * module changed. Called on initialization and on interface
+     * configuration changes.
+     */
+    virtual void updateSlopes();
+
+    /**
+     * Calculates the slopes if the transmission rate was not known yet when
+     * the module was initialized.
+     */
+    virtual void ensureSlopes();
 
-    /** This method calculates the sendSlope value in credits per second. */
-    virtual double getSendSlope();
+    /**
+     * Recalculates the slopes if the transmission rate changed.
+     *
+     * @see cListener::receiveSignal()
+     */
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID,
+            cObject *obj, cObject *details) override;
 
     /**
      * This method returns the associated Mac port transmit rate in bits per
@@ -100,43 +157,67 @@ protected:
     virtual double getPortTransmitRate();
 
     /**
-     * For a given credit rate per second and a given time interval, this
-     * method calculates the associated amount of credits.
+     * For a given credit rate and a given time interval, this method
+     * calculates the associated amount of credits.
      *
-     * @param creditPerSecond The rate of earned/spend credit in credits
-     *                        per second. This value must be greater than
-     *                        zero.
-     * @param time            The time interval to calculate the earned/spend
-     *                        credits for. This value must be greater or equal
-     *                        than zero.
-     * @return                The amount of credit earned/generated.
+     * @param creditUnitsPerPicosecond The rate of earned/spend credit in
+     *                                 credit units per picosecond. This value
+     *                                 must be greater than zero.
+     * @param time                     The time interval to calculate the
+     *                                 earned/spend credits for. This value
+     *                                 must be greater or equal than zero.
+     * @return                         The amount of credit units
+     *                                 earned/generated.
      */
-    virtual double creditsForTime(double creditPerSecond, simtime_t time);
+    virtual int64_t creditsForTime(int64_t creditUnitsPerPicosecond, simtime_t time);
 
     /**
-     * For a given credit earning/spending rate in credits per second and a
-     * given amount of credits. This method calculates how long it takes to
-     * spend/accumulate the amount of credit.
+     * For a given credit earning/spending rate and a given amount of credits,
+     * this method calculates how long it takes to spend/accumulate the amount
+     * of credit. The result is rounded up to whole picoseconds.
      *
-     * @param creditPerSecond The rate of earned/spend credit in credits
-     *                        per second. This value must be greater than
-     *                        zero.
-     * @param credit          The amount of credit to earn/spend.
-     * @result                The time interval that is needed to earn/spend
-     *                        the given amount of credit.
+     * @param creditUnitsPerPicosecond The rate of earned/spend credit in
+     *                                 credit units per picosecond. This value
+     *                                 must be greater than zero.
+     * @param credit                   The amount of credit units to
+     *                                 earn/spend.
+     * @result                         The time interval that is needed to
+     *                                 earn/spend the given amount of credit.
      */
-    virtual simtime_t timeForCredits(double creditPerSecond, double credit);
+    virtual simtime_t timeForCredits(int64_t creditUnitsPerPicosecond, int64_t credit);
+
+    /** Converts credit units to bits, e.g. for logging. */
+    virtual double creditToBits(int64_t credit) const;
 
     /**
-     * Returns the time needed to earn enough credits to reach zero or rather a
-     * positive amount of credit.
+     * Returns the point in time at which zero credit is reached when earning
+     * credit since lastEventTimestamp.
      */
     virtual simtime_t zeroCreditTime();
 
+    /**
+     * Returns the credit at a given point in time not before
+     * lastEventTimestamp, evaluated in closed form from the current state.
+     */
+    virtual int64_t getCreditAt(simtime_t time);
+
+    /**
+     * Applies the state transitions at the end of spending and when reaching
+     * zero credit, if they are due, at their exact points in time. Does not
+     * notify the transmission gate.
+     */
+    virtual void advance();
+
+    /** Points the wake-up message to a new point in time. */
+    virtual void scheduleWakeUp(simtime_t time);
+
     /** Calculates the time needed to transmit a packet. */
     virtual simtime_t transmissionTime(Packet* packet);
 
-    /** Transitions the module into a new state. */
+    /** Transitions the module into a new state at a given point in time. */
+    virtual void updateState(State newState, simtime_t time);
+
+    /** Transitions the module into a new state at the current time. */
     virtual void updateState(State newState);
 
     /** Spend the necessary amount of credit for a given packet to transmit. */
@@ -173,21 +254,31 @@ protected:
     virtual void handleSendPacketEvent(Packet* packet);
 
     /**
-     * Handle state changes and triggering events after finishing spending
-     * credit.
+     * Handle state changes after finishing spending credit at spendEndTime.
      */
-    virtual void handleEndSpendingCreditEvent();
+    virtual void handleEndSpendingCredit();
 
     /**
-     * Handle state changes and triggering events after acquiring zero credits
-     * and therefore becoming able to transmit packets.
+     * Handle state changes after acquiring zero credits at the given point in
+     * time.
      */
-    virtual void handleZeroCreditReachedEvent();
+    virtual void handleZeroCreditReached(simtime_t time);
+
+    /**
+     * Applies due state transitions and notifies the transmission gate if
+     * the shaper became eligible for transmission.
+     */
+    virtual void handleWakeUpEvent();
 
 public:
     ~CreditBasedShaper();
 
     virtual bool isEmpty(uint64_t maxBits) override;
+
+    /** Credit is spent when a frame passes, so frames can't be requeued. */
+    virtual bool isPrefetchable() override {
+        return false;
+    }
 };
 
 } // namespace nesting
@@ -27,7 +27,7 @@ TSAlgorithm::~TSAlgorithm() {
 
 void TSAlgorithm::initialize() {
     cModule* macModule = getModuleFromPar<cModule>(par("macModule"), this);
-    mac = check_and_cast<EtherMacBase*>(macModule);
+    mac = check_and_cast<ITsnMac*>(macModule);
     queue = getModuleFromPar<LengthAwareQueue>(par("queueModule"), this);
     transmissionGate = getModuleFromPar<TransmissionGate>(par("gateModule"),
             this);
@@ -92,5 +92,21 @@ void TSAlgorithm::requestPacket(uint64_t maxBits) {
 bool TSAlgorithm::isExpressQueue() {
     return queue->isExpressQueue();
 }
+
+bool TSAlgorithm::isPrefetchable() {
+    return true;
+}
+
+cPacket* TSAlgorithm::prefetchPacket(uint64_t maxBits) {
+    return queue->prefetchPacket(maxBits);
+}
+
+void TSAlgorithm::commitPacket(cPacket* packet) {
+    queue->commitPacket(packet);
+}
+
+void TSAlgorithm::requeuePacket(cPacket* packet) {
+    queue->requeue(packet);
+}
 }
 /* namespace nesting */
@@ -19,11 +19,11 @@
 #include "omnetpp.h"
 
 #include "inet/common/ModuleAccess.h"
-#include "inet/linklayer/ethernet/EtherMacBase.h"
 
 #include "nesting/ieee8021q/queue/gating/TransmissionGate.h"
 #include "nesting/ieee8021q/queue/framePreemption/LengthAwareQueue.h"
 #include "nesting/ieee8021q/queue/framePreemption/IPreemptableQueue.h"
+#include "nesting/linklayer/common/ITsnMac.h"
 
 using namespace omnetpp;
 using namespace inet;
@@ -41,7 +41,7 @@ protected:
     /**
      * Reference to the Mac module.
      */
-    EtherMacBase* mac;
+    ITsnMac* mac;
 
     /**
      * Reference to the length-aware input queue module.
@@ -90,6 +90,27 @@ public:
 
     virtual bool isExpressQueue();
 
+    /**
+     * Returns true if packets of this algorithm can be prefetched and handed
+     * back by requeuePacket() without affecting its state.
+     */
+    virtual bool isPrefetchable();
+
+    /**
+     * Takes the next packet from the input queue right away, see
+     * LengthAwareQueue::prefetchPacket().
+     */
+    virtual cPacket* prefetchPacket(uint64_t maxBits);
+
+    /** Passes a prefetched packet on, see LengthAwareQueue::commitPacket(). */
+    virtual void commitPacket(cPacket* packet);
+
+    /**
+     * Puts a prefetched packet that could not be transmitted back to the
+     * head of the input queue.
+     */
+    virtual void requeuePacket(cPacket* packet);
+
 };
 
 } /* namespace nesting */
@@ -17,6 +17,8 @@
 
 #include "inet/common/ModuleAccess.h"
 
+#include <algorithm>
+
 namespace nesting {
 
 Define_Module(FilteringDatabase);
@@ -87,6 +89,56 @@ void FilteringDatabase::loadDatabase(cXMLElement* xml) {
 
     operFdb.swap(adminFdb);
     clearAdminFdb();
+    rebuildPortEntries();
+}
+
+void FilteringDatabase::rebuildPortEntries() {
+    portEntries.clear();
+    for (auto& entry : operFdb) {
+        Entry& e = entry.second;
+        e.prevOnPort = nullptr;
+        e.nextOnPort = nullptr;
+        if (e.address.isMulticast()) {
+            for (int interfaceId : e.interfaceIds) {
+                portEntries[interfaceId].multicastAddresses.push_back(e.address);
+            }
+        } else {
+            linkToPort(&e, e.interfaceIds.at(0));
+        }
+    }
+}
+
+void FilteringDatabase::linkToPort(Entry* entry, int interfaceId) {
+    PortEntries& port = portEntries[interfaceId];
+    entry->prevOnPort = nullptr;
+    entry->nextOnPort = port.unicastHead;
+    if (port.unicastHead != nullptr) {
+        port.unicastHead->prevOnPort = entry;
+    }
+    port.unicastHead = entry;
+}
+
+void FilteringDatabase::unlinkFromPort(Entry* entry) {
+    if (entry->prevOnPort != nullptr) {
+        entry->prevOnPort->nextOnPort = entry->nextOnPort;
+    } else {
+        auto port = portEntries.find(entry->interfaceIds.at(0));
+        if (port != portEntries.end() && port->second.unicastHead == entry) {
+            port->second.unicastHead = entry->nextOnPort;
+        }
+    }
+    if (entry->nextOnPort != nullptr) {
+        entry->nextOnPort->prevOnPort = entry->prevOnPort;
+    }
+    entry->prevOnPort = nullptr;
+    entry->nextOnPort = nullptr;
+}
+
+void FilteringDatabase::erase(Table::iterator it) {
+    if (!it->second.address.isMulticast()) {
+        unlinkFromPort(&it->second);
+    }
+    operFdb.erase(it);
 }
 
 void FilteringDatabase::parseEntries(cXMLElement* xml) {
@@ -129,7 +181,10 @@ void FilteringDatabase::parseEntries(cXMLElement* xml) {
             if (!macAddress.tryParse(macAddressStr.c_str())) {
                 throw new cRuntimeError("Cannot parse invalid Mac address.");
             }
-            adminFdb.insert({macAddress, std::pair<simtime_t, std::vector<int>>(0, interfaceIds)});
+            Entry& entry = adminFdb[macAddress];
+            entry.address = macAddress;
+            entry.interfaceIds = interfaceIds;
+            entry.isStatic = true;
         } else {
             // TODO
             throw cRuntimeError(
@@ -186,7 +241,10 @@ void FilteringDatabase::parseEntries(cXMLElement* xml) {
                 throw new cRuntimeError(
                         "Mac address is not a Multicast address.");
             }
-            adminFdb.insert({macAddress, std::pair<simtime_t, std::vector<int>>(0, destInterfaces)});
+            Entry& entry = adminFdb[macAddress];
+            entry.address = macAddress;
+            entry.interfaceIds = destInterfaces;
+            entry.isStatic = true;
         } else {
             // TODO
             throw cRuntimeError(
@@ -200,32 +258,42 @@ void FilteringDatabase::handleMessage(cMessage *msg) {
 }
 
 void FilteringDatabase::insert(MacAddress macAddress, simtime_t curTS, int interfaceId) {
-    std::vector<int> tmp;
-    tmp.insert(tmp.begin(), 1, interfaceId);
-    operFdb[macAddress] = std::pair<simtime_t, std::vector<int>>(curTS, tmp);
+    auto it = operFdb.find(macAddress);
+    if (it == operFdb.end()) {
+        Entry& entry = operFdb[macAddress];
+        entry.address = macAddress;
+        entry.lastSeen = curTS;
+        entry.interfaceIds.push_back(interfaceId);
+        linkToPort(&entry, interfaceId);
+        return;
+    }
+    // A learned address replaces the previous entry, even a static one
+    Entry& entry = it->second;
+    if (entry.interfaceIds.size() != 1 || entry.interfaceIds[0] != interfaceId) {
+        unlinkFromPort(&entry);
+        entry.interfaceIds.assign(1, interfaceId);
+        linkToPort(&entry, interfaceId);
+    }
+    entry.lastSeen = curTS;
+    entry.isStatic = false;
 }
 
 int FilteringDatabase::getDestInterfaceId(MacAddress macAddress, simtime_t curTS) {
-    simtime_t ts;
-    std::vector<int> port;
-
     auto it = operFdb.find(macAddress);
 
     //is element available?
     if (it != operFdb.end()) {
-        ts = it->second.first;
-        port = it->second.second;
+        Entry& entry = it->second;
         // return if mac address belongs to multicast
-        if (port.size() != 1) {
+        if (entry.interfaceIds.size() != 1) {
             return -1;
         }
-        // static entries (ts == 0) do not age
-        if (!agingActive || (ts == 0 || curTS - ts < agingThreshold)) {
-            operFdb[macAddress] = std::pair<simtime_t, std::vector<int>>(curTS,
-                    port);
-            return port.at(0);
+        // static entries do not age
+        if (!agingActive || entry.isStatic || curTS - entry.lastSeen < agingThreshold) {
+            entry.lastSeen = curTS;
+            return entry.interfaceIds[0];
         } else {
-            operFdb.erase(macAddress);
+            erase(it);
         }
     }
 
@@ -234,9 +302,6 @@ int FilteringDatabase::getDestInterfaceId(MacAddress macAddress, simtime_t curTS
 
 std::vector<int> FilteringDatabase::getDestInterfaceIds(MacAddress macAddress,
         simtime_t curTS) {
-    simtime_t ts;
-    std::vector<int> ports;
-
     if (!macAddress.isMulticast()) {
         throw cRuntimeError("Expected multicast MAC address!");
     }
@@ -245,19 +310,114 @@ std::vector<int> FilteringDatabase::getDestInterfaceIds(MacAddress macAddress,
 
     //is element available?
     if (it != operFdb.end()) {
-        ts = it->second.first;
-        ports = it->second.second;
-        // static entries (ts == 0) do not age
-        if (!agingActive || (ts == 0 || curTS - ts < agingThreshold)) {
-            operFdb[macAddress] = std::pair<simtime_t, std::vector<int>>(curTS, ports);
-            return ports;
+        Entry& entry = it->second;
+        // static entries do not age
+        if (!agingActive || entry.isStatic || curTS - entry.lastSeen < agingThreshold) {
+            entry.lastSeen = curTS;
+            return entry.interfaceIds;
         } else {
-            operFdb.erase(macAddress);
+            erase(it);
         }
+    }
+
+    return std::vector<int>();
+}
+
+std::vector<MacAddress> FilteringDatabase::portDown(int interfaceId, int backupInterfaceId) {
+    Enter_Method_Silent();
+    std::vector<MacAddress> affected;
+    auto portIt = portEntries.find(interfaceId);
+    if (portIt == portEntries.end()) {
+        return affected;
+    }
+    PortEntries& port = portIt->second;
+
+    Entry* entry = port.unicastHead;
+    while (entry != nullptr) {
+        Entry* next = entry->nextOnPort;
+        if (backupInterfaceId >= 0) {
+            unlinkFromPort(entry);
+            entry->interfaceIds[0] = backupInterfaceId;
+            linkToPort(entry, backupInterfaceId);
+            if (entry->isStatic) {
+                port.failedOverAddresses.push_back({entry->address, backupInterfaceId});
+            }
+            affected.push_back(entry->address);
+        } else if (!entry->isStatic) {
+            affected.push_back(entry->address);
+            erase(operFdb.find(entry->address));
+        }
+        entry = next;
+    }
 
+    // Static multicast entries use the backup port instead, if there is one
+    if (backupInterfaceId >= 0) {
+        // The port leaves all of its multicast entries
+        std::vector<MacAddress> multicastAddresses;
+        multicastAddresses.swap(port.multicastAddresses);
+        for (const MacAddress& address : multicastAddresses) {
+            std::vector<int>& interfaceIds = operFdb.at(address).interfaceIds;
+            auto it = std::find(interfaceIds.begin(), interfaceIds.end(), interfaceId);
+            if (std::find(interfaceIds.begin(), interfaceIds.end(), backupInterfaceId) == interfaceIds.end()) {
+                *it = backupInterfaceId;
+                portEntries[backupInterfaceId].multicastAddresses.push_back(address);
+                portEntries[interfaceId].failedOverAddresses.push_back({address, backupInterfaceId});
+            } else {
+                interfaceIds.erase(it);
+                portEntries[interfaceId].failedOverAddresses.push_back({address, -1});
+            }
+        }
     }
+    return affected;
+}
 
-    return ports;
+void FilteringDatabase::portUp(int interfaceId) {
+    Enter_Method_Silent();
+    auto portIt = portEntries.find(interfaceId);
+    if (portIt == portEntries.end()) {
+        return;
+    }
+    std::vector<std::pair<MacAddress, int>> failedOverAddresses;
+    failedOverAddresses.swap(portIt->second.failedOverAddresses);
+
+    for (const auto& failedOver : failedOverAddresses) {
+        auto it = operFdb.find(failedOver.first);
+        // Entries learned in the meantime are kept
+        if (it == operFdb.end() || !it->second.isStatic) {
+            continue;
+        }
+        Entry& entry = it->second;
+        int backupInterfaceId = failedOver.second;
+        if (!entry.address.isMulticast()) {
+            if (entry.interfaceIds[0] == backupInterfaceId) {
+                unlinkFromPort(&entry);
+                entry.interfaceIds[0] = interfaceId;
+                linkToPort(&entry, interfaceId);
+            }
+            continue;
+        }
+        auto backupIt = std::find(entry.interfaceIds.begin(), entry.interfaceIds.end(), backupInterfaceId);
+        if (backupInterfaceId >= 0 && backupIt != entry.interfaceIds.end()) {
+            *backupIt = interfaceId;
+            std::vector<MacAddress>& backupAddresses = portEntries[backupInterfaceId].multicastAddresses;
+            backupAddresses.erase(std::find(backupAddresses.begin(), backupAddresses.end(), entry.address));
+        } else {
+            entry.interfaceIds.push_back(interfaceId);
+        }
+        portEntries[interfaceId].multicastAddresses.push_back(entry.address);
+    }
+}
+
+size_t FilteringDatabase::getNumEntries(int interfaceId) const {
+    auto portIt = portEntries.find(interfaceId);
+    if (portIt == portEntries.end()) {
+        return 0;
+    }
+    size_t numEntries = portIt->second.multicastAddresses.size();
+    for (Entry* entry = portIt->second.unicastHead; entry != nullptr; entry = entry->nextOnPort) {
+        numEntries++;
+    }
+    return numEntries;
 }
 
 } // namespace nesting
@@ -19,6 +19,8 @@
 #include <omnetpp.h>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "inet/linklayer/common/MacAddress.h"
 #include "inet/networklayer/contract/IInterfaceTable.h"
@@ -44,9 +46,35 @@ namespace nesting {
  * See the NED file for a detailed description
  */
 class FilteringDatabase: public cSimpleModule {
+protected:
+    struct Entry {
+        MacAddress address;
+        simtime_t lastSeen;
+        std::vector<int> interfaceIds;
+        /** Configured entries don't age and are restored after a failover. */
+        bool isStatic = false;
+        // Unicast entries are linked into an intrusive list of their port,
+        // so the entries of a port are found without scanning the database
+        Entry* prevOnPort = nullptr;
+        Entry* nextOnPort = nullptr;
+    };
+
+    /** Entries referring to a port. */
+    struct PortEntries {
+        Entry* unicastHead = nullptr;
+        /** Static multicast entries containing the port. */
+        std::vector<MacAddress> multicastAddresses;
+        /** Static entries moved away from this port by a failover. */
+        std::vector<std::pair<MacAddress, int>> failedOverAddresses;
+    };
+
+    typedef std::unordered_map<MacAddress, Entry> Table;
 private:
-    std::unordered_map<MacAddress, std::pair<simtime_t, std::vector<int>>> adminFdb;
-    std::unordered_map<MacAddress, std::pair<simtime_t, std::vector<int>>> operFdb;
+    // Entries are never moved within the tables, so list pointers stay valid
+    Table adminFdb;
+    Table operFdb;
+
+    std::unordered_map<int, PortEntries> portEntries;
 
     bool agingActive = false;
     simtime_t agingThreshold;
@@ -64,6 +92,13 @@ protected:
 
     void clearAdminFdb();
 
+    /** Rebuilds the port lists after the database was loaded. */
+    void rebuildPortEntries();
+
+    void linkToPort(Entry* entry, int interfaceId);
+    void unlinkFromPort(Entry* entry);
+    void erase(Table::iterator it);
+
 public:
     FilteringDatabase(bool agingActive, simtime_t agingTreshold);
     FilteringDatabase();
@@ -76,6 +111,22 @@ public:
     virtual std::vector<int> getDestInterfaceIds(MacAddress macAddress, simtime_t curTS);
 
     void insert(MacAddress macAddress, simtime_t curTS, int interfaceId);
+
+    /**
+     * Handles the loss of a port. Without a backup port (backupInterfaceId
+     * is -1), learned entries of the port are flushed. Otherwise all entries
+     * of the port are moved to the backup port. Takes time linear in the
+     * number of entries of the port.
+     *
+     * @return Unicast addresses that were flushed or moved.
+     */
+    virtual std::vector<MacAddress> portDown(int interfaceId, int backupInterfaceId);
+
+    /** Moves static entries back to a port after a failover. */
+    virtual void portUp(int interfaceId);
+
+    /** Number of entries referring to a port. */
+    virtual size_t getNumEntries(int interfaceId) const;
 };
 
 } // namespace nesting
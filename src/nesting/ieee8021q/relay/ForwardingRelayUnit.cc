@@ -18,9 +18,10 @@
 #include "inet/common/IProtocolRegistrationListener.h"
 #include "inet/linklayer/ethernet/EtherFrame_m.h"
 #include "inet/common/ModuleAccess.h"
+#include "inet/common/Simsignals.h"
 #include "inet/linklayer/common/InterfaceTag_m.h"
 #include "inet/linklayer/vlan/VlanTag_m.h"
-#include "nesting/common/misbehavior_m.h"
+#include "inet/networklayer/common/InterfaceEntry.h"
 #include "nesting/common/FlowMetaTag_m.h"
 
 #include <sstream>
@@ -34,34 +35,169 @@ void ForwardingRelayUnit::initialize(int stage) {
         fdb = getModuleFromPar<FilteringDatabase>(par("filteringDatabaseModule"), this);
         ifTable = getModuleFromPar<IInterfaceTable>(par("interfaceTableModule"), this);
         numberOfPorts = par("numberOfPorts");
-        //subscribe("enqueuePkSignal", this);
 
+        misbehaviorReportInterval = par("misbehaviorReportInterval");
+        misbehaviorSignals[DISCARD] = registerSignal("streamDiscard");
+        misbehaviorSignals[LEAD] = registerSignal("streamLead");
+        misbehaviorSignals[LAG] = registerSignal("streamLag");
+        loadStreamWindows(par("streamWindows").xmlValue());
+
+        failoverDelay = par("failoverDelay");
+        if (failoverDelay < SimTime::ZERO) {
+            throw cRuntimeError("Parameter failoverDelay must not be negative.");
+        }
+        reconvergenceTimeSignal = registerSignal("reconvergenceTime");
+        getContainingNode(this)->subscribe(interfaceStateChangedSignal, this);
+
+        WATCH(numLinkDownEvents);
+        WATCH(numFailovers);
     } else if (stage == INITSTAGE_LINK_LAYER) {
         registerService(Protocol::ethernetMac, nullptr, gate("ifIn"));
         registerProtocol(Protocol::ethernetMac, gate("ifOut"), nullptr);
+        initializePortStates();
+    }
+}
+
+ForwardingRelayUnit::~ForwardingRelayUnit() {
+    for (auto& entry : portStates) {
+        cancelAndDelete(entry.second.failoverMsg);
+    }
+}
+
+void ForwardingRelayUnit::initializePortStates() {
+    for (int interfacePos = 0; interfacePos < ifTable->getNumInterfaces(); interfacePos++) {
+        InterfaceEntry* ie = ifTable->getInterface(interfacePos);
+        portStates[ie->getInterfaceId()].up = ie->isUp() && ie->hasCarrier();
+    }
+
+    // Pairs of port indices "port:backupPort", separated by spaces
+    cStringTokenizer tokenizer(par("backupPorts").stringValue());
+    while (tokenizer.hasMoreTokens()) {
+        std::string pair = tokenizer.nextToken();
+        size_t separator = pair.find(':');
+        if (separator == std::string::npos) {
+            throw cRuntimeError("Invalid backup port \"%s\", expected port:backupPort.",
+                    pair.c_str());
+        }
+        int port = std::stoi(pair.substr(0, separator));
+        int backupPort = std::stoi(pair.substr(separator + 1));
+        if (port < 0 || port >= ifTable->getNumInterfaces()
+                || backupPort < 0 || backupPort >= ifTable->getNumInterfaces()) {
+            throw cRuntimeError("Backup port \"%s\" refers to a port that doesn't exist.",
+                    pair.c_str());
+        }
+        if (port == backupPort) {
+            throw cRuntimeError("Port %d can't be its own backup port.", port);
+        }
+        int interfaceId = ifTable->getInterface(port)->getInterfaceId();
+        portStates[interfaceId].backupInterfaceId =
+                ifTable->getInterface(backupPort)->getInterfaceId();
+    }
+}
+
+bool ForwardingRelayUnit::isPortUp(int interfaceId) const {
+    auto it = portStates.find(interfaceId);
+    return it == portStates.end() || it->second.up;
+}
+
+void ForwardingRelayUnit::receiveSignal(cComponent *source, simsignal_t signalID,
+        cObject *obj, cObject *details) {
+    Enter_Method_Silent();
+
+    if (signalID != interfaceStateChangedSignal) {
+        return;
+    }
+    InterfaceEntry* ie = check_and_cast<InterfaceEntryChangeDetails*>(obj)->getInterfaceEntry();
+    auto it = portStates.find(ie->getInterfaceId());
+    if (it == portStates.end()) {
+        return;
+    }
+    bool up = ie->isUp() && ie->hasCarrier();
+    if (up == it->second.up) {
+        return;
+    }
+    it->second.up = up;
+    if (up) {
+        handlePortUp(ie->getInterfaceId());
+    } else {
+        handlePortDown(ie->getInterfaceId());
+    }
+}
+
+void ForwardingRelayUnit::handlePortDown(int interfaceId) {
+    EV_WARN << "Link of interface " << interfaceId << " went down" << std::endl;
+    numLinkDownEvents++;
+    PortState& port = portStates[interfaceId];
+    port.downSince = simTime();
+    if (failoverDelay == SimTime::ZERO) {
+        applyFailover(interfaceId);
+        return;
+    }
+    if (port.failoverMsg == nullptr) {
+        port.failoverMsg = new cMessage("failover", interfaceId);
+    }
+    scheduleAt(simTime() + failoverDelay, port.failoverMsg);
+}
+
+void ForwardingRelayUnit::handlePortUp(int interfaceId) {
+    EV_INFO << "Link of interface " << interfaceId << " came up" << std::endl;
+    PortState& port = portStates[interfaceId];
+    if (port.failoverMsg != nullptr && port.failoverMsg->isScheduled()) {
+        // Came up again before the failover, the database wasn't changed
+        cancelEvent(port.failoverMsg);
+        return;
+    }
+    fdb->portUp(interfaceId);
+}
+
+void ForwardingRelayUnit::applyFailover(int interfaceId) {
+    PortState& port = portStates[interfaceId];
+    int backupInterfaceId = port.backupInterfaceId;
+    if (backupInterfaceId != -1 && !isPortUp(backupInterfaceId)) {
+        EV_WARN << "Backup interface " << backupInterfaceId << " of interface "
+                << interfaceId << " is down as well" << std::endl;
+        backupInterfaceId = -1;
+    }
+    std::vector<MacAddress> addresses = fdb->portDown(interfaceId, backupInterfaceId);
+    if (backupInterfaceId != -1) {
+        numFailovers++;
+    }
+    EV_INFO << (backupInterfaceId != -1 ? "Moved " : "Flushed ") << addresses.size()
+            << " unicast entries of interface " << interfaceId << std::endl;
+    for (const MacAddress& address : addresses) {
+        // Keep the earliest link down time of a destination
+        reconvergingAddresses.emplace(address, port.downSince);
+    }
+}
+
+void ForwardingRelayUnit::checkReconvergence(const MacAddress& destAddr) {
+    if (reconvergingAddresses.empty()) {
+        return;
+    }
+    auto it = reconvergingAddresses.find(destAddr);
+    if (it != reconvergingAddresses.end()) {
+        emit(reconvergenceTimeSignal, simTime() - it->second);
+        reconvergingAddresses.erase(it);
     }
 }
 
 
 
 void ForwardingRelayUnit::handleMessage(cMessage *msg) {
-    if(msg->arrivedOn("DirectDropIn") || msg->arrivedOn("DirectDriftIn")){
-        //discard,lead,lag signal
-        MisbehaviorMsg *misMsg = check_and_cast<MisbehaviorMsg*>(msg);
-        uint16_t fid = misMsg->getFid();
-        uint16_t type = misMsg->getType();
-        EV_INFO << "get the misbehavior signal !!!!" << misMsg << ", " << fid << ", " << type << std::endl;
+    if (msg->isSelfMessage()) {
+        // Failover after failoverDelay, the kind holds the interface id
+        applyFailover(msg->getKind());
         return;
     }
+
     Packet* packet = check_and_cast<Packet*>(msg);
-    if (packet->findTag<FlowMetaTag>() != nullptr){
+    FlowMetaTag* oldFlowMetaTag = nullptr;
+    if (packet->findTag<FlowMetaTag>() != nullptr) {
         //this is a scheduled packet
-        auto flowMataTag = packet->getTag<FlowMetaTag>();
-        auto fid = flowMataTag->getFlowId();
-        auto seq = flowMataTag->getSeqNum();
-        EV_INFO << "received ST packet, flow id: " << fid << ", sequence: " << seq << std::endl;
-        //find the expected window id.
-        return;
+        oldFlowMetaTag = packet->removeTag<FlowMetaTag>();
+        EV_INFO << "received ST packet, flow id: " << oldFlowMetaTag->getFlowId()
+                << ", sequence: " << oldFlowMetaTag->getSeqNum() << std::endl;
+        checkStreamWindow(oldFlowMetaTag->getFlowId());
     }
 
     const auto& frame = packet->peekAtFront<EthernetMacHeader>();
@@ -76,6 +212,13 @@ void ForwardingRelayUnit::handleMessage(cMessage *msg) {
     auto vlanReq = packet->addTag<VlanReq>();
     vlanReq->setVlanId(vlanInd->getVlanId());
     delete oldPacketProtocolTag;
+    // Keep the arrival interface, e.g. for shaped queues per upstream port
+    packet->addTag<InterfaceInd>()->setInterfaceId(arrivalInterfaceId);
+    // Keep flow meta data, so that queues can report misbehavior per flow
+    if (oldFlowMetaTag != nullptr) {
+        *packet->addTag<FlowMetaTag>() = *oldFlowMetaTag;
+        delete oldFlowMetaTag;
+    }
 
     packet->trim();
 
@@ -94,7 +237,7 @@ void ForwardingRelayUnit::processBroadcast(Packet* packet, int arrivalInterfaceI
     for (int interfacePos = 0; interfacePos < ifTable->getNumInterfaces(); interfacePos++) {
         InterfaceEntry* destInterface = ifTable->getInterface(interfacePos);
         int destInterfaceId = destInterface->getInterfaceId();
-        if (destInterfaceId != arrivalInterfaceId) {
+        if (destInterfaceId != arrivalInterfaceId && isPortUp(destInterfaceId)) {
             Packet* dupPacket = packet->dup();
             dupPacket->addTagIfAbsent<InterfaceReq>()->setInterfaceId(destInterfaceId);
             send(dupPacket, gate("ifOut"));
@@ -142,8 +285,12 @@ void ForwardingRelayUnit::processUnicast(Packet* packet, int arrivalInterfaceId)
     if (destInterfaceId == -1) {
         EV_INFO << "No unicast forwarding entry for packet " << packet->getName()
                 << " found. Falling back to broadcast!" << std::endl;
+        checkReconvergence(frame->getDest());
         processBroadcast(packet, arrivalInterfaceId);
-    } else {;
+    } else {
+        if (isPortUp(destInterfaceId)) {
+            checkReconvergence(frame->getDest());
+        }
         EV_INFO << "Forwarding unicast packet " << packet->getName()
                 << " to interface " << destInterfaceId << std::endl;
         packet->addTagIfAbsent<InterfaceReq>()->setInterfaceId(destInterfaceId);
@@ -156,4 +303,88 @@ void ForwardingRelayUnit::learn(MacAddress srcAddr, int arrivalInterfaceId)
     fdb->insert(srcAddr, simTime(), arrivalInterfaceId);
 }
 
+void ForwardingRelayUnit::loadStreamWindows(cXMLElement* xml) {
+    for (cXMLElement* streamXml : xml->getChildrenByTagName("stream")) {
+        const char* flowId = streamXml->getAttribute("flowId");
+        const char* cycle = streamXml->getAttribute("cycle");
+        const char* offset = streamXml->getAttribute("offset");
+        const char* length = streamXml->getAttribute("length");
+        if (!flowId || !cycle || !offset || !length) {
+            throw cRuntimeError("Stream window at %s requires the attributes "
+                    "flowId, cycle, offset and length.",
+                    streamXml->getSourceLocation());
+        }
+        StreamWindow window { SimTime::parse(cycle), SimTime::parse(offset),
+                SimTime::parse(length) };
+        if (window.cycle <= SimTime::ZERO || window.offset < SimTime::ZERO
+                || window.length < SimTime::ZERO || window.length >= window.cycle) {
+            throw cRuntimeError("Invalid stream window at %s.",
+                    streamXml->getSourceLocation());
+        }
+        streamWindows[std::stoull(flowId)] = window;
+    }
+}
+
+void ForwardingRelayUnit::checkStreamWindow(uint64_t flowId) {
+    auto it = streamWindows.find(flowId);
+    if (it == streamWindows.end()) {
+        return;
+    }
+    const StreamWindow& window = it->second;
+
+    // Position relative to the window start within the cycle
+    int64_t cycle = window.cycle.raw();
+    int64_t sinceStart = (simTime() - window.offset).raw() % cycle;
+    if (sinceStart < 0) {
+        sinceStart += cycle;
+    }
+    if (sinceStart <= window.length.raw()) {
+        return;
+    }
+
+    // Frames outside of the window belong to the nearest window.
+    int64_t late = sinceStart - window.length.raw();
+    int64_t early = cycle - sinceStart;
+    onMisbehavior(early < late ? LEAD : LAG, flowId, this);
+}
+
+void ForwardingRelayUnit::onMisbehavior(MisbehaviorType type, uint64_t flowId, cModule* source) {
+    Enter_Method_Silent();
+
+    FlowMisbehavior& flow = flowMisbehaviors[flowId];
+    flow.counts[type]++;
+    if (flow.reported && simTime() - flow.lastReport < misbehaviorReportInterval) {
+        flow.suppressed++;
+        return;
+    }
+
+    EV_WARN << "Misbehavior " << type << " of flow " << flowId << " reported by "
+            << source->getFullPath() << " (" << flow.suppressed
+            << " earlier reports suppressed)" << std::endl;
+    emit(misbehaviorSignals[type], static_cast<unsigned long>(flowId));
+    flow.reported = true;
+    flow.lastReport = simTime();
+    flow.suppressed = 0;
+}
+
+void ForwardingRelayUnit::finish() {
+    static const char* typeNames[numMisbehaviorTypes] = { "discarded", "lead", "lag" };
+    char name[64];
+    for (auto& entry : flowMisbehaviors) {
+        for (int type = 0; type < numMisbehaviorTypes; type++) {
+            if (entry.first == UNKNOWN_FLOW_ID) {
+                sprintf(name, "unknown flow %s", typeNames[type]);
+            } else {
+                sprintf(name, "flow %lu %s", static_cast<unsigned long>(entry.first),
+                        typeNames[type]);
+            }
+            recordScalar(name, entry.second.counts[type]);
+        }
+    }
+
+    recordScalar("link down events", numLinkDownEvents);
+    recordScalar("failovers", numFailovers);
+    recordScalar("destinations not reconverged", reconvergingAddresses.size());
+}
+
 } // namespace nesting
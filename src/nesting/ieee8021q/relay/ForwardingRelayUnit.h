@@ -17,6 +17,7 @@
 #define __MAIN_FORWARDINGRELAYUNIT_H_
 
 #include <unordered_map>
+#include <map>
 #include <omnetpp.h>
 
 #include "inet/common/packet/Packet.h"
@@ -24,6 +25,7 @@
 #include "inet/networklayer/contract/IInterfaceTable.h"
 
 #include "FilteringDatabase.h"
+#include "nesting/common/IMisbehaviorListener.h"
 
 using namespace omnetpp;
 using namespace inet;
@@ -33,13 +35,71 @@ namespace nesting {
 /**
  * See the NED file for a detailed description
  */
-class ForwardingRelayUnit: public cSimpleModule {
+class ForwardingRelayUnit: public cSimpleModule, public IMisbehaviorListener,
+        public cListener {
 private:
+    /** Number of MisbehaviorType values. */
+    static const int numMisbehaviorTypes = LAG + 1;
+
+    /** Misbehavior counters and report state of a flow. */
+    struct FlowMisbehavior {
+        uint64_t counts[numMisbehaviorTypes] = {};
+        /** Misbehaviors not reported since the last report. */
+        uint64_t suppressed = 0;
+        bool reported = false;
+        simtime_t lastReport;
+    };
+
+    /** Expected reception window of a stream within its cycle. */
+    struct StreamWindow {
+        simtime_t cycle;
+        simtime_t offset;
+        simtime_t length;
+    };
+
+    /** Link state of a port. */
+    struct PortState {
+        bool up = true;
+        /** Interface id of the backup port, -1 if there is none. */
+        int backupInterfaceId = -1;
+        simtime_t downSince;
+        /** Pending failover while failoverDelay elapses, owned. */
+        cMessage* failoverMsg = nullptr;
+    };
+
     FilteringDatabase* fdb;
     int numberOfPorts;
     simtime_t fdbAgingThreshold = 1000; //TODO: Create parameter for filtering database aging
     IInterfaceTable *ifTable;
 
+    /** Misbehavior per flow id, ordered for deterministic scalar output. */
+    std::map<uint64_t, FlowMisbehavior> flowMisbehaviors;
+
+    /** Reception windows by flow id. Streams without window aren't checked. */
+    std::unordered_map<uint64_t, StreamWindow> streamWindows;
+
+    /** Minimum time between two reports of the same flow. */
+    simtime_t misbehaviorReportInterval;
+
+    simsignal_t misbehaviorSignals[numMisbehaviorTypes];
+
+    /** Port states by interface id. */
+    std::unordered_map<int, PortState> portStates;
+
+    /** Time from a link down event until the database is updated. */
+    simtime_t failoverDelay;
+
+    /**
+     * Unicast destinations flushed or moved by a failover, by the time their
+     * port went down. They are reconverged once a frame to them is forwarded
+     * to a port that is up.
+     */
+    std::unordered_map<MacAddress, simtime_t> reconvergingAddresses;
+
+    simsignal_t reconvergenceTimeSignal;
+    long numLinkDownEvents = 0;
+    long numFailovers = 0;
+
 protected:
     virtual void initialize(int stage) override;
     virtual int numInitStages() const override { return NUM_INIT_STAGES; }
@@ -48,8 +108,40 @@ protected:
     virtual void processMulticast(Packet* packet, int arrivalInterfaceId);
     virtual void processUnicast(Packet* packet, int arrivalInterfaceId);
     virtual void learn(MacAddress srcAddr, int arrivalInterfaceId);
-    //virtual void receiveSignal(cComponent *source, simsignal_t signalID, long x, cObject *details);
+    virtual void finish() override;
+
+    /** Reads the port states and the backupPorts parameter. */
+    virtual void initializePortStates();
+    virtual bool isPortUp(int interfaceId) const;
+    virtual void handlePortDown(int interfaceId);
+    virtual void handlePortUp(int interfaceId);
+    virtual void applyFailover(int interfaceId);
+    /** Records the reconvergence time of a destination, if it was affected by a failover. */
+    virtual void checkReconvergence(const MacAddress& destAddr);
+
+    /** Reads the stream windows from the streamWindows parameter. */
+    virtual void loadStreamWindows(cXMLElement* xml);
+
+    /**
+     * Reports LEAD or LAG if a frame of the given flow is received outside
+     * of its stream window.
+     */
+    virtual void checkStreamWindow(uint64_t flowId);
 public:
+    /**
+     * Counts the misbehavior per flow and reports it at most once per
+     * misbehaviorReportInterval for every flow.
+     *
+     * @see IMisbehaviorListener::onMisbehavior()
+     */
+    virtual void onMisbehavior(MisbehaviorType type, uint64_t flowId, cModule* source) override;
+
+    /** Receives link state changes of the switch's interfaces. */
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID,
+            cObject *obj, cObject *details) override;
+
+    virtual ~ForwardingRelayUnit();
+
     //TODO: Fix filtering database aging parameter!
 //  ForwardingRelayUnit() : fdb(1000) {};
 };
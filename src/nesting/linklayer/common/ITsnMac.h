@@ -0,0 +1,66 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_LINKLAYER_COMMON_ITSNMAC_H_
+#define NESTING_LINKLAYER_COMMON_ITSNMAC_H_
+
+#include <omnetpp.h>
+
+#include "nesting/common/time/LinkTiming.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Interface of the Mac modules as seen by gate controllers and transmission
+ * selection algorithms. It is resolved once during initialization, so these
+ * modules don't depend on the concrete Mac class.
+ *
+ * Mac modules without frame preemption keep the default implementations of
+ * the hold and release methods.
+ */
+class ITsnMac
+{
+public:
+    virtual ~ITsnMac() {}
+
+    /**
+     * Returns the timing constants of the link. They are zero while the Mac
+     * isn't connected.
+     */
+    virtual const LinkTiming& getLinkTiming() const = 0;
+
+    /** Returns true if preemptable frames may be preempted on this port. */
+    virtual bool isFramePreemptionEnabled() { return false; }
+
+    /** Requests a hold of preemptable frames after the given delay. */
+    virtual void hold(simtime_t delay) {}
+
+    /** Releases a hold of preemptable frames. */
+    virtual void release() {}
+
+    virtual bool isOnHold() { return false; }
+
+    /** Worst-case time from a hold request until express frames can be sent. */
+    virtual simtime_t getHoldAdvance() { return SIMTIME_ZERO; }
+
+    /** Time express frames may wait for a preemptable frame without preemption. */
+    virtual simtime_t getGuardBandWithoutPreemption() { return SIMTIME_ZERO; }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_LINKLAYER_COMMON_ITSNMAC_H_ */
@@ -0,0 +1,155 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/linklayer/common/LinkErrorModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "inet/common/ModuleAccess.h"
+
+namespace nesting {
+
+Define_Module(LinkErrorModel);
+
+void LinkErrorModel::initialize() {
+    // Without a seed, the key is drawn from the module's RNG, so repetitions
+    // differ like with any other random parameter
+    int64_t seed = par("seed").intValue();
+    if (seed < 0) {
+        seed = (static_cast<int64_t>(getRNG(0)->intRand()) << 32) ^ getRNG(0)->intRand();
+    }
+    rng.setSeed(seed);
+
+    bitErrorRate = par("bitErrorRate");
+    if (bitErrorRate < 0 || bitErrorRate >= 1) {
+        throw cRuntimeError("bitErrorRate must be in the range [0,1)");
+    }
+    logBitSuccessRate = std::log1p(-bitErrorRate);
+
+    burstEnterProbability = par("burstEnterProbability");
+    burstExitProbability = par("burstExitProbability");
+    goodLossProbability = par("goodLossProbability");
+    badLossProbability = par("badLossProbability");
+    for (double probability : { burstEnterProbability, burstExitProbability,
+            goodLossProbability, badLossProbability }) {
+        if (probability < 0 || probability > 1) {
+            throw cRuntimeError("Probabilities of the burst loss model must be in the range [0,1]");
+        }
+    }
+
+    parseOutages(par("outages"));
+
+    const char* listenerPath = par("misbehaviorListenerModule");
+    if (*listenerPath != '\0') {
+        misbehaviorListener = getModuleFromPar<IMisbehaviorListener>(
+                par("misbehaviorListenerModule"), this);
+    }
+
+    WATCH(inBurst);
+    WATCH(nextOutage);
+    WATCH(numFrames);
+    WATCH(numBitErrorFrames);
+    WATCH(numBurstLossFrames);
+    WATCH(numOutageFrames);
+}
+
+void LinkErrorModel::parseOutages(const char* outageString) {
+    cStringTokenizer tokenizer(outageString, " ,");
+    while (tokenizer.hasMoreTokens()) {
+        std::string token = tokenizer.nextToken();
+        size_t separator = token.find("..");
+        if (separator == std::string::npos) {
+            throw cRuntimeError("Outage \"%s\" is not of the form start..end", token.c_str());
+        }
+        Outage outage;
+        outage.start = SimTime::parse(token.substr(0, separator).c_str());
+        outage.end = SimTime::parse(token.substr(separator + 2).c_str());
+        if (outage.end <= outage.start) {
+            throw cRuntimeError("Outage \"%s\" ends before it starts", token.c_str());
+        }
+        if (!outages.empty() && outage.start < outages.back().end) {
+            throw cRuntimeError("Outages must be sorted and must not overlap, see \"%s\"", token.c_str());
+        }
+        outages.push_back(outage);
+    }
+}
+
+void LinkErrorModel::handleMessage(cMessage *msg) {
+    throw cRuntimeError("LinkErrorModel doesn't handle messages");
+}
+
+LinkErrorModel::FrameFate LinkErrorModel::applyTo(cPacket* frame, inet::b length, simtime_t duration) {
+    Enter_Method_Silent();
+    numFrames++;
+
+    FrameFate fate = FrameFate::INTACT;
+    simtime_t now = simTime();
+    if (isInOutage(now - duration, now)) {
+        numOutageFrames++;
+        fate = FrameFate::LOST;
+    } else if (isBurstLoss()) {
+        numBurstLossFrames++;
+        fate = FrameFate::CORRUPTED;
+    } else if (hasBitError(length)) {
+        numBitErrorFrames++;
+        fate = FrameFate::CORRUPTED;
+    }
+
+    if (fate != FrameFate::INTACT && misbehaviorListener != nullptr) {
+        misbehaviorListener->onMisbehavior(DISCARD, IMisbehaviorListener::getFlowId(frame), this);
+    }
+    return fate;
+}
+
+bool LinkErrorModel::isInOutage(simtime_t receptionStart, simtime_t receptionEnd) {
+    // Frames arrive in order, so outages that ended before are skipped for good
+    while (nextOutage < outages.size() && outages[nextOutage].end <= receptionStart) {
+        nextOutage++;
+    }
+    return nextOutage < outages.size() && outages[nextOutage].start < receptionEnd;
+}
+
+bool LinkErrorModel::hasBitError(inet::b length) {
+    if (bitErrorRate == 0) {
+        return false;
+    }
+    // Probability of at least one bit error in the frame
+    double errorProbability = -std::expm1(length.get() * logBitSuccessRate);
+    return rng.nextUniform() < errorProbability;
+}
+
+bool LinkErrorModel::isBurstLoss() {
+    if (burstEnterProbability == 0 && !inBurst && goodLossProbability == 0) {
+        return false;
+    }
+    if (inBurst) {
+        inBurst = rng.nextUniform() >= burstExitProbability;
+    } else {
+        inBurst = rng.nextUniform() < burstEnterProbability;
+    }
+    double lossProbability = inBurst ? badLossProbability : goodLossProbability;
+    return lossProbability > 0 && rng.nextUniform() < lossProbability;
+}
+
+void LinkErrorModel::finish() {
+    recordScalar("frames", numFrames);
+    recordScalar("frames with bit errors", numBitErrorFrames);
+    recordScalar("frames lost in bursts", numBurstLossFrames);
+    recordScalar("frames lost in outages", numOutageFrames);
+}
+
+} // namespace nesting
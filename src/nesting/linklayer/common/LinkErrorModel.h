@@ -0,0 +1,95 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_LINKLAYER_COMMON_LINKERRORMODEL_H_
+#define NESTING_LINKLAYER_COMMON_LINKERRORMODEL_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "inet/common/Units.h"
+
+#include "nesting/common/CounterBasedRng.h"
+#include "nesting/common/IMisbehaviorListener.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class LinkErrorModel: public cSimpleModule {
+public:
+    enum class FrameFate {
+        INTACT,
+        /** Received with bit errors, the MAC discards it by its CRC. */
+        CORRUPTED,
+        /** Not received at all, the link is down. */
+        LOST
+    };
+protected:
+    struct Outage {
+        simtime_t start;
+        simtime_t end;
+    };
+
+    CounterBasedRng rng;
+
+    double bitErrorRate;
+    /** log(1 - bitErrorRate), so a frame needs a single exp() call. */
+    double logBitSuccessRate;
+
+    // Gilbert-Elliott model, evaluated once per frame
+    double burstEnterProbability;
+    double burstExitProbability;
+    double goodLossProbability;
+    double badLossProbability;
+    bool inBurst = false;
+
+    /** Outage windows, sorted and disjoint. */
+    std::vector<Outage> outages;
+    /** First outage that may still overlap a frame. */
+    size_t nextOutage = 0;
+
+    IMisbehaviorListener* misbehaviorListener = nullptr;
+
+    long numFrames = 0;
+    long numBitErrorFrames = 0;
+    long numBurstLossFrames = 0;
+    long numOutageFrames = 0;
+protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+    virtual void parseOutages(const char* outageString);
+    virtual bool isInOutage(simtime_t receptionStart, simtime_t receptionEnd);
+    virtual bool hasBitError(inet::b length);
+    virtual bool isBurstLoss();
+public:
+    /**
+     * Decides the fate of a frame whose reception ends now. Drops are
+     * reported as DISCARD to the misbehavior listener, if there is one.
+     *
+     * @param frame    Frame or fragment, used for the flow id only.
+     * @param length   Bits on the wire.
+     * @param duration Transmission duration of the frame.
+     */
+    virtual FrameFate applyTo(cPacket* frame, inet::b length, simtime_t duration);
+};
+
+} // namespace nesting
+
+#endif /* NESTING_LINKLAYER_COMMON_LINKERRORMODEL_H_ */
@@ -0,0 +1,85 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/linklayer/common/TransmittedTags.h"
+
+#include <memory>
+
+#include "inet/common/ProtocolTag_m.h"
+#include "inet/common/TimeTag_m.h"
+#include "inet/linklayer/common/InterfaceTag_m.h"
+#include "inet/linklayer/common/MacAddressTag_m.h"
+#include "inet/linklayer/vlan/VlanTag_m.h"
+#include "inet/networklayer/common/FragmentationTag_m.h"
+
+#include "nesting/common/FlowMetaTag_m.h"
+#include "nesting/common/LatencyTag_m.h"
+#include "nesting/ieee8021q/queue/framePreemption/ExpressFrameTag_m.h"
+#include "nesting/linklayer/launchTime/LaunchTimeTag_m.h"
+#include "nesting/linklayer/vlan/EnhancedVlanTag_m.h"
+
+namespace nesting {
+
+template<typename T>
+static void stripTag(inet::Packet* frame) {
+    delete frame->removeTagIfPresent<T>();
+}
+
+void TransmittedTags::filter(inet::Packet* frame) {
+    int numKeptTags = (frame->findTag<inet::PacketProtocolTag>() != nullptr)
+            + (frame->findTag<FlowMetaTag>() != nullptr)
+            + (frame->findTag<LatencyTag>() != nullptr);
+    if (frame->getNumTags() == numKeptTags) {
+        return;
+    }
+
+    // The tags a frame picks up in the nodes are removed in place, so the
+    // kept tags aren't allocated again
+    stripTag<inet::DispatchProtocolReq>(frame);
+    stripTag<inet::InterfaceInd>(frame);
+    stripTag<inet::InterfaceReq>(frame);
+    stripTag<inet::MacAddressInd>(frame);
+    stripTag<inet::MacAddressReq>(frame);
+    stripTag<inet::VlanInd>(frame);
+    stripTag<inet::VlanReq>(frame);
+    stripTag<inet::FragmentationReq>(frame);
+    stripTag<inet::CreationTimeTag>(frame);
+    stripTag<EnhancedVlanInd>(frame);
+    stripTag<EnhancedVlanReq>(frame);
+    stripTag<ExpressFrameReq>(frame);
+    stripTag<LaunchTimeReq>(frame);
+    if (frame->getNumTags() == numKeptTags) {
+        return;
+    }
+
+    // Tags of other types can't be removed without knowing their type. Tags
+    // can't be moved into a tag set, so the kept ones are copied.
+    std::unique_ptr<inet::PacketProtocolTag> packetProtocolTag(
+            frame->removeTagIfPresent<inet::PacketProtocolTag>());
+    std::unique_ptr<FlowMetaTag> flowMetaTag(frame->removeTagIfPresent<FlowMetaTag>());
+    std::unique_ptr<LatencyTag> latencyTag(frame->removeTagIfPresent<LatencyTag>());
+    frame->clearTags();
+    if (packetProtocolTag != nullptr) {
+        *frame->addTag<inet::PacketProtocolTag>() = *packetProtocolTag;
+    }
+    if (flowMetaTag != nullptr) {
+        *frame->addTag<FlowMetaTag>() = *flowMetaTag;
+    }
+    if (latencyTag != nullptr) {
+        *frame->addTag<LatencyTag>() = *latencyTag;
+    }
+}
+
+} // namespace nesting
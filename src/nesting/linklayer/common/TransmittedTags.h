@@ -0,0 +1,41 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_LINKLAYER_COMMON_TRANSMITTEDTAGS_H_
+#define NESTING_LINKLAYER_COMMON_TRANSMITTEDTAGS_H_
+
+#include "inet/common/packet/Packet.h"
+
+namespace nesting {
+
+/**
+ * Whitelist of the packet tags that are kept when a frame is sent to the
+ * wire. All other tags only describe the frame inside the sending node.
+ */
+class TransmittedTags {
+public:
+    /**
+     * Removes all tags of a frame except the PacketProtocolTag, and the
+     * FlowMetaTag and LatencyTag, which are needed for statistics at the
+     * receiver. Frames that only carry these tags are left untouched. The
+     * tags known to be added in the nodes are removed in place, only frames
+     * with further tags get their kept tags copied.
+     */
+    static void filter(inet::Packet* frame);
+};
+
+} // namespace nesting
+
+#endif /* NESTING_LINKLAYER_COMMON_TRANSMITTEDTAGS_H_ */
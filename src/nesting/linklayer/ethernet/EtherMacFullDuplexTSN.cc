@@ -16,9 +16,9 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //
 
+#include "inet/common/ModuleAccess.h"
 #include "inet/common/Simsignals.h"
 #include "inet/common/ProtocolTag_m.h"
-#include "inet/common/queue/IPassiveQueue.h"
 #include "inet/linklayer/common/InterfaceTag_m.h"
 #include "inet/linklayer/ethernet/EtherEncap.h"
 #include "inet/linklayer/ethernet/EtherFrame_m.h"
@@ -27,18 +27,59 @@
 
 #include "nesting/linklayer/ethernet/EtherMacFullDuplexTSN.h"
 #include "nesting/common/FlowMetaTag_m.h"
+#include "nesting/common/LatencyTag_m.h"
+#include "nesting/ieee8021q/Ieee8021q.h"
+#include "nesting/ieee8021q/queue/TransmissionSelection.h"
+#include "nesting/ieee8021q/queue/framePreemption/ExpressFrameTag_m.h"
+#include "nesting/linklayer/common/TransmittedTags.h"
+#include "nesting/linklayer/launchTime/LaunchTimeTag_m.h"
 
-namespace nesting {
+#include <algorithm>
+#include <memory>
 
-// TODO: refactor using a statemachine that is present in a single function
-// TODO: this helps understanding what interactions are there and how they affect the state
+namespace nesting {
 
 Define_Module(EtherMacFullDuplexTSN);
 
+simsignal_t EtherMacFullDuplexTSN::preemptCurrentFrameSignal = registerSignal("preemptCurrentFrameSignal");
+simsignal_t EtherMacFullDuplexTSN::transmittedExpressFrameSignal = registerSignal("transmittedExpressFrameSignal");
+simsignal_t EtherMacFullDuplexTSN::startTransmissionExpressFrameSignal = registerSignal("startTransmissionExpressFrameSignal");
+simsignal_t EtherMacFullDuplexTSN::transmittedPreemptableFrameSignal = registerSignal("transmittedPreemptableFrameSignal");
+simsignal_t EtherMacFullDuplexTSN::transmittedPreemptableFramePartSignal = registerSignal("transmittedPreemptableFramePartSignal");
+simsignal_t EtherMacFullDuplexTSN::transmittedPreemptableNonFinalSignal = registerSignal("transmittedPreemptableNonFinalSignal");
+simsignal_t EtherMacFullDuplexTSN::transmittedPreemptableFinalSignal = registerSignal("transmittedPreemptableFinalSignal");
+simsignal_t EtherMacFullDuplexTSN::transmittedPreemptableFullSignal = registerSignal("transmittedPreemptableFullSignal");
+simsignal_t EtherMacFullDuplexTSN::expressFrameEnqueuedWhileSendingPreemptableSignal = registerSignal("expressFrameEnqueuedWhileSendingPreemptableSignal");
+simsignal_t EtherMacFullDuplexTSN::eMacDelay = registerSignal("eMacDelay");
+simsignal_t EtherMacFullDuplexTSN::pMacDelay = registerSignal("pMacDelay");
+simsignal_t EtherMacFullDuplexTSN::receivedExpressFrame = registerSignal("receivedExpressFrame");
+simsignal_t EtherMacFullDuplexTSN::receivedPreemptableFrameFull = registerSignal("receivedPreemptableFrameFull");
+simsignal_t EtherMacFullDuplexTSN::receivedExpressFrameFromUpper = registerSignal("receivedExpressFrameFromUpper");
+
 EtherMacFullDuplexTSN::EtherMacFullDuplexTSN()
 {
 }
 
+EtherMacFullDuplexTSN::~EtherMacFullDuplexTSN()
+{
+    cancelEvent(&launchTimeMsg);
+    cancelEvent(&holdRequestMsg);
+    cancelEvent(&preemptCurrentFrameMsg);
+    cancelEvent(&recheckExpressFrameMsg);
+    cancelEvent(&verifyTimerMsg);
+    cancelEvent(&respondMsg);
+    cancelEvent(&pfcPauseEndMsg);
+    cancelEvent(&pfcRefreshMsg);
+    for (Packet *frame : controlFrames)
+        delete frame;
+    for (Packet *frame : pendingFrames)
+        delete frame;
+    if (curTxFrame == currentPreemptableFrame)
+        curTxFrame = nullptr;
+    delete currentPreemptableFrame;
+    delete reassembly;
+}
+
 void EtherMacFullDuplexTSN::initialize(int stage)
 {
     EtherMacBase::initialize(stage);
@@ -46,9 +87,104 @@ void EtherMacFullDuplexTSN::initialize(int stage)
     if (stage == INITSTAGE_LOCAL) {
         if (!par("duplexMode"))
             throw cRuntimeError("Half duplex operation is not supported by EtherMacFullDuplexTSN, use the EtherMac module for that! (Please enable csmacdSupport on EthernetInterface)");
+        if (*par("errorModelModule").stringValue() != '\0')
+            errorModel = getModuleFromPar<LinkErrorModel>(par("errorModelModule"), this);
+
+        // the queue module of an EthernetInterface is a Queuing module, the
+        // base class already resolved it to the module connected to the Mac
+        transmissionSelection = dynamic_cast<TransmissionSelection *>(txQueue.extQueue);
+
+        preemptionCapable = par("preemptionCapable");
+        preemptionEnabled = par("enablePreemptingFrames");
+        if (preemptionEnabled && !preemptionCapable)
+            throw cRuntimeError("Parameter enablePreemptingFrames requires preemptionCapable");
+        if (preemptionEnabled && transmissionSelection == nullptr)
+            throw cRuntimeError("Frame preemption requires a TransmissionSelection module as external queue");
+        if (preemptionCapable && transmissionSelection != nullptr)
+            transmissionSelection->addListener(this);
+
+        localAddFragSize = par("addFragSize");
+        if (localAddFragSize < 0 || localAddFragSize > kFramePreemptionMaxAddFragSize)
+            throw cRuntimeError("addFragSize must be between 0 and %d, but is %d", kFramePreemptionMaxAddFragSize, localAddFragSize);
+        updateMinNonFinalFragmentBytes();
+
+        // Until the link partner responds, preemptable frames are sent as a
+        // whole like express frames
+        if (preemptionEnabled && par("verifyPreemption").boolValue()) {
+            verifyStatus = VerifyStatus::VERIFYING;
+            verifyAttemptsLeft = par("verifyAttempts");
+            verifyTime = par("verifyTime");
+            scheduleAt(simTime(), &verifyTimerMsg);
+        }
+
+        cutThroughEnabled = par("cutThrough");
+        if (cutThroughEnabled) {
+            // Frames are passed up when the Mac of the link partner starts to send them
+            cGate *startGate = physInGate->getPathStartGate();
+            cGate *endGate = physInGate->getPathEndGate();
+            cutThroughPartner = (startGate == physInGate ? endGate : startGate)->getOwnerModule();
+            if (cutThroughPartner != this)
+                cutThroughPartner->subscribe(packetSentToLowerSignal, this);
+        }
+
+        launchTimeEnabled = par("launchTimeEnabled");
+
+        std::string mode = par("statisticsMode").stdstringValue();
+        if (mode == "perPacket")
+            statisticsMode = StatisticsMode::PER_PACKET;
+        else if (mode == "sampled")
+            statisticsMode = StatisticsMode::SAMPLED;
+        else if (mode == "aggregate")
+            statisticsMode = StatisticsMode::AGGREGATE;
+        else
+            throw cRuntimeError("Unknown statistics mode \"%s\".", mode.c_str());
+        statisticsSampleInterval = par("statisticsSampleInterval");
+        if (statisticsSampleInterval < 1)
+            throw cRuntimeError("Parameter statisticsSampleInterval must be at least 1.");
+        // only the pMAC collects latencies of received frames
+        recordLatencyHistograms = preemptionCapable && par("recordLatencyHistograms").boolValue();
+        int maxStreams = par("maxLatencyStreams");
+        if (maxStreams < 0)
+            throw cRuntimeError("Parameter maxLatencyStreams must not be negative.");
+        maxLatencyStreams = maxStreams;
+
+        pfcEnabled = par("pfcEnabled");
+        if (pfcEnabled) {
+            if (transmissionSelection == nullptr)
+                throw cRuntimeError("Priority-based flow control requires a TransmissionSelection module as external queue");
+            pfcPauseUnits = par("pfcPauseQuanta");
+            if (pfcPauseUnits <= 0 || pfcPauseUnits > 65535)
+                throw cRuntimeError("Parameter pfcPauseQuanta must be in the range [1,65535]");
+            if (*par("bufferManagerModule").stringValue() != '\0') {
+                cModule *bufferManager = getModuleFromPar<cModule>(par("bufferManagerModule"), this);
+                pfcPauseSignal = registerSignal("pfcPause");
+                pfcResumeSignal = registerSignal("pfcResume");
+                bufferManager->subscribe(pfcPauseSignal, this);
+                bufferManager->subscribe(pfcResumeSignal, this);
+            }
+            WATCH(numPfcFramesSent);
+            WATCH(numPfcFramesRcvd);
+        }
+
+        WATCH(onHold);
+        WATCH(transmittingPreemptableFrame);
+        WATCH(numMPacketsDropped);
+        WATCH(numExpressFramesSent);
+        if (preemptionCapable) {
+            WATCH(localAddFragSize);
+            WATCH(remoteAddFragSize);
+            WATCH(minNonFinalFragmentBytes);
+            WATCH(numFragmentsSent);
+            WATCH(numFragmentsReceived);
+            WATCH(numFramesReassembled);
+            WATCH(numReassemblyErrors);
+            WATCH(numSmdErrors);
+            WATCH(numPreemptableFramesSent);
+            WATCH(numPreemptions);
+        }
     }
     else if (stage == INITSTAGE_LINK_LAYER) {
-        beginSendFrames();    //FIXME choose an another stage for it
+        startNextFrame();    //FIXME choose an another stage for it
     }
 }
 
@@ -77,75 +213,596 @@ void EtherMacFullDuplexTSN::handleMessageWhenUp(cMessage *msg)
         handleSelfMessage(msg);
     else if (msg->getArrivalGateId() == upperLayerInGateId)
         handleUpperPacket(check_and_cast<Packet *>(msg));
-    else if (msg->getArrivalGate() == physInGate)
-        processMsgFromNetwork(check_and_cast<EthernetSignal *>(msg));
+    else if (msg->getArrivalGate() == physInGate) {
+        if (!applyErrorModel(msg))
+            ;    // lost on the link
+        else if (MPacket *mPacket = dynamic_cast<MPacket *>(msg))
+            processMPacket(mPacket);
+        else {
+            // a frame sent as a whole, i.e. an express frame
+            EthernetSignal *signal = check_and_cast<EthernetSignal *>(msg);
+            if (Packet *frame = dynamic_cast<Packet *>(signal->getEncapsulatedPacket())) {
+                // the tree id doesn't change when the packet is copied
+                if (isSampled(numFramesReceivedOK))
+                    emit(receivedExpressFrame, frame->getTreeId());
+                collectLatencies(frame, true);
+            }
+            processMsgFromNetwork(signal);
+        }
+    }
     else
         throw cRuntimeError("Message received from unknown gate!");
     processAtHandleMessageFinished();
 }
 
+void EtherMacFullDuplexTSN::readChannelParameters(bool errorWhenAsymmetric)
+{
+    try {
+        EtherMacBase::readChannelParameters(errorWhenAsymmetric);
+    }
+    catch (cRuntimeError& e) {
+        // EtherMacBase only knows the classic rates. Additional ones get a
+        // descriptor from LinkTiming, other errors are passed on.
+        cChannel *inTrChannel = physInGate->findIncomingTransmissionChannel();
+        double txRate = transmissionChannel ? transmissionChannel->getNominalDatarate() : 0;
+        const EtherDescr *etherDescr = LinkTiming::findAdditionalEtherDescr(etherDescrs, txRate);
+        if (etherDescr == nullptr || inTrChannel == nullptr
+                || (errorWhenAsymmetric && inTrChannel->getNominalDatarate() != txRate))
+            throw;
+        curEtherDescr = etherDescr;
+        // A disabled channel is a link that is down
+        connected = !transmissionChannel->isDisabled() && !inTrChannel->isDisabled();
+        if (interfaceEntry) {
+            interfaceEntry->setCarrier(connected);
+            interfaceEntry->setDatarate(txRate);
+        }
+    }
+    linkTiming.update(connected ? curEtherDescr->txrate : 0);
+}
+
+void EtherMacFullDuplexTSN::refreshDisplay() const
+{
+    EtherMacBase::refreshDisplay();
+
+    if (preemptionCapable) {
+        char buf[200];
+        sprintf(buf, "onHold: %s\ntransmittingPreemptableFrame: %s\ncurrentPreemptableFrame: %s\npendingFrames: %d",
+                onHold ? "true" : "false",
+                transmittingPreemptableFrame ? "true" : "false",
+                currentPreemptableFrame ? currentPreemptableFrame->getName() : "nullptr",
+                (int)pendingFrames.size());
+        getDisplayString().setTagArg("t", 0, buf);
+    }
+}
+
 void EtherMacFullDuplexTSN::handleSelfMessage(cMessage *msg)
 {
     EV_TRACE << "Self-message " << msg << " received\n";
 
     if (msg == endTxMsg)
-        handleEndTxPeriod();
+        processTxEvent(TxEvent::END_TX);
     else if (msg == endIFGMsg)
-        handleEndIFGPeriod();
+        processTxEvent(TxEvent::END_IFG);
     else if (msg == endPauseMsg)
-        handleEndPausePeriod();
+        processTxEvent(TxEvent::END_PAUSE);
+    else if (msg == &recheckExpressFrameMsg)
+        processTxEvent(TxEvent::EXPRESS_FRAME_ENQUEUED);
+    else if (msg == &preemptCurrentFrameMsg)
+        processTxEvent(TxEvent::PREEMPT);
+    else if (msg == &holdRequestMsg)
+        processTxEvent(TxEvent::HOLD);
+    else if (msg == &launchTimeMsg)
+        processTxEvent(TxEvent::LAUNCH_TIME);
+    else if (msg == &verifyTimerMsg)
+        handleVerifyTimer();
+    else if (msg == &respondMsg)
+        handleRespond();
+    else if (msg == &pfcPauseEndMsg)
+        updatePausedPriorities();
+    else if (msg == &pfcRefreshMsg)
+        handlePfcRefresh();
     else
         throw cRuntimeError("Unknown self message received!");
 }
 
+void EtherMacFullDuplexTSN::processTxEvent(TxEvent event, Packet *frame, int pauseUnits)
+{
+    switch (event) {
+        case TxEvent::FRAME_ARRIVED:
+            if (!txQueue.extQueue) {
+                if (txQueue.innerQueue->isFull())
+                    throw cRuntimeError("txQueue length exceeds %d -- this is probably due to "
+                                        "a bogus app model generating excessive traffic "
+                                        "(or if this is normal, increase txQueueLimit!)",
+                            txQueue.innerQueue->getQueueLimit());
+                // store frame and possibly begin transmitting
+                EV_DETAIL << "Frame " << frame << " arrived from higher layers, enqueueing\n";
+                txQueue.innerQueue->insertFrame(frame);
+            }
+            else {
+                // requested from the queue, possibly before the transmitter
+                // became busy with a Mac control frame or a fragment
+                pendingFrames.push_back(frame);
+                if (isExpressFrame(frame)) {
+                    cancelEvent(&recheckExpressFrameMsg);
+                    // If a hold preempted the fragment already, the express frame follows it
+                    if (transmittingPreemptableFrame && !fragmentPreempted)
+                        schedulePreemption();
+                }
+            }
+            if (transmitState == TX_IDLE_STATE)
+                startNextFrame();
+            break;
+
+        case TxEvent::CONTROL_FRAME_QUEUED:
+            if (transmitState == TX_IDLE_STATE)
+                startNextFrame();
+            else if (transmittingPreemptableFrame && !fragmentPreempted)
+                schedulePreemption();    // Mac control frames are express frames
+            break;
+
+        case TxEvent::VERIFICATION_MPACKET_QUEUED:
+            // sent between frames and fragments, after the IFG
+            if (transmitState == TX_IDLE_STATE)
+                startNextFrame();
+            break;
+
+        case TxEvent::END_TX: {
+            // we only get here if transmission has finished successfully
+            if (transmitState != TRANSMITTING_STATE)
+                throw cRuntimeError("Model error: End of transmission, and incorrect state detected");
+
+            // Fragments are counted separately, frames when their last byte is sent
+            bool frameCompleted = true;
+            if (transmittingVerificationMPacket) {
+                // verify and respond mPackets aren't counted as frames
+                transmittingVerificationMPacket = false;
+                frameCompleted = false;
+            }
+            else if (transmittingPreemptableFrame)
+                frameCompleted = sendFragment();
+            else {
+                EV_DETAIL << "Express frame " << txFrameTreeId << " finished to transmit." << endl;
+                if (isSampled(numExpressFramesSent))
+                    emit(transmittedExpressFrameSignal, txFrameTreeId);
+                numExpressFramesSent++;
+            }
+            transmittingPreemptableFrame = false;
+            // the next frame selection serves waiting express frames
+            cancelEvent(&preemptCurrentFrameMsg);
+            cancelEvent(&recheckExpressFrameMsg);
+
+            // the frame is on the wire, statistics use the values taken at its start
+            if (frameCompleted) {
+                numFramesSent++;
+                numBytesSent += txFrameBytes;
+                if (txPauseUnits >= 0) {
+                    numPauseFramesSent++;
+                    emit(txPausePkUnitsSignal, txPauseUnits);
+                }
+            }
+
+            EV_INFO << "Transmission successfully completed.\n";
+            lastTxFinishTime = simTime();
+
+            if (pauseUnitsRequested > 0) {
+                // if we received a PAUSE frame recently, go into PAUSE state
+                EV_DETAIL << "Going to PAUSE mode for " << pauseUnitsRequested << " time units\n";
+                scheduleEndPausePeriod(pauseUnitsRequested);
+                pauseUnitsRequested = 0;
+            }
+            else {
+                EV_DETAIL << "Start IFG period\n";
+                scheduleEndIFGPeriod();
+            }
+            break;
+        }
+
+        case TxEvent::END_IFG:
+            if (transmitState != WAIT_IFG_STATE)
+                throw cRuntimeError("Not in WAIT_IFG_STATE at the end of IFG period");
+            // End of IFG period, okay to transmit
+            EV_DETAIL << "IFG elapsed" << endl;
+            startNextFrame();
+            break;
+
+        case TxEvent::END_PAUSE:
+            if (transmitState != PAUSE_STATE)
+                throw cRuntimeError("End of PAUSE event occurred when not in PAUSE_STATE!");
+            EV_DETAIL << "Pause finished, resuming transmissions\n";
+            startNextFrame();
+            break;
+
+        case TxEvent::PAUSE_RECEIVED:
+            if (transmitState == TX_IDLE_STATE) {
+                EV_DETAIL << "PAUSE frame received, pausing for " << pauseUnits << " time units\n";
+                if (pauseUnits > 0)
+                    scheduleEndPausePeriod(pauseUnits);
+            }
+            else if (transmitState == PAUSE_STATE) {
+                EV_DETAIL << "PAUSE frame received, pausing for " << pauseUnits << " more time units from now\n";
+                cancelEvent(endPauseMsg);
+                // Terminate PAUSE if pauseUnits == 0; Extend PAUSE if pauseUnits > 0
+                scheduleEndPausePeriod(pauseUnits);
+            }
+            else {
+                // transmitter busy -- wait until it finishes with current frame (endTx)
+                // and then it'll go to PAUSE state
+                EV_DETAIL << "PAUSE frame received, storing pause request\n";
+                pauseUnitsRequested = pauseUnits;
+            }
+            break;
+
+        case TxEvent::EXPRESS_FRAME_ENQUEUED:
+            if (transmittingPreemptableFrame && !fragmentPreempted) {
+                if (!transmissionSelection->hasExpressPacketEnqueued())
+                    break;
+                if (isPreemptionNowPossible()) {
+                    // the fragment is preempted when the express frame arrives
+                    EV_DETAIL << "Express frame enqueued, preemption is possible immediately, requesting frame." << endl;
+                    getNextFrameFromQueue();
+                }
+                else {
+                    simtime_t preemptionTime = isPreemptionLaterPossible();
+                    if (!preemptionTime.isZero()) {
+                        EV_DETAIL << "Express frame enqueued, preemption is possible later, scheduling express frame request for later." << endl;
+                        cancelEvent(&recheckExpressFrameMsg);
+                        scheduleAt(preemptionTime, &recheckExpressFrameMsg);
+                    }
+                    else
+                        EV_DETAIL << "Express frame enqueued, preemption is not possible at all." << endl;
+                }
+            }
+            else if (transmitState == TX_IDLE_STATE && onHold) {
+                // nothing is requested from the queue during a hold until an express frame is enqueued
+                startNextFrame();
+            }
+            break;
+
+        case TxEvent::PREEMPT:
+            // An express frame may have preempted the fragment in the meantime
+            if (transmittingPreemptableFrame && !fragmentPreempted)
+                preemptCurrentFrame();
+            break;
+
+        case TxEvent::HOLD:
+            if (!isPreemptionActive())
+                break;
+            // preempt current preemptable traffic, don't allow new one
+            EV_INFO << "Got hold request." << endl;
+            onHold = true;
+            if (transmittingPreemptableFrame) {
+                if (!fragmentPreempted)
+                    schedulePreemption();
+            }
+            else if (transmitState == TX_IDLE_STATE)
+                startNextFrame();
+            break;
+
+        case TxEvent::RELEASE:
+            if (!isPreemptionActive())
+                break;
+            EV_INFO << "Got release request." << endl;
+            onHold = false;
+            cancelEvent(&holdRequestMsg);
+            cancelEvent(&preemptCurrentFrameMsg);
+            // requests made during the hold might never be served
+            transmissionSelection->removePendingRequests();
+            // during a transmission or the IFG, the next frame is selected when it ends
+            if (transmitState == TX_IDLE_STATE)
+                startNextFrame();
+            break;
+
+        case TxEvent::LAUNCH_TIME:
+            if (transmitState == TX_IDLE_STATE)
+                startNextFrame();
+            break;
+    }
+}
+
+void EtherMacFullDuplexTSN::selectNextFrame()
+{
+    ASSERT(curTxFrame == nullptr);
+    if (!controlFrames.empty()) {
+        curTxFrame = controlFrames.front();
+        controlFrames.pop_front();
+        return;
+    }
+
+    // Without preemption, every frame is sent as express frame in arrival order
+    auto it = std::find_if(pendingFrames.begin(), pendingFrames.end(),
+            [this](Packet *frame) { return isSentAsExpress(frame); });
+    if (it != pendingFrames.end()) {
+        curTxFrame = *it;
+        pendingFrames.erase(it);
+        return;
+    }
+
+    if (isPreemptionActive() && transmissionSelection->hasExpressPacketEnqueued()) {
+        EV_DETAIL << "Requesting express frame before continuing with preemptable frames." << endl;
+        getNextFrameFromQueue();
+        return;
+    }
+
+    // During a hold, only express frames are sent
+    if (onHold)
+        return;
+
+    if (currentPreemptableFrame) {
+        EV_DETAIL << "Continuing preempted frame " << currentPreemptableFrame << endl;
+        curTxFrame = currentPreemptableFrame;
+    }
+    else if (!pendingFrames.empty()) {
+        curTxFrame = pendingFrames.front();
+        pendingFrames.pop_front();
+    }
+    else
+        getNextFrameFromQueue();
+}
+
+void EtherMacFullDuplexTSN::startNextFrame()
+{
+    if (controlFrames.empty() && !verificationMPackets.empty()) {
+        startVerificationTransmission();
+        return;
+    }
+    selectNextFrame();
+
+    // A continued preemptable frame has been launched already
+    if (curTxFrame && curTxFrame != currentPreemptableFrame) {
+        simtime_t launchTime = getLaunchTime(curTxFrame);
+        if (launchTime > simTime()) {
+            // the frames behind it wait as well, except Mac control and express frames
+            EV_DETAIL << "Frame " << curTxFrame << " waits for its launch time " << launchTime << endl;
+            pendingFrames.push_front(curTxFrame);
+            curTxFrame = nullptr;
+            cancelEvent(&launchTimeMsg);
+            scheduleAt(launchTime, &launchTimeMsg);
+        }
+    }
+
+    if (curTxFrame) {
+        // Other frames are queued, transmit next frame
+        EV_DETAIL << "Transmit next frame in output queue\n";
+        startFrameTransmission();
+    }
+    else {
+        // No more frames set transmitter to idle
+        changeTransmissionState(TX_IDLE_STATE);
+        if (!txQueue.extQueue) {
+            // Output only for internal queue (we cannot be shure that there
+            //are no other frames in external queue)
+            EV_DETAIL << "No more frames to send, transmitter set to idle\n";
+        }
+    }
+}
+
 void EtherMacFullDuplexTSN::startFrameTransmission()
 {
     ASSERT(curTxFrame);
-    EV_DETAIL << "Transmitting a copy of frame " << curTxFrame << endl;
+    EV_DETAIL << "Transmitting frame " << curTxFrame << endl;
 
-    Packet *frame = curTxFrame->dup();    // note: we need to duplicate the frame because we emit a signal with it in endTxPeriod()
-    const auto& hdr = frame->peekAtFront<EthernetMacHeader>();    // note: we need to duplicate the frame because we emit a signal with it in endTxPeriod()
+    // The frame itself is sent or kept as currentPreemptableFrame instead of
+    // a copy. What the end of the transmission needs from it is taken now.
+    Packet *frame = curTxFrame;
+    curTxFrame = nullptr;
+    const auto& hdr = frame->peekAtFront<EthernetMacHeader>();
     ASSERT(hdr);
     ASSERT(!hdr->getSrc().isUnspecified());
 
+    bool continuation = frame == currentPreemptableFrame;
+    txFrameBytes = frame->getByteLength();
+    txFrameTreeId = frame->getTreeId();
+    txPauseUnits = -1;
+    if (!continuation) {
+        if (hdr->getTypeOrLength() == ETHERTYPE_FLOW_CONTROL) {
+            const auto& controlFrame = frame->peekDataAt<EthernetControlFrame>(hdr->getChunkLength(), b(-1));
+            if (controlFrame->getOpCode() == ETHERNET_CONTROL_PAUSE) {
+                const auto& pauseFrame = CHK(dynamicPtrCast<const EthernetPauseFrame>(controlFrame));
+                txPauseUnits = pauseFrame->getPauseTime();
+            }
+            else if (controlFrame->getOpCode() == ETHERNET_CONTROL_PFC)
+                numPfcFramesSent++;
+        }
+        emit(packetSentToLowerSignal, frame);    // before padding and encapsulation change the frame
+    }
+
+    if (continuation || !isSentAsExpress(frame)) {
+        // only one preemptable frame is in transmission at a time
+        ASSERT(continuation || currentPreemptableFrame == nullptr);
+        startFragmentTransmission(frame);
+    }
+    else
+        startExpressTransmission(frame);
+    changeTransmissionState(TRANSMITTING_STATE);
+}
+
+void EtherMacFullDuplexTSN::startExpressTransmission(Packet *frame)
+{
     if (frame->getDataLength() < curEtherDescr->frameMinBytes) {
         auto oldFcs = frame->removeAtBack<EthernetFcs>();
         EtherEncap::addPaddingAndFcs(frame, oldFcs->getFcsMode(), curEtherDescr->frameMinBytes);
     }
+    updateLatencyTag(frame, simTime() - eFrameArrivalTime, SIMTIME_ZERO);
 
     // add preamble and SFD (Starting Frame Delimiter), then send out
     encapsulate(frame);
 
     // send
     EV_INFO << "Transmission of " << frame << " started.\n";
-    auto oldPacketProtocolTag = frame->removeTag<PacketProtocolTag>();
-
-    FlowMetaTag * oldFlowMetaTag = nullptr;
-    if (frame->findTag<FlowMetaTag>() != nullptr){
-        oldFlowMetaTag = frame->removeTag<FlowMetaTag>();
-    }
-
-    frame->clearTags();
-    auto newPacketProtocolTag = frame->addTag<PacketProtocolTag>();
-    *newPacketProtocolTag = *oldPacketProtocolTag;
-    delete oldPacketProtocolTag;
-    if (oldFlowMetaTag != nullptr){
-        auto newFlowMetaTag = frame->addTag<FlowMetaTag>();
-        *newFlowMetaTag = *oldFlowMetaTag;
-        delete oldFlowMetaTag;
-    }
-
     auto signal = new EthernetSignal(frame->getName());
     if (sendRawBytes) {
+        // raw bytes don't carry any tags
         signal->encapsulate(new Packet(frame->getName(), frame->peekAllAsBytes()));
         delete frame;
     }
-    else
+    else {
+        TransmittedTags::filter(frame);
         signal->encapsulate(frame);
+    }
     send(signal, physOutGate);
+    if (isSampled(numExpressFramesSent)) {
+        emit(eMacDelay, simTime() - eFrameArrivalTime);
+        emit(startTransmissionExpressFrameSignal, txFrameTreeId);
+    }
 
     scheduleAt(transmissionChannel->getTransmissionFinishTime(), endTxMsg);
-    changeTransmissionState(TRANSMITTING_STATE);
+}
+
+void EtherMacFullDuplexTSN::startFragmentTransmission(Packet *frame)
+{
+    // Sending a fragment of a preemptable frame. The link is blocked for the
+    // fragment's wire time and the mPacket is sent when it ends.
+    if (fragmentCount == 0) {
+        currentPreemptableFrame = frame;
+        // Padding is added once, fragments are cut from the padded frame
+        if (frame->getDataLength() < curEtherDescr->frameMinBytes) {
+            auto oldFcs = frame->removeAtBack<EthernetFcs>();
+            EtherEncap::addPaddingAndFcs(frame, oldFcs->getFcsMode(), curEtherDescr->frameMinBytes);
+        }
+        preemptableFrameBytes = frame->getByteLength();
+        preemptableBytesSent = 0;
+        txFrameCount = (txFrameCount + 1) % 4;
+        preemptableMacDelay = simTime() - pFrameArrivalTime;
+        preemptableFrameStart = simTime();
+    }
+
+    EV_INFO << "Transmission of fragment " << fragmentCount + 1 << " of " << frame << " started.\n";
+    transmittingPreemptableFrame = true;
+    fragmentPreempted = false;
+    fragmentCount++;
+    preemptableTransmissionStart = simTime();
+
+    // Without preemption, the rest of the frame including its FCS is sent
+    fragmentDataBytes = preemptableFrameBytes - preemptableBytesSent;
+    scheduleAt(simTime() + calculateTransmissionDuration(getFragmentHeaderBytes() + fragmentDataBytes), endTxMsg);
+    if (isSampled(numFragmentsSent))
+        emit(pMacDelay, simTime() - pFrameArrivalTime);
+}
+
+bool EtherMacFullDuplexTSN::sendFragment()
+{
+    Packet *frame = currentPreemptableFrame;
+    long treeId = frame->getTreeId();
+    bool sampled = isSampled(numFragmentsSent);
+    if (sampled)
+        emit(transmittedPreemptableFramePartSignal, treeId);
+
+    bool startFragment = fragmentCount == 1;
+    bool finalFragment = preemptableBytesSent + fragmentDataBytes == preemptableFrameBytes;
+    MPacket *mPacket = new MPacket();
+    mPacket->setStartFragment(startFragment);
+    mPacket->setFrameCount(txFrameCount);
+    mPacket->setFragCount(startFragment ? 0 : (fragmentCount - 2) % 4);
+    mPacket->setFinalFragment(finalFragment);
+    mPacket->setDataBytes(fragmentDataBytes);
+    // A non-final fragment ends with an mCRC, the final one with the frame's FCS
+    mPacket->setWireBytes(getFragmentHeaderBytes() + fragmentDataBytes + (finalFragment ? 0 : 4));
+
+    EV_INFO << "Fragment " << mPacket << " of " << frame << " transmitted: " << fragmentDataBytes << "B, "
+            << preemptableBytesSent + fragmentDataBytes << "/" << preemptableFrameBytes << "B" << endl;
+
+    if (finalFragment) {
+        // The final fragment carries the frame itself. Its front offset
+        // tells the receiver how many bytes the earlier fragments carried.
+        currentPreemptableFrame = nullptr;
+        // Preemption stretched the transmission beyond the frame's own wire time
+        simtime_t preemptionDelay = SIMTIME_ZERO;
+        if (!startFragment) {
+            preemptionDelay = std::max(simTime() - preemptableFrameStart
+                    - calculateTransmissionDuration((PREAMBLE_BYTES + SFD_BYTES).get() + preemptableFrameBytes),
+                    SIMTIME_ZERO);
+        }
+        updateLatencyTag(frame, preemptableMacDelay, preemptionDelay);
+        frame->setFrontOffset(B(preemptableBytesSent));
+        TransmittedTags::filter(frame);
+        mPacket->setFragment(frame);
+        if (sampled) {
+            emit(transmittedPreemptableFrameSignal, treeId);
+            if (startFragment)
+                emit(transmittedPreemptableFullSignal, treeId);
+            else
+                emit(transmittedPreemptableFinalSignal, treeId);
+        }
+        numPreemptableFramesSent++;
+        preemptableFrameBytes = 0;
+        preemptableBytesSent = 0;
+        fragmentCount = 0;
+    }
+    else {
+        // Earlier fragments share the frame's data instead of copying it
+        mPacket->setFragment(new Packet(frame->getName(), frame->peekDataAt(B(preemptableBytesSent), B(fragmentDataBytes))));
+        if (sampled)
+            emit(transmittedPreemptableNonFinalSignal, treeId);
+        preemptableBytesSent += fragmentDataBytes;
+    }
+    numFragmentsSent++;
+    send(mPacket, physOutGate);
+    return finalFragment;
+}
+
+void EtherMacFullDuplexTSN::schedulePreemption()
+{
+    ASSERT(transmittingPreemptableFrame && !fragmentPreempted);
+    if (isPreemptionNowPossible())
+        preemptCurrentFrame();
+    else {
+        // Preempt as soon as possible, if possible at all
+        simtime_t preemptionTime = isPreemptionLaterPossible();
+        if (!preemptionTime.isZero()) {
+            EV_INFO << "Scheduling preemption once the fragment is large enough." << endl;
+            cancelEvent(&preemptCurrentFrameMsg);
+            scheduleAt(preemptionTime, &preemptCurrentFrameMsg);
+        }
+        else
+            EV_INFO << "Preemption is not possible at all." << endl;
+    }
+}
+
+void EtherMacFullDuplexTSN::preemptCurrentFrame()
+{
+    ASSERT(transmittingPreemptableFrame);
+    ASSERT(currentPreemptableFrame);
+    ASSERT(isPreemptionNowPossible());
+
+    cancelEvent(endTxMsg);
+    cancelEvent(&preemptCurrentFrameMsg);
+
+    if (isSampled(numPreemptions))
+        emit(preemptCurrentFrameSignal, currentPreemptableFrame->getTreeId());
+    numPreemptions++;
+
+    EV_INFO << "Preempting current frame " << currentPreemptableFrame << endl;
+    // Cut the fragment after the bytes on the wire and end it with the mCRC (4B)
+    fragmentDataBytes = calculateFragmentDataBytesSent(simTime());
+    fragmentPreempted = true;
+    scheduleAt(preemptableTransmissionStart
+            + calculateTransmissionDuration(getFragmentHeaderBytes() + fragmentDataBytes + 4), endTxMsg);
+}
+
+void EtherMacFullDuplexTSN::scheduleEndIFGPeriod()
+{
+    ASSERT(nullptr == curTxFrame);
+    changeTransmissionState(WAIT_IFG_STATE);
+    simtime_t endIFGTime = simTime() + linkTiming.getInterframeGap();
+    scheduleAt(endIFGTime, endIFGMsg);
+}
+
+void EtherMacFullDuplexTSN::scheduleEndPausePeriod(int pauseUnits)
+{
+    ASSERT(nullptr == curTxFrame);
+    // length is interpreted as 512-bit-time units
+    simtime_t pausePeriod = linkTiming.durationForBits(pauseUnits * PAUSE_UNIT_BITS);
+    scheduleAt(simTime() + pausePeriod, endPauseMsg);
+    changeTransmissionState(PAUSE_STATE);
+}
+
+simtime_t EtherMacFullDuplexTSN::getLaunchTime(Packet *frame) const
+{
+    if (!launchTimeEnabled)
+        return SIMTIME_ZERO;
+    auto launchTimeReq = frame->findTag<LaunchTimeReq>();
+    return launchTimeReq != nullptr ? launchTimeReq->getLaunchTime() : SIMTIME_ZERO;
 }
 
 void EtherMacFullDuplexTSN::handleUpperPacket(Packet *packet)
@@ -154,6 +811,15 @@ void EtherMacFullDuplexTSN::handleUpperPacket(Packet *packet)
 
     EV_INFO << "Received " << packet << " from upper layer." << endl;
 
+    // Without preemption, all frames are sent as express frames
+    if (isSentAsExpress(packet)) {
+        eFrameArrivalTime = simTime();
+        if (isSampled(numFramesFromHL))
+            emit(receivedExpressFrameFromUpper, packet->getTreeId());
+    }
+    else
+        pFrameArrivalTime = simTime();
+
     numFramesFromHL++;
     emit(packetReceivedFromUpperSignal, packet);
 
@@ -191,27 +857,295 @@ void EtherMacFullDuplexTSN::handleUpperPacket(Packet *packet)
         EtherEncap::addFcs(packet, oldFcs->getFcsMode());
     }
 
-    if (txQueue.extQueue) {
-        ASSERT(curTxFrame == nullptr);
-        ASSERT(transmitState == TX_IDLE_STATE || transmitState == PAUSE_STATE);
-        curTxFrame = packet;
+    processTxEvent(TxEvent::FRAME_ARRIVED, packet);
+}
+
+bool EtherMacFullDuplexTSN::isExpressFrame(Packet *packet) const
+{
+    return packet->findTag<ExpressFrameReq>() != nullptr;
+}
+
+bool EtherMacFullDuplexTSN::isSentAsExpress(Packet *packet) const
+{
+    return isExpressFrame(packet) || !isPreemptionActive();
+}
+
+bool EtherMacFullDuplexTSN::isPreemptionActive() const
+{
+    return preemptionEnabled
+           && (verifyStatus == VerifyStatus::DISABLED || verifyStatus == VerifyStatus::SUCCEEDED);
+}
+
+bool EtherMacFullDuplexTSN::isPreemptionNowPossible()
+{
+    if (!isPreemptionActive() || !transmittingPreemptableFrame)
+        return true;
+    else if (fragmentPreempted)
+        return false;
+    int dataBytesSent = calculateFragmentDataBytesSent(simTime());
+    // The final fragment ends with the frame's FCS (4B)
+    int bytesRemaining = preemptableFrameBytes - preemptableBytesSent - dataBytesSent - 4;
+    // Both the fragment and the rest of the frame must be large enough
+    return bytesRemaining >= kFramePreemptionMinFinalPayloadSize.get()
+           && dataBytesSent >= minNonFinalFragmentBytes;
+}
+
+simtime_t EtherMacFullDuplexTSN::isPreemptionLaterPossible()
+{
+    if (isPreemptionNowPossible())
+        return simTime();
+    else if (fragmentPreempted)
+        return SIMTIME_ZERO;
+    int dataBytesSent = calculateFragmentDataBytesSent(simTime());
+    // Bytes remaining if the fragment was cut at the minimum size, without the FCS
+    int bytesRemaining = preemptableFrameBytes - preemptableBytesSent - minNonFinalFragmentBytes - 4;
+    if (dataBytesSent < minNonFinalFragmentBytes && bytesRemaining >= kFramePreemptionMinFinalPayloadSize.get()) {
+        // once the fragment is large enough
+        return preemptableTransmissionStart + calculateTransmissionDuration(getFragmentHeaderBytes() + minNonFinalFragmentBytes);
+    }
+    // Too late to preempt this frame at all
+    return SIMTIME_ZERO;
+}
+
+int EtherMacFullDuplexTSN::getFragmentHeaderBytes() const
+{
+    // Preamble and SMD, continuation fragments add a frag count byte
+    return (PREAMBLE_BYTES + SFD_BYTES).get() + (fragmentCount > 1 ? 1 : 0);
+}
+
+int EtherMacFullDuplexTSN::calculateFragmentDataBytesSent(simtime_t timeToCheck)
+{
+    if (!transmittingPreemptableFrame)
+        return 0;
+    simtime_t timeElapsed = timeToCheck - preemptableTransmissionStart;
+    int bytesSent = linkTiming.bitsForDuration(timeElapsed) / 8 - getFragmentHeaderBytes();
+    return std::max(0, std::min(bytesSent, static_cast<int>(fragmentDataBytes)));
+}
+
+simtime_t EtherMacFullDuplexTSN::calculateTransmissionDuration(int bytes)
+{
+    ASSERT(bytes >= 0);
+    ASSERT(!linkTiming.isZero());
+    return linkTiming.durationForBytes(bytes);
+}
+
+void EtherMacFullDuplexTSN::updateMinNonFinalFragmentBytes()
+{
+    // The receiver's addFragSize is the minimum the transmitter must use
+    int addFragSize = std::max(localAddFragSize, remoteAddFragSize);
+    minNonFinalFragmentBytes = (kFramePreemptionMinNonFinalPayloadSize + kFramePreemptionAddFragSizeUnit * addFragSize).get();
+}
+
+void EtherMacFullDuplexTSN::handleVerifyTimer()
+{
+    if (!connected)
+        return;
+    else if (verifyAttemptsLeft == 0) {
+        EV_WARN << "Link partner didn't respond to verify mPackets, frame preemption stays disabled." << endl;
+        verifyStatus = VerifyStatus::FAILED;
+        return;
     }
+    verifyAttemptsLeft--;
+    queueVerificationMPacket(MPACKET_VERIFY);
+    scheduleAt(simTime() + verifyTime, &verifyTimerMsg);
+}
+
+void EtherMacFullDuplexTSN::handleRespond()
+{
+    if (!connected)
+        return;
+    queueVerificationMPacket(MPACKET_RESPOND);
+}
+
+void EtherMacFullDuplexTSN::queueVerificationMPacket(MPacketType type)
+{
+    // A verify mPacket still waiting for the link isn't repeated
+    if (std::find(verificationMPackets.begin(), verificationMPackets.end(), type) != verificationMPackets.end())
+        return;
+    verificationMPackets.push_back(type);
+    processTxEvent(TxEvent::VERIFICATION_MPACKET_QUEUED);
+}
+
+void EtherMacFullDuplexTSN::startVerificationTransmission()
+{
+    // Verify and respond mPackets are minimum sized. Like fragments, they
+    // are zero-length and the link is blocked for their wire bytes, followed
+    // by the IFG.
+    MPacket *mPacket = new MPacket();
+    mPacket->setType(verificationMPackets.front());
+    verificationMPackets.pop_front();
+    mPacket->setStartFragment(true);
+    mPacket->setFinalFragment(true);
+    mPacket->setAddFragSize(localAddFragSize);
+    mPacket->setWireBytes((PREAMBLE_BYTES + SFD_BYTES).get() + kFramePreemptionMinNonFinalPayloadSize.get() + 4);
+    simtime_t duration = calculateTransmissionDuration(mPacket->getWireBytes());
+    EV_INFO << "Sending " << mPacket << endl;
+    send(mPacket, physOutGate);
+    transmittingVerificationMPacket = true;
+    scheduleAt(simTime() + duration, endTxMsg);
+    changeTransmissionState(TRANSMITTING_STATE);
+}
+
+bool EtherMacFullDuplexTSN::applyErrorModel(cMessage *msg)
+{
+    if (errorModel == nullptr)
+        return true;
+
+    // mPackets block the link for their wire bytes, but are zero-length
+    MPacket *mPacket = dynamic_cast<MPacket *>(msg);
+    LinkErrorModel::FrameFate fate;
+    if (mPacket != nullptr)
+        fate = errorModel->applyTo(mPacket->getFragment(), B(mPacket->getWireBytes()), calculateTransmissionDuration(mPacket->getWireBytes()));
     else {
-        if (txQueue.innerQueue->isFull())
-            throw cRuntimeError("txQueue length exceeds %d -- this is probably due to "
-                                "a bogus app model generating excessive traffic "
-                                "(or if this is normal, increase txQueueLimit!)",
-                    txQueue.innerQueue->getQueueLimit());
-        // store frame and possibly begin transmitting
-        EV_DETAIL << "Frame " << frame << " arrived from higher layers, enqueueing\n";
-        txQueue.innerQueue->insertFrame(packet);
+        EthernetSignal *signal = check_and_cast<EthernetSignal *>(msg);
+        fate = errorModel->applyTo(signal->getEncapsulatedPacket(), b(signal->getBitLength()), signal->getDuration());
+    }
+
+    if (fate == LinkErrorModel::FrameFate::CORRUPTED) {
+        // discarded by the (m)CRC check like any other bit error
+        check_and_cast<cPacket *>(msg)->setBitError(true);
+    }
+    else if (fate == LinkErrorModel::FrameFate::LOST) {
+        EV_WARN << "Link is down -- dropping msg " << msg << endl;
+        if (mPacket == nullptr) {
+            // a lost fragment shows up as reassembly error of its frame
+            auto packet = check_and_cast<Packet *>(check_and_cast<EthernetSignal *>(msg)->decapsulate());
+            decapsulate(packet);
+            PacketDropDetails details;
+            details.setReason(INTERFACE_DOWN);
+            emit(packetDroppedSignal, packet, &details);
+            delete packet;
+        }
+        delete msg;
+        return false;
+    }
+    return true;
+}
 
-        if (!curTxFrame && !txQueue.innerQueue->isEmpty() && transmitState == TX_IDLE_STATE)
-            curTxFrame = check_and_cast<Packet *>(txQueue.innerQueue->pop());
+void EtherMacFullDuplexTSN::processMPacket(MPacket *mPacket)
+{
+    if (!preemptionCapable) {
+        // A Mac without frame preemption doesn't recognize the SMD of mPackets
+        // and discards them. Verify mPackets therefore stay unanswered, so the
+        // link partner doesn't enable preemption.
+        EV_WARN << "Frame preemption is not supported -- dropping " << mPacket << endl;
+        numMPacketsDropped++;
+        delete mPacket;
+    }
+    else if (mPacket->getType() == MPACKET_FRAGMENT)
+        receiveFragment(mPacket);
+    else if (mPacket->hasBitError()) {
+        EV_WARN << "mCRC error in " << mPacket << ", discarding it" << endl;
+        delete mPacket;
     }
+    else
+        receiveVerificationMPacket(mPacket);
+}
 
-    if (transmitState == TX_IDLE_STATE)
-        startFrameTransmission();
+void EtherMacFullDuplexTSN::receiveFragment(MPacket *mPacket)
+{
+    numFragmentsReceived++;
+    bool startFragment = mPacket->getStartFragment();
+    bool finalFragment = mPacket->getFinalFragment();
+    int frameCount = mPacket->getFrameCount();
+    int fragCount = mPacket->getFragCount();
+    bool hasBitError = mPacket->hasBitError();
+    Packet *fragment = mPacket->removeFragment();
+    take(fragment);
+    delete mPacket;
+
+    if (startFragment) {
+        if (reassembly) {
+            // The final fragment of the previous frame never arrived
+            EV_WARN << "Frame start received while reassembling, discarding " << reassembly << endl;
+            numReassemblyErrors++;
+            abortReassembly();
+        }
+        if (!finalFragment) {
+            if (hasBitError) {
+                EV_WARN << "mCRC error in " << fragment << ", discarding frame" << endl;
+                numReassemblyErrors++;
+                delete fragment;
+            }
+            else {
+                reassembly = fragment;
+                rxFrameCount = frameCount;
+                rxNextFragCount = 0;
+            }
+            return;
+        }
+    }
+    else {
+        if (!reassembly) {
+            // SMD-C without a frame start, e.g. after a discarded fragment
+            EV_WARN << "Continuation fragment " << fragment << " received without a frame start" << endl;
+            numSmdErrors++;
+            delete fragment;
+            return;
+        }
+        if (hasBitError || frameCount != rxFrameCount || fragCount != rxNextFragCount) {
+            // Fragment lost, reordered or damaged, the frame can't be reassembled
+            EV_WARN << "Fragment " << fragment << " doesn't continue " << reassembly << ", discarding frame" << endl;
+            numReassemblyErrors++;
+            delete fragment;
+            abortReassembly();
+            return;
+        }
+        if (!finalFragment) {
+            reassembly->insertAtBack(fragment->peekAll());
+            delete fragment;
+            rxNextFragCount = (rxNextFragCount + 1) % 4;
+            return;
+        }
+        // The final fragment is the frame itself, the earlier fragments must
+        // have carried exactly the bytes in front of its front offset
+        if (fragment->getFrontOffset() != reassembly->getTotalLength()) {
+            EV_WARN << "Length of " << reassembly << " doesn't match " << fragment << ", discarding frame" << endl;
+            numReassemblyErrors++;
+            delete fragment;
+            abortReassembly();
+            return;
+        }
+        fragment->trimFront();
+        fragment->insertAtFront(reassembly->peekAll());
+        abortReassembly();
+        numFramesReassembled++;
+    }
+
+    // Complete frame, received like an express frame
+    if (isSampled(numFragmentsReceived))
+        emit(receivedPreemptableFrameFull, fragment->getTreeId());
+    collectLatencies(fragment, false);
+    encapsulate(fragment);
+    EthernetSignal *signal = new EthernetSignal(fragment->getName());
+    signal->encapsulate(fragment);
+    signal->setBitError(hasBitError);
+    processMsgFromNetwork(signal);
+}
+
+void EtherMacFullDuplexTSN::abortReassembly()
+{
+    delete reassembly;
+    reassembly = nullptr;
+}
+
+void EtherMacFullDuplexTSN::receiveVerificationMPacket(MPacket *mPacket)
+{
+    int type = mPacket->getType();
+    remoteAddFragSize = std::min(static_cast<int>(mPacket->getAddFragSize()), kFramePreemptionMaxAddFragSize);
+    delete mPacket;
+    updateMinNonFinalFragmentBytes();
+
+    if (type == MPACKET_VERIFY) {
+        // Only a Mac with preemption enabled responds
+        if (preemptionEnabled && !respondMsg.isScheduled())
+            scheduleAt(simTime(), &respondMsg);
+    }
+    else if (verifyStatus == VerifyStatus::VERIFYING) {
+        EV_INFO << "Link partner supports frame preemption with addFragSize " << remoteAddFragSize << "." << endl;
+        verifyStatus = VerifyStatus::SUCCEEDED;
+        cancelEvent(&verifyTimerMsg);
+    }
 }
 
 void EtherMacFullDuplexTSN::processMsgFromNetwork(EthernetSignal *signal)
@@ -259,14 +1193,19 @@ void EtherMacFullDuplexTSN::processMsgFromNetwork(EthernetSignal *signal)
         return;
 
     if (frame->getTypeOrLength() == ETHERTYPE_FLOW_CONTROL) {
-        const auto& controlFrame = curTxFrame->peekDataAt<EthernetControlFrame>(frame->getChunkLength(), b(-1));
+        const auto& controlFrame = packet->peekDataAt<EthernetControlFrame>(frame->getChunkLength(), b(-1));
         if (controlFrame->getOpCode() == ETHERNET_CONTROL_PAUSE) {
             auto pauseFrame = check_and_cast<const EthernetPauseFrame *>(controlFrame.get());
             int pauseUnits = pauseFrame->getPauseTime();
             delete packet;
             numPauseFramesRcvd++;
             emit(rxPausePkUnitsSignal, pauseUnits);
-            processPauseCommand(pauseUnits);
+            processTxEvent(TxEvent::PAUSE_RECEIVED, nullptr, pauseUnits);
+        }
+        else if (pfcEnabled && controlFrame->getOpCode() == ETHERNET_CONTROL_PFC) {
+            numPfcFramesRcvd++;
+            processPfcFrame(check_and_cast<const EthernetPfcFrame *>(controlFrame.get()));
+            delete packet;
         }
         else {
             EV_INFO << "Received unknown ethernet flow control frame" << frame << " dropped." << endl;
@@ -279,61 +1218,120 @@ void EtherMacFullDuplexTSN::processMsgFromNetwork(EthernetSignal *signal)
     }
 }
 
-void EtherMacFullDuplexTSN::handleEndIFGPeriod()
+void EtherMacFullDuplexTSN::processReceivedDataFrame(Packet *packet, const Ptr<const EthernetMacHeader>& frame)
 {
-    ASSERT(nullptr == curTxFrame);
-    if (transmitState != WAIT_IFG_STATE)
-        throw cRuntimeError("Not in WAIT_IFG_STATE at the end of IFG period");
+    // statistics
+    unsigned long curBytes = packet->getByteLength();
+    numFramesReceivedOK++;
+    numBytesReceivedOK += curBytes;
+    emit(rxPkOkSignal, packet);
 
-    // End of IFG period, okay to transmit
-    EV_DETAIL << "IFG elapsed" << endl;
+    addReceptionTags(packet);
 
-    getNextFrameFromQueue();
-    beginSendFrames();
+    numFramesPassedToHL++;
+    emit(packetSentToUpperSignal, packet);
+    if (cutThroughEnabled) {
+        // the frame was passed up when its transmission started
+        EV_INFO << "Completely received packet " << packet << ".\n";
+        delete packet;
+        return;
+    }
+    // pass up to upper layer
+    EV_INFO << "Sending " << packet << " to upper layer.\n";
+    send(packet, upperLayerOutGateId);
 }
 
-void EtherMacFullDuplexTSN::handleEndTxPeriod()
+void EtherMacFullDuplexTSN::addReceptionTags(Packet *packet)
 {
-    // we only get here if transmission has finished successfully
-    if (transmitState != TRANSMITTING_STATE)
-        throw cRuntimeError("Model error: End of transmission, and incorrect state detected");
-
-    if (nullptr == curTxFrame)
-        throw cRuntimeError("Model error: Frame under transmission cannot be found");
+    packet->addTagIfAbsent<DispatchProtocolReq>()->setProtocol(&Protocol::ethernetMac);
+    packet->addTagIfAbsent<PacketProtocolTag>()->setProtocol(&Protocol::ethernetMac);
+    if (interfaceEntry)
+        packet->addTagIfAbsent<InterfaceInd>()->setInterfaceId(interfaceEntry->getInterfaceId());
+}
 
-    numFramesSent++;
-    numBytesSent += curTxFrame->getByteLength();
-    emit(packetSentToLowerSignal, curTxFrame);    //consider: emit with start time of frame
+void EtherMacFullDuplexTSN::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    Enter_Method_Silent();
 
-    const auto& header = curTxFrame->peekAtFront<EthernetMacHeader>();
-    if (header->getTypeOrLength() == ETHERTYPE_FLOW_CONTROL) {
-        const auto& controlFrame = curTxFrame->peekDataAt<EthernetControlFrame>(header->getChunkLength(), b(-1));
-        if (controlFrame->getOpCode() == ETHERNET_CONTROL_PAUSE) {
-            const auto& pauseFrame = CHK(dynamicPtrCast<const EthernetPauseFrame>(controlFrame));
-            numPauseFramesSent++;
-            emit(txPausePkUnitsSignal, pauseFrame->getPauseTime());
-        }
+    if (signalID != packetSentToLowerSignal || source != cutThroughPartner) {
+        EtherMacBase::receiveSignal(source, signalID, obj, details);
+        return;
     }
 
-    EV_INFO << "Transmission of " << curTxFrame << " successfully completed.\n";
-    delete curTxFrame;
-    curTxFrame = nullptr;
-    lastTxFinishTime = simTime();
+    // Control frames, e.g. the partner's PAUSE and PFC frames, and frames not
+    // addressed to us are handled once completely received
+    Packet *sentPacket = check_and_cast<Packet *>(obj);
+    const auto& frame = sentPacket->peekAtFront<EthernetMacHeader>();
+    if (frame->getTypeOrLength() == ETHERTYPE_FLOW_CONTROL || !isDataFrameForUs(frame))
+        return;
 
+    // The link partner started to send a frame, it is passed up once its
+    // first bit arrived
+    cDatarateChannel *inputChannel = check_and_cast<cDatarateChannel *>(physInGate->findIncomingTransmissionChannel());
+    Packet *packet = sentPacket->dup();
+    addReceptionTags(packet);
+    EV_INFO << "Sending " << packet << " to upper layer.\n";
+    sendDelayed(packet, inputChannel->getDelay(), upperLayerOutGateId);
+}
 
-    if (pauseUnitsRequested > 0) {
-        // if we received a PAUSE frame recently, go into PAUSE state
-        EV_DETAIL << "Going to PAUSE mode for " << pauseUnitsRequested << " time units\n";
+bool EtherMacFullDuplexTSN::isDataFrameForUs(const Ptr<const EthernetMacHeader>& frame)
+{
+    return frame->getDest().equals(getMacAddress()) || frame->getDest().isBroadcast()
+            || frame->getDest().isMulticast() || promiscuous;
+}
 
-        scheduleEndPausePeriod(pauseUnitsRequested);
-        pauseUnitsRequested = 0;
-    }
-    else {
-        EV_DETAIL << "Start IFG period\n";
-        scheduleEndIFGPeriod();
+void EtherMacFullDuplexTSN::packetEnqueued(IPassiveQueue *queue)
+{
+    Enter_Method("packetEnqueued()");
+
+    if (transmittingPreemptableFrame && statisticsMode == StatisticsMode::PER_PACKET
+            && transmissionSelection->hasExpressPacketEnqueued())
+        emit(expressFrameEnqueuedWhileSendingPreemptableSignal, 0);
+    processTxEvent(TxEvent::EXPRESS_FRAME_ENQUEUED);
+}
+
+void EtherMacFullDuplexTSN::hold(simtime_t delay)
+{
+    Enter_Method("hold()");
+
+    if (delay.isZero())
+        processTxEvent(TxEvent::HOLD);
+    else if (isPreemptionActive()) {
+        EV_INFO << "Scheduling hold in " << delay.inUnit(SIMTIME_US) << "us." << endl;
+        cancelEvent(&holdRequestMsg);
+        scheduleAt(simTime() + delay, &holdRequestMsg);
     }
 }
 
+void EtherMacFullDuplexTSN::release()
+{
+    Enter_Method("release()");
+
+    processTxEvent(TxEvent::RELEASE);
+}
+
+simtime_t EtherMacFullDuplexTSN::getHoldAdvance()
+{
+    Enter_Method_Silent("getHoldAdvance()");
+
+    // The maximum delay before express traffic can flow after a hold: the
+    // longest fragment that can't be preempted is a continuation one byte
+    // shorter than the smallest remainder allowing a preemption, followed by an IFG.
+    int longestNonPreemptableBytes = (PREAMBLE_BYTES + SFD_BYTES).get() + 1
+            + minNonFinalFragmentBytes + kFramePreemptionMinFinalPayloadSize.get() + 4 - 1;
+    int bytesToWait = longestNonPreemptableBytes + b(INTERFRAME_GAP_BITS).get() / 8;
+    return calculateTransmissionDuration(bytesToWait);
+}
+
+simtime_t EtherMacFullDuplexTSN::getGuardBandWithoutPreemption()
+{
+    Enter_Method_Silent("getGuardBandWithoutPreemption()");
+
+    // Without preemption, express traffic may have to wait for a frame of maximum size and an IFG
+    int bytesToWait = (PREAMBLE_BYTES + SFD_BYTES).get() + B(MAX_ETHERNET_FRAME_BYTES).get() + b(INTERFRAME_GAP_BITS).get() / 8;
+    return calculateTransmissionDuration(bytesToWait);
+}
+
 void EtherMacFullDuplexTSN::finish()
 {
     EtherMacBase::finish();
@@ -342,97 +1340,214 @@ void EtherMacFullDuplexTSN::finish()
     simtime_t totalRxChannelIdleTime = t - totalSuccessfulRxTime;
     recordScalar("rx channel idle (%)", 100 * (totalRxChannelIdleTime / t));
     recordScalar("rx channel utilization (%)", 100 * (totalSuccessfulRxTime / t));
+    if (!preemptionCapable)
+        recordScalar("mPackets dropped", numMPacketsDropped);
+    else {
+        recordScalar("fragments sent", numFragmentsSent);
+        recordScalar("fragments received", numFragmentsReceived);
+        recordScalar("frames reassembled", numFramesReassembled);
+        recordScalar("reassembly errors", numReassemblyErrors);
+        recordScalar("smd errors", numSmdErrors);
+        if (statisticsMode != StatisticsMode::PER_PACKET) {
+            recordScalar("express frames sent", numExpressFramesSent);
+            recordScalar("preemptable frames sent", numPreemptableFramesSent);
+            recordScalar("preemptions", numPreemptions);
+        }
+        recordExpressLatencyBounds();
+    }
+
+    if (recordLatencyHistograms) {
+        recordLatencies(expressLatencies, "express");
+        recordLatencies(preemptableLatencies, "preemptable");
+        for (const auto& stream : streamLatencies)
+            recordLatencies(stream.second, "stream " + std::to_string(stream.first));
+        recordLatencies(otherStreamLatencies, "other streams");
+    }
+
+    if (pfcEnabled) {
+        recordScalar("pfc frames sent", numPfcFramesSent);
+        recordScalar("pfc frames received", numPfcFramesRcvd);
+    }
 }
 
-void EtherMacFullDuplexTSN::handleEndPausePeriod()
+bool EtherMacFullDuplexTSN::isSampled(long n) const
 {
-    ASSERT(nullptr == curTxFrame);
-    if (transmitState != PAUSE_STATE)
-        throw cRuntimeError("End of PAUSE event occurred when not in PAUSE_STATE!");
+    // the signals of frame preemption are only emitted by the pMAC
+    if (!preemptionCapable)
+        return false;
+    switch (statisticsMode) {
+        case StatisticsMode::PER_PACKET:
+            return true;
+        case StatisticsMode::SAMPLED:
+            return n % statisticsSampleInterval == 0;
+        default:
+            return false;
+    }
+}
 
-    EV_DETAIL << "Pause finished, resuming transmissions\n";
-    if (!curTxFrame)
-        getNextFrameFromQueue();
-    beginSendFrames();
+void EtherMacFullDuplexTSN::updateLatencyTag(Packet *frame, simtime_t macDelay, simtime_t preemptionDelay)
+{
+    // Only frames that passed a queue carry the tag
+    if (frame->findTag<LatencyTag>() == nullptr)
+        return;
+    auto latencyTag = frame->addTagIfAbsent<LatencyTag>();
+    latencyTag->setMacDelay(macDelay);
+    latencyTag->setPreemptionDelay(preemptionDelay);
 }
 
-void EtherMacFullDuplexTSN::processReceivedDataFrame(Packet *packet, const Ptr<const EthernetMacHeader>& frame)
+void EtherMacFullDuplexTSN::collectLatencies(Packet *frame, bool express)
 {
-    // statistics
-    unsigned long curBytes = packet->getByteLength();
-    numFramesReceivedOK++;
-    numBytesReceivedOK += curBytes;
-    emit(rxPkOkSignal, packet);
+    // The tag describes the last hop only, it doesn't travel any further
+    std::unique_ptr<LatencyTag> latencyTag(frame->removeTagIfPresent<LatencyTag>());
+    if (!recordLatencyHistograms || latencyTag == nullptr)
+        return;
 
-    packet->addTagIfAbsent<DispatchProtocolReq>()->setProtocol(&Protocol::ethernetMac);
-    packet->addTagIfAbsent<PacketProtocolTag>()->setProtocol(&Protocol::ethernetMac);
-    if (interfaceEntry)
-        packet->addTagIfAbsent<InterfaceInd>()->setInterfaceId(interfaceEntry->getInterfaceId());
+    LatencyHistograms *classLatencies = express ? &expressLatencies : &preemptableLatencies;
+    LatencyHistograms *flowLatencies = nullptr;
+    auto flowMetaTag = frame->findTag<FlowMetaTag>();
+    if (flowMetaTag != nullptr) {
+        auto it = streamLatencies.find(flowMetaTag->getFlowId());
+        if (it != streamLatencies.end())
+            flowLatencies = &it->second;
+        else if (streamLatencies.size() < maxLatencyStreams)
+            flowLatencies = &streamLatencies[flowMetaTag->getFlowId()];
+        else
+            flowLatencies = &otherStreamLatencies;
+    }
+    for (LatencyHistograms *histograms : { classLatencies, flowLatencies }) {
+        if (histograms == nullptr)
+            continue;
+        histograms->queueingDelay.collect(latencyTag->getQueueingTime());
+        histograms->macDelay.collect(latencyTag->getMacDelay());
+        if (!express)
+            histograms->preemptionDelay.collect(latencyTag->getPreemptionDelay());
+    }
+}
 
-    numFramesPassedToHL++;
-    emit(packetSentToUpperSignal, packet);
-    // pass up to upper layer
-    EV_INFO << "Sending " << packet << " to upper layer.\n";
-    send(packet, upperLayerOutGateId);
+void EtherMacFullDuplexTSN::recordLatencies(const LatencyHistograms& histograms, const std::string& name)
+{
+    histograms.queueingDelay.record(this, name + " queueing delay");
+    histograms.macDelay.record(this, name + " mac delay");
+    histograms.preemptionDelay.record(this, name + " preemption delay");
 }
 
-void EtherMacFullDuplexTSN::processPauseCommand(int pauseUnits)
+void EtherMacFullDuplexTSN::recordExpressLatencyBounds()
 {
-    if (transmitState == TX_IDLE_STATE) {
-        EV_DETAIL << "PAUSE frame received, pausing for " << pauseUnitsRequested << " time units\n";
-        if (pauseUnits > 0)
-            scheduleEndPausePeriod(pauseUnits);
-    }
-    else if (transmitState == PAUSE_STATE) {
-        EV_DETAIL << "PAUSE frame received, pausing for " << pauseUnitsRequested
-                  << " more time units from now\n";
-        cancelEvent(endPauseMsg);
+    if (!preemptionEnabled || !connected)
+        return;
+    int interframeGapBytes = b(INTERFRAME_GAP_BITS).get() / 8;
+    int minFinalFragmentBytes = kFramePreemptionMinFinalPayloadSize.get() + 4;
+    // A preemption adds the mCRC, the continuation's preamble, SMD and frag count and an IFG
+    int preemptionOverheadBytes = 4 + (PREAMBLE_BYTES + SFD_BYTES).get() + 1 + interframeGapBytes;
+
+    simtime_t blocking = getHoldAdvance();
+    simtime_t blockingWithoutPreemption = getGuardBandWithoutPreemption();
+    EV_INFO << getFullPath() << ": addFragSize " << std::max(localAddFragSize, remoteAddFragSize)
+            << ", worst-case blocking of express frames " << blocking.inUnit(SIMTIME_NS) << "ns ("
+            << blockingWithoutPreemption.inUnit(SIMTIME_NS) << "ns without preemption), "
+            << preemptionOverheadBytes << "B overhead per preemption" << endl;
+
+    recordScalar("preemption verified", verifyStatus == VerifyStatus::SUCCEEDED);
+    recordScalar("addFragSize", std::max(localAddFragSize, remoteAddFragSize));
+    recordScalar("min preemptable frame bytes", minNonFinalFragmentBytes + minFinalFragmentBytes);
+    recordScalar("preemption overhead bytes", preemptionOverheadBytes);
+    recordScalar("worst-case express blocking", blocking, "s");
+    recordScalar("worst-case blocking without preemption", blockingWithoutPreemption, "s");
+}
 
-        // Terminate PAUSE if pauseUnits == 0; Extend PAUSE if pauseUnits > 0
-        scheduleEndPausePeriod(pauseUnits);
-    }
-    else {
-        // transmitter busy -- wait until it finishes with current frame (endTx)
-        // and then it'll go to PAUSE state
-        EV_DETAIL << "PAUSE frame received, storing pause request\n";
-        pauseUnitsRequested = pauseUnits;
+void EtherMacFullDuplexTSN::processPfcFrame(const EthernetPfcFrame *pfcFrame)
+{
+    for (int priority = 0; priority < NUM_PFC_PRIORITIES; priority++) {
+        if (pfcFrame->getClassEnableVector() & (1 << priority)) {
+            // a pause time of zero resumes the priority right away
+            int pauseUnits = pfcFrame->getPauseTime(priority);
+            EV_DETAIL << "PFC frame received, pausing priority " << priority << " for " << pauseUnits << " time units\n";
+            pfcPausedUntil[priority] = simTime() + linkTiming.durationForBits(pauseUnits * PAUSE_UNIT_BITS);
+        }
     }
+    updatePausedPriorities();
 }
 
-void EtherMacFullDuplexTSN::scheduleEndIFGPeriod()
+void EtherMacFullDuplexTSN::updatePausedPriorities()
 {
-    ASSERT(nullptr == curTxFrame);
-    changeTransmissionState(WAIT_IFG_STATE);
-    simtime_t endIFGTime = simTime() + (b(INTERFRAME_GAP_BITS).get() / curEtherDescr->txrate);
-    scheduleAt(endIFGTime, endIFGMsg);
+    simtime_t now = simTime();
+    simtime_t pauseEnd = SIMTIME_MAX;
+    uint64_t pausedQueues = 0;
+    for (int priority = 0; priority < NUM_PFC_PRIORITIES; priority++) {
+        if (pfcPausedUntil[priority] > now) {
+            pausedQueues |= UINT64_C(1) << priority;
+            pauseEnd = std::min(pauseEnd, pfcPausedUntil[priority]);
+        }
+    }
+    cancelEvent(&pfcPauseEndMsg);
+    if (pausedQueues)
+        scheduleAt(pauseEnd, &pfcPauseEndMsg);
+    transmissionSelection->setPausedQueues(pausedQueues);
 }
 
-void EtherMacFullDuplexTSN::scheduleEndPausePeriod(int pauseUnits)
+void EtherMacFullDuplexTSN::receiveSignal(cComponent *source, simsignal_t signalID, long l, cObject *details)
 {
-    ASSERT(nullptr == curTxFrame);
-    // length is interpreted as 512-bit-time units
-    simtime_t pausePeriod = ((pauseUnits * PAUSE_UNIT_BITS) / curEtherDescr->txrate);
-    scheduleAt(simTime() + pausePeriod, endPauseMsg);
-    changeTransmissionState(PAUSE_STATE);
+    Enter_Method_Silent();
+
+    if (signalID != pfcPauseSignal && signalID != pfcResumeSignal) {
+        cListener::receiveSignal(source, signalID, l, details);
+        return;
+    }
+    int priority = l;
+    if (priority < 0 || priority >= NUM_PFC_PRIORITIES)
+        throw cRuntimeError("Priority-based flow control supports priorities 0 to %d, not %d", NUM_PFC_PRIORITIES - 1, priority);
+
+    // the first congested queue of a priority pauses it, the last one resumes it
+    if (signalID == pfcPauseSignal) {
+        if (pfcCongestedQueues[priority]++ == 0)
+            sendPfcFrame(1 << priority, pfcPauseUnits);
+    }
+    else if (pfcCongestedQueues[priority] > 0 && --pfcCongestedQueues[priority] == 0)
+        sendPfcFrame(1 << priority, 0);
 }
 
-void EtherMacFullDuplexTSN::beginSendFrames()
+void EtherMacFullDuplexTSN::sendPfcFrame(int classEnableVector, int pauseUnits)
 {
-    if (curTxFrame) {
-        // Other frames are queued, transmit next frame
-        EV_DETAIL << "Transmit next frame in output queue\n";
-        startFrameTransmission();
+    if (!connected || disabled)
+        return;
+
+    auto pfcFrame = makeShared<EthernetPfcFrame>();
+    pfcFrame->setOpCode(ETHERNET_CONTROL_PFC);
+    pfcFrame->setChunkLength(B(20));
+    pfcFrame->setClassEnableVector(classEnableVector);
+    for (int priority = 0; priority < NUM_PFC_PRIORITIES; priority++) {
+        if (classEnableVector & (1 << priority))
+            pfcFrame->setPauseTime(priority, pauseUnits);
     }
-    else {
-        // No more frames set transmitter to idle
-        changeTransmissionState(TX_IDLE_STATE);
-        if (!txQueue.extQueue) {
-            // Output only for internal queue (we cannot be shure that there
-            //are no other frames in external queue)
-            EV_DETAIL << "No more frames to send, transmitter set to idle\n";
-        }
+    auto header = makeShared<EthernetMacHeader>();
+    header->setDest(MacAddress::MULTICAST_PAUSE_ADDRESS);
+    header->setSrc(getMacAddress());
+    header->setTypeOrLength(ETHERTYPE_FLOW_CONTROL);
+    auto packet = new Packet(pauseUnits > 0 ? "PfcPause" : "PfcResume");
+    packet->insertAtBack(pfcFrame);
+    packet->insertAtFront(header);
+    EtherEncap::addPaddingAndFcs(packet, FCS_DECLARED_CORRECT);
+    // Mac control frames can't be preempted
+    packet->addTag<ExpressFrameReq>();
+    EV_DETAIL << "Sending " << packet << " for priorities " << classEnableVector << endl;
+    controlFrames.push_back(packet);
+
+    // repeat the pause before it expires at the link partner
+    if (pauseUnits > 0 && !pfcRefreshMsg.isScheduled())
+        scheduleAt(simTime() + linkTiming.durationForBits(pfcPauseUnits * PAUSE_UNIT_BITS) / 2, &pfcRefreshMsg);
+
+    processTxEvent(TxEvent::CONTROL_FRAME_QUEUED);
+}
+
+void EtherMacFullDuplexTSN::handlePfcRefresh()
+{
+    int classEnableVector = 0;
+    for (int priority = 0; priority < NUM_PFC_PRIORITIES; priority++) {
+        if (pfcCongestedQueues[priority] > 0)
+            classEnableVector |= 1 << priority;
     }
+    if (classEnableVector != 0)
+        sendPfcFrame(classEnableVector, pfcPauseUnits);
 }
 
 } // namespace inet
-
@@ -19,55 +19,382 @@
 #define __INET_EtherMacFullDuplexTSN_H
 
 #include "inet/common/INETDefs.h"
+#include "inet/common/queue/IPassiveQueue.h"
 #include "inet/linklayer/ethernet/EtherMacBase.h"
 
+#include <deque>
+#include <map>
+#include <string>
+
+#include "nesting/common/LatencyHistogram.h"
+#include "nesting/common/time/LinkTiming.h"
+#include "nesting/linklayer/common/ITsnMac.h"
+#include "nesting/linklayer/common/LinkErrorModel.h"
+#include "nesting/linklayer/ethernet/EthernetPfcFrame_m.h"
+#include "nesting/linklayer/framePreemption/MPacket.h"
+
 using namespace omnetpp;
 using namespace inet;
 
 namespace nesting {
 
+class TransmissionSelection;
+
 /**
  * A simplified version of EtherMac. Since modern Ethernets typically
  * operate over duplex links where's no contention, the original CSMA/CD
  * algorithm is no longer needed. This simplified implementation doesn't
  * contain CSMA/CD, frames are just simply queued up and sent out one by one.
+ *
+ * The Mac is the only Mac implementation of NeSTiNg. Frame preemption,
+ * cut-through and launch time are policies enabled by parameters; the
+ * ~EtherMACFullDuplexPreemptable and ~EtherMacFullDuplexCutThrough modules
+ * only change their defaults.
+ *
+ * Every transition of the transmitter is made by processTxEvent(), the other
+ * methods of the transmit path only carry out what it decides. Frames are
+ * sent to the wire without copying them, so curTxFrame is only set until a
+ * transmission starts.
+ *
+ * Frame preemption models the MAC merge sublayer of IEEE 802.3br within this
+ * module: express frames are sent as a whole (eMAC), preemptable frames are
+ * sent as fragments in MPacket messages (pMAC) and reassembled by the
+ * receiving Mac before they are passed up. A Mac without preemptionCapable
+ * drops received mPackets, so the link partner's verification of preemption
+ * support fails.
+ *
+ * Besides INET's rates, the Mac supports 2.5, 5, 25, 50 and 100Gbps links.
+ * The timing constants of the link are computed once the channel is read.
+ *
+ * Received frames can be passed through a ~LinkErrorModel to model lossy
+ * links.
+ *
+ * With pfcEnabled, the Mac supports priority-based flow control (IEEE
+ * 802.1Qbb): received PFC frames pause single priorities of the
+ * ~TransmissionSelection module, and PFC frames are sent when the queues of
+ * a ~SharedBufferManager cross their pause thresholds.
  */
-class INET_API EtherMacFullDuplexTSN : public EtherMacBase
+class INET_API EtherMacFullDuplexTSN : public EtherMacBase, public IPassiveQueueListener, public ITsnMac
 {
   public:
     EtherMacFullDuplexTSN();
+    virtual ~EtherMacFullDuplexTSN();
+
+    virtual const LinkTiming& getLinkTiming() const override { return linkTiming; }
+    virtual bool isFramePreemptionEnabled() override { return preemptionEnabled; }
+    virtual void hold(simtime_t delay) override;
+    virtual void release() override;
+    virtual bool isOnHold() override { return onHold; }
+    virtual simtime_t getHoldAdvance() override;
+    virtual simtime_t getGuardBandWithoutPreemption() override;
+
+    /** Called by the ~TransmissionSelection module when a frame is enqueued. */
+    virtual void packetEnqueued(IPassiveQueue *queue) override;
+
+    using EtherMacBase::receiveSignal;
+    /** Receives the pause and resume signals of the ~SharedBufferManager. */
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, long l, cObject *details) override;
+    /** Receives the start of transmissions of the link partner for cut-through. */
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
 
   protected:
+    /** Events of the transmitter, see processTxEvent(). */
+    enum class TxEvent {
+        /** A frame arrived from the upper layer or the queue. */
+        FRAME_ARRIVED,
+        /** A Mac control frame was queued for transmission. */
+        CONTROL_FRAME_QUEUED,
+        /** A verify or respond mPacket was queued, it doesn't preempt. */
+        VERIFICATION_MPACKET_QUEUED,
+        END_TX,
+        END_IFG,
+        END_PAUSE,
+        /** A PAUSE frame was received. */
+        PAUSE_RECEIVED,
+        /** The queue holds an express frame, or preemption became possible. */
+        EXPRESS_FRAME_ENQUEUED,
+        /** The fragment on the wire may be cut now, for a hold. */
+        PREEMPT,
+        HOLD,
+        RELEASE,
+        /** The launch time of the frame waiting for it was reached. */
+        LAUNCH_TIME
+    };
+
+    enum class VerifyStatus {
+        /** Verification is off, preemption is used right away. */
+        DISABLED,
+        VERIFYING,
+        SUCCEEDED,
+        /** The link partner didn't respond, preemption stays off. */
+        FAILED
+    };
+
+    enum class StatisticsMode {
+        /** Signals are emitted for every frame. */
+        PER_PACKET,
+        /** Signals are only emitted for every n-th frame. */
+        SAMPLED,
+        /** No per-frame signals, counters are recorded as scalars. */
+        AGGREGATE
+    };
+
+    /** Latencies of received frames, taken from their LatencyTag. */
+    struct LatencyHistograms {
+        LatencyHistogram queueingDelay;
+        LatencyHistogram macDelay;
+        /** Only collected for preemptable frames. */
+        LatencyHistogram preemptionDelay;
+    };
+
     virtual int numInitStages() const override { return NUM_INIT_STAGES; }
     virtual void initialize(int stage) override;
     virtual void initializeStatistics() override;
     virtual void initializeFlags() override;
     virtual void handleMessageWhenUp(cMessage *msg) override;
+    virtual void readChannelParameters(bool errorWhenAsymmetric) override;
+    virtual void refreshDisplay() const override;
 
     // finish
     virtual void finish() override;
 
-    // event handlers
-    virtual void handleEndIFGPeriod();
-    virtual void handleEndTxPeriod();
-    virtual void handleEndPausePeriod();
     virtual void handleSelfMessage(cMessage *msg) override;
+    virtual void handleUpperPacket(Packet *pk) override;
 
-    // helpers
+    /**
+     * State machine of the transmitter. It decides for every event which
+     * frame is sent next, when a fragment on the wire is preempted and which
+     * state the transmitter goes to. The pause units are only used by
+     * PAUSE_RECEIVED, the frame only by FRAME_ARRIVED.
+     */
+    virtual void processTxEvent(TxEvent event, Packet *frame = nullptr, int pauseUnits = 0);
+
+    // transmit path, called by processTxEvent() only
+    /**
+     * Sets curTxFrame to the next frame to send: Mac control frames first,
+     * then express frames, then the preemptable frame in transmission, then
+     * the next frame of the queue. Requests a frame from the queue if none
+     * is available yet.
+     */
+    virtual void selectNextFrame();
+    /** Starts the next frame, or goes to TX_IDLE_STATE if there is none. */
+    virtual void startNextFrame();
     virtual void startFrameTransmission();
-    virtual void handleUpperPacket(Packet *pk) override;
-    virtual void processMsgFromNetwork(EthernetSignal *signal);
-    virtual void processReceivedDataFrame(Packet *packet, const Ptr<const EthernetMacHeader>& frame);
-    virtual void processPauseCommand(int pauseUnits);
+    virtual void startExpressTransmission(Packet *frame);
+    virtual void startFragmentTransmission(Packet *frame);
+    /** Sends the mPacket of the fragment that ended, returns true if it was the final one. */
+    virtual bool sendFragment();
+    /** Preempts the fragment on the wire now, or as soon as it is long enough. */
+    virtual void schedulePreemption();
+    virtual void preemptCurrentFrame();
     virtual void scheduleEndIFGPeriod();
     virtual void scheduleEndPausePeriod(int pauseUnits);
-    virtual void beginSendFrames();
+    /** Returns the launch time of a frame that isn't sent yet, or zero. */
+    virtual simtime_t getLaunchTime(Packet *frame) const;
+
+    // frame preemption
+    virtual bool isExpressFrame(Packet *packet) const;
+    /** Returns true if a frame is sent as a whole, i.e. express or preemption isn't active. */
+    virtual bool isSentAsExpress(Packet *packet) const;
+    virtual bool isPreemptionActive() const;
+    virtual bool isPreemptionNowPossible();
+    /** Returns when the fragment on the wire may be cut, or zero if never. */
+    virtual simtime_t isPreemptionLaterPossible();
+    virtual int getFragmentHeaderBytes() const;
+    virtual int calculateFragmentDataBytesSent(simtime_t timeToCheck);
+    virtual simtime_t calculateTransmissionDuration(int bytes);
+    virtual void updateMinNonFinalFragmentBytes();
+    virtual void handleVerifyTimer();
+    virtual void handleRespond();
+    /** Queues a verify or respond mPacket for the transmit state machine. */
+    virtual void queueVerificationMPacket(MPacketType type);
+    /** Sends the next queued verify or respond mPacket. */
+    virtual void startVerificationTransmission();
+
+    // receive path
+    virtual bool applyErrorModel(cMessage *msg);
+    virtual void processMPacket(MPacket *mPacket);
+    virtual void receiveFragment(MPacket *mPacket);
+    virtual void abortReassembly();
+    virtual void receiveVerificationMPacket(MPacket *mPacket);
+    virtual void processMsgFromNetwork(EthernetSignal *signal);
+    virtual void processReceivedDataFrame(Packet *packet, const Ptr<const EthernetMacHeader>& frame);
+    virtual void addReceptionTags(Packet *packet);
+    /** Returns true if a data frame is passed up, like dropFrameNotForUs() without dropping. */
+    virtual bool isDataFrameForUs(const Ptr<const EthernetMacHeader>& frame);
+
+    // priority-based flow control
+    virtual void processPfcFrame(const EthernetPfcFrame *pfcFrame);
+    /** Pauses the queues whose pause time didn't expire yet. */
+    virtual void updatePausedPriorities();
+    virtual void sendPfcFrame(int classEnableVector, int pauseUnits);
+    virtual void handlePfcRefresh();
 
     // statistics
+    virtual bool isSampled(long n) const;
+    virtual void updateLatencyTag(Packet *frame, simtime_t macDelay, simtime_t preemptionDelay);
+    virtual void collectLatencies(Packet *frame, bool express);
+    virtual void recordLatencies(const LatencyHistograms& histograms, const std::string& name);
+    virtual void recordExpressLatencyBounds();
+
+    static simsignal_t preemptCurrentFrameSignal;
+    static simsignal_t transmittedExpressFrameSignal;
+    static simsignal_t startTransmissionExpressFrameSignal;
+    static simsignal_t transmittedPreemptableFrameSignal;
+    static simsignal_t transmittedPreemptableFramePartSignal;
+    static simsignal_t transmittedPreemptableNonFinalSignal;
+    static simsignal_t transmittedPreemptableFinalSignal;
+    static simsignal_t transmittedPreemptableFullSignal;
+    static simsignal_t expressFrameEnqueuedWhileSendingPreemptableSignal;
+    static simsignal_t eMacDelay;
+    static simsignal_t pMacDelay;
+    static simsignal_t receivedExpressFrame;
+    static simsignal_t receivedPreemptableFrameFull;
+    static simsignal_t receivedExpressFrameFromUpper;
+
+    LinkTiming linkTiming;
+
+    /** Error model of received frames and mPackets, nullptr if the link is lossless. */
+    LinkErrorModel *errorModel = nullptr;
+
+    /** Transmission selection of the queue, nullptr if the queue is another one. */
+    TransmissionSelection *transmissionSelection = nullptr;
+
+    // policies
+    bool preemptionCapable = false;
+    bool preemptionEnabled = false;
+    bool cutThroughEnabled = false;
+    bool launchTimeEnabled = false;
+    bool pfcEnabled = false;
+
+    // Frames waiting for transmission, all owned. Frames of the queue are
+    // only kept here if they can't be sent right away, e.g. because a Mac
+    // control frame or a fragment is on the wire.
+    /** Mac control frames. */
+    std::deque<Packet *> controlFrames;
+    /** Frames of the queue in arrival order. */
+    std::deque<Packet *> pendingFrames;
+    /** Verify and respond mPackets, sent after the Mac control frames. */
+    std::deque<MPacketType> verificationMPackets;
+    /** Preemptable frame of which at least one fragment has been sent. */
+    Packet *currentPreemptableFrame = nullptr;
+
+    // Frame in transmission, which is owned by the channel or kept as
+    // currentPreemptableFrame, so curTxFrame isn't set anymore.
+    long txFrameBytes = 0;    // length before padding and encapsulation
+    long txFrameTreeId = -1;
+    int txPauseUnits = -1;    // pause units if it is a PAUSE frame, -1 otherwise
+    /** True if the transmission is a fragment of currentPreemptableFrame. */
+    bool transmittingPreemptableFrame = false;
+    /** True if the transmission is a verify or respond mPacket. */
+    bool transmittingVerificationMPacket = false;
+
+    /** Waits for the launch time of curTxFrame. */
+    cMessage launchTimeMsg = cMessage("launchTime");
+
+    // Hold and release of preemptable frames
+    bool onHold = false;
+    cMessage holdRequestMsg = cMessage("holdRequest");
+    /** Preempts the fragment on the wire as soon as possible for a hold. */
+    cMessage preemptCurrentFrameMsg = cMessage("preemptCurrentFrame");
+    /** Checks again for express frames once preemption becomes possible. */
+    cMessage recheckExpressFrameMsg = cMessage("recheckForQueuedExpressFrame");
+
+    // Arrival of frames at the Mac, for the Mac delay of their LatencyTag
+    simtime_t pFrameArrivalTime;
+    simtime_t eFrameArrivalTime;
+    /** Mac delay of the preemptable frame in transmission. */
+    simtime_t preemptableMacDelay;
+    /** Start of the first fragment of the preemptable frame in transmission. */
+    simtime_t preemptableFrameStart;
+
+    // Transmit side of the MAC merge sublayer (pMAC). A preemptable frame is
+    // sent as mPackets: the link is blocked for the fragment's wire time and
+    // a zero-length MPacket is sent when the fragment ends.
+    simtime_t preemptableTransmissionStart;
+    /** Bytes of the preemptable frame (including its FCS) to be sent. */
+    unsigned int preemptableFrameBytes = 0;
+    /** Bytes of the preemptable frame sent in finished fragments. */
+    unsigned int preemptableBytesSent = 0;
+    /** Frame bytes in the fragment on the wire, cut short on preemption. */
+    unsigned int fragmentDataBytes = 0;
+    /** Fragments of the preemptable frame started so far. */
+    int fragmentCount = 0;
+    /** Frame count of the SMD of the current preemptable frame. */
+    int txFrameCount = 0;
+    /** Set once the fragment on the wire has been cut short. */
+    bool fragmentPreempted = false;
+
+    // Receive side of the MAC merge sublayer (pMAC)
+    /** Fragments of the frame reassembled so far, nullptr if none. */
+    Packet *reassembly = nullptr;
+    int rxFrameCount = 0;
+    int rxNextFragCount = 0;
+
+    // Minimum fragment size (addFragSize) of this port and the link partner
+    int localAddFragSize = 0;
+    int remoteAddFragSize = 0;
+    /** Minimum frame bytes in a non-final fragment, without the mCRC. */
+    int minNonFinalFragmentBytes = 0;
+
+    // Verification of the link partner's preemption capability
+    VerifyStatus verifyStatus = VerifyStatus::DISABLED;
+    int verifyAttemptsLeft = 0;
+    simtime_t verifyTime;
+    cMessage verifyTimerMsg = cMessage("verifyTimer");
+    cMessage respondMsg = cMessage("respond");
+
+    /** Mac of the link partner whose transmissions are cut through. */
+    cModule *cutThroughPartner = nullptr;
+
+    /** Number of priorities of priority-based flow control. */
+    static const int NUM_PFC_PRIORITIES = 8;
+
+    /** Pause quanta of sent PFC frames. */
+    int pfcPauseUnits = 0;
+
+    /** End of the pause of every priority, in the past if it isn't paused. */
+    simtime_t pfcPausedUntil[NUM_PFC_PRIORITIES];
+    cMessage pfcPauseEndMsg = cMessage("pfcPauseEnd");
+
+    /** Queues of the switch above their pause threshold, by priority. */
+    int pfcCongestedQueues[NUM_PFC_PRIORITIES] = {};
+    /** Repeats the pause of congested priorities before it expires. */
+    cMessage pfcRefreshMsg = cMessage("pfcRefresh");
+    simsignal_t pfcPauseSignal = -1;
+    simsignal_t pfcResumeSignal = -1;
+
+    // Counters besides the ones of EtherMacBase, recorded as scalars
     simtime_t totalSuccessfulRxTime;    // total duration of successful transmissions on channel
+    /** Number of dropped mPackets, see processMPacket(). */
+    long numMPacketsDropped = 0;
+    // Counters of the MAC merge sublayer, named after the 802.3br attributes
+    long numFragmentsSent = 0;
+    long numFragmentsReceived = 0;
+    long numFramesReassembled = 0;
+    long numReassemblyErrors = 0;
+    long numSmdErrors = 0;
+    long numExpressFramesSent = 0;
+    long numPreemptableFramesSent = 0;
+    long numPreemptions = 0;
+    long numPfcFramesSent = 0;
+    long numPfcFramesRcvd = 0;
+
+    StatisticsMode statisticsMode = StatisticsMode::PER_PACKET;
+    /** Every n-th frame emits signals in sampled statistics mode. */
+    long statisticsSampleInterval = 1;
+
+    // Latency histograms of received frames, all of constant size
+    bool recordLatencyHistograms = true;
+    LatencyHistograms expressLatencies;
+    LatencyHistograms preemptableLatencies;
+    /** Histograms per FlowMetaTag flow id, for at most maxLatencyStreams. */
+    std::map<uint64_t, LatencyHistograms> streamLatencies;
+    /** Histograms of the flows exceeding maxLatencyStreams. */
+    LatencyHistograms otherStreamLatencies;
+    size_t maxLatencyStreams = 0;
 };
 
 } // namespace inet
 
 #endif // ifndef __INET_EtherMacFullDuplexTSN_H
-
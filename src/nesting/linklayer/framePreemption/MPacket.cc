@@ -0,0 +1,138 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/linklayer/framePreemption/MPacket.h"
+
+namespace nesting {
+
+Register_Class(MPacket);
+
+MPacket::MPacket(const char *name) :
+        MPacket_Base(name) {
+    this->fragment = nullptr;
+}
+
+MPacket::MPacket(const MPacket& other) :
+        MPacket_Base(other) {
+    this->fragment = nullptr;
+    copy(other);
+}
+
+MPacket::~MPacket() {
+    if (fragment) {
+        drop(fragment);
+        delete fragment;
+    }
+}
+
+void MPacket::setCorrectName() {
+    std::ostringstream oss;
+    if (type == MPACKET_VERIFY || type == MPACKET_RESPOND) {
+        oss << (type == MPACKET_VERIFY ? "SMD-V" : "SMD-R");
+        setName(oss.str().c_str());
+        return;
+    }
+    if (fragment) {
+        oss << fragment->getName() << " ";
+    }
+    oss << (startFragment ? "SMD-S" : "SMD-C") << static_cast<int>(frameCount);
+    if (!startFragment) {
+        oss << " frag " << static_cast<int>(fragCount);
+    }
+    if (finalFragment) {
+        oss << " final";
+    }
+    setName(oss.str().c_str());
+}
+
+void MPacket::copy(const MPacket& other) {
+    if (other.fragment) {
+        this->fragment = other.fragment->dup();
+        take(this->fragment);
+    }
+}
+
+MPacket& MPacket::operator=(const MPacket& other) {
+    if (this == &other)
+        return *this;
+    MPacket_Base::operator=(other);
+    if (fragment) {
+        drop(fragment);
+        delete fragment;
+        fragment = nullptr;
+    }
+    copy(other);
+    return *this;
+}
+
+void MPacket::setFragment(const cFragmentPointer& fragment) {
+    if (this->fragment) {
+        throw cRuntimeError(this,
+                "setFragment(): Another fragment is already set.");
+    }
+    if (fragment) {
+        if (fragment->getOwner()
+                != getSimulation()->getContextSimpleModule()) {
+            throw cRuntimeError(this,
+                    "setFragment(): Not owner of message (%s)%s, owner is (%s)%s",
+                    fragment->getClassName(), fragment->getFullName(),
+                    fragment->getOwner()->getClassName(),
+                    fragment->getOwner()->getFullPath().c_str());
+        }
+        this->fragment = fragment;
+        take(fragment);
+    }
+    setCorrectName();
+}
+
+cFragmentPointer MPacket::removeFragment() {
+    cFragmentPointer packet = fragment;
+    fragment = nullptr;
+    if (packet) {
+        drop(packet);
+    }
+    return packet;
+}
+
+MPacket* MPacket::dup() const {
+    return new MPacket(*this);
+}
+
+void MPacket::setType(int type) {
+    MPacket_Base::setType(type);
+    setCorrectName();
+}
+
+void MPacket::setStartFragment(bool startFragment) {
+    MPacket_Base::setStartFragment(startFragment);
+    setCorrectName();
+}
+
+void MPacket::setFinalFragment(bool finalFragment) {
+    MPacket_Base::setFinalFragment(finalFragment);
+    setCorrectName();
+}
+
+void MPacket::setFrameCount(uint8_t frameCount) {
+    MPacket_Base::setFrameCount(frameCount);
+    setCorrectName();
+}
+
+void MPacket::setFragCount(uint8_t fragCount) {
+    MPacket_Base::setFragCount(fragCount);
+    setCorrectName();
+}
+
+} /* namespace nesting */
@@ -0,0 +1,52 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_LINKLAYER_FRAMEPREEMPTION_MPACKET_H_
+#define NESTING_LINKLAYER_FRAMEPREEMPTION_MPACKET_H_
+
+#include <omnetpp.h>
+
+#include "nesting/linklayer/framePreemption/MPacket_m.h"
+
+using namespace omnetpp;
+namespace nesting {
+
+/**
+ * This class extends the auto-generated base class for mPackets and adds
+ * ownership handling of the fragment.
+ */
+class MPacket: public MPacket_Base {
+private:
+    void copy(const MPacket& other);
+    virtual void setCorrectName();
+protected:
+    MPacket& operator=(const MPacket& other);
+public:
+    MPacket(const char *name = nullptr);
+    MPacket(const MPacket& other);
+    virtual ~MPacket();
+    virtual void setFragment(const cFragmentPointer& fragment) override;
+    virtual cFragmentPointer removeFragment();
+    virtual MPacket* dup() const override;
+    virtual void setType(int type) override;
+    virtual void setStartFragment(bool startFragment) override;
+    virtual void setFinalFragment(bool finalFragment) override;
+    virtual void setFrameCount(uint8_t frameCount) override;
+    virtual void setFragCount(uint8_t fragCount) override;
+};
+
+} /* namespace nesting */
+
+#endif /* NESTING_LINKLAYER_FRAMEPREEMPTION_MPACKET_H_ */
@@ -0,0 +1,245 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "nesting/linklayer/launchTime/LaunchTimeQueue.h"
+#include "nesting/linklayer/launchTime/LaunchTimeTag_m.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace nesting {
+
+Define_Module(LaunchTimeQueue);
+
+bool LaunchTimeQueue::Entry::operator>(const Entry& other) const {
+    return launchTime > other.launchTime
+            || (launchTime == other.launchTime && order > other.order);
+}
+
+LaunchTimeQueue::~LaunchTimeQueue() {
+    cancelEvent(&releaseMsg);
+    for (Entry& entry : frames) {
+        delete entry.packet;
+    }
+}
+
+void LaunchTimeQueue::initialize() {
+    rcvdPkSignal = registerSignal("rcvdPk");
+    dropPkSignal = registerSignal("dropPk");
+    queueLengthSignal = registerSignal("queueLength");
+    launchTimeDeviationSignal = registerSignal("launchTimeDeviation");
+
+    int capacity = par("frameCapacity");
+    if (capacity < 1) {
+        throw cRuntimeError("Parameter frameCapacity must be at least 1.");
+    }
+    frameCapacity = capacity;
+    dropLateFrames = par("dropLateFrames");
+    frames.reserve(frameCapacity);
+
+    releaseMsg.setSchedulingPriority(selfMessageSchedulingPriority);
+
+    WATCH(packetRequested);
+    WATCH(numPacketsReceived);
+    WATCH(numPacketsDropped);
+    WATCH(numLateFrames);
+
+    emit(queueLengthSignal, frames.size());
+}
+
+void LaunchTimeQueue::handleMessage(cMessage* msg) {
+    if (msg == &releaseMsg) {
+        handleReleaseEvent();
+    } else {
+        enqueue(check_and_cast<Packet*>(msg));
+    }
+}
+
+void LaunchTimeQueue::refreshDisplay() const {
+    char buf[80];
+    sprintf(buf, "q: %zu\ndropped: %lu", frames.size(),
+            static_cast<unsigned long>(numPacketsDropped));
+    getDisplayString().setTagArg("t", 0, buf);
+}
+
+void LaunchTimeQueue::enqueue(Packet* packet) {
+    emit(rcvdPkSignal, packet->getTreeId());
+    numPacketsReceived++;
+
+    Entry entry { simTime(), enqueueCount++, false, packet };
+    auto launchTimeReq = packet->findTag<LaunchTimeReq>();
+    if (launchTimeReq) {
+        entry.launchTime = launchTimeReq->getLaunchTime();
+        entry.hasLaunchTime = true;
+    }
+
+    // Late frames that are not dropped are counted when they are released.
+    if (dropLateFrames && entry.launchTime < simTime()) {
+        numLateFrames++;
+        EV_INFO << getFullPath() << ": Launch time " << entry.launchTime
+                       << " of frame " << packet->getName()
+                       << " has already passed. Dropping frame." << endl;
+        dropFrame(packet);
+        return;
+    }
+    if (frames.size() >= frameCapacity) {
+        EV_INFO << getFullPath() << ": Queue full. Dropping frame "
+                       << packet->getName() << endl;
+        dropFrame(packet);
+        return;
+    }
+
+    if (par("verbose")) {
+        EV_DETAIL << getFullPath() << ": Enqueue frame " << packet->getName()
+                         << " with launch time " << entry.launchTime << endl;
+    }
+
+    frames.push_back(entry);
+    std::push_heap(frames.begin(), frames.end(), std::greater<Entry>());
+    emit(queueLengthSignal, frames.size());
+
+    // A frame that is due immediately may be sent as soon as the MAC asks.
+    if (!packetRequested && isHeadDue() && frames.front().order == entry.order) {
+        notifyPacketEnqueued();
+    }
+    scheduleRelease();
+}
+
+void LaunchTimeQueue::handleReleaseEvent() {
+    EV_TRACE << getFullPath() << ": Handle release event." << endl;
+
+    if (!packetRequested) {
+        // Frame is due, but the MAC is still busy.
+        notifyPacketEnqueued();
+        return;
+    }
+
+    while (isHeadDue()) {
+        Entry entry = popHead();
+        simtime_t deviation = simTime() - entry.launchTime;
+
+        if (entry.hasLaunchTime && deviation > SimTime::ZERO) {
+            numLateFrames++;
+            if (dropLateFrames) {
+                EV_INFO << getFullPath() << ": Launch time of frame "
+                               << entry.packet->getName() << " missed by "
+                               << deviation << ". Dropping frame." << endl;
+                dropFrame(entry.packet);
+                continue;
+            }
+        }
+
+        if (entry.hasLaunchTime) {
+            emit(launchTimeDeviationSignal, deviation);
+        }
+        packetRequested = false;
+        send(entry.packet, "out");
+        break;
+    }
+
+    scheduleRelease();
+}
+
+void LaunchTimeQueue::scheduleRelease() {
+    if (frames.empty() || (isHeadDue() && !packetRequested)) {
+        cancelEvent(&releaseMsg);
+        return;
+    }
+
+    simtime_t releaseTime = std::max(frames.front().launchTime, simTime());
+    if (releaseMsg.isScheduled()) {
+        if (releaseMsg.getArrivalTime() == releaseTime) {
+            return;
+        }
+        cancelEvent(&releaseMsg);
+    }
+    scheduleAt(releaseTime, &releaseMsg);
+}
+
+bool LaunchTimeQueue::isHeadDue() const {
+    return !frames.empty() && frames.front().launchTime <= simTime();
+}
+
+LaunchTimeQueue::Entry LaunchTimeQueue::popHead() {
+    std::pop_heap(frames.begin(), frames.end(), std::greater<Entry>());
+    Entry entry = frames.back();
+    frames.pop_back();
+    emit(queueLengthSignal, frames.size());
+    return entry;
+}
+
+void LaunchTimeQueue::dropFrame(Packet* packet) {
+    emit(dropPkSignal, packet->getTreeId());
+    numPacketsDropped++;
+    delete packet;
+}
+
+void LaunchTimeQueue::requestPacket() {
+    Enter_Method("requestPacket()");
+
+    // Precondition: The Mac module must not request more than one packet at
+    // a time.
+    if (packetRequested) {
+        throw cRuntimeError(
+                "LaunchTimeQueue module only supports one packet request at a time.");
+    }
+    packetRequested = true;
+    scheduleRelease();
+}
+
+int LaunchTimeQueue::getNumPendingRequests() {
+    return packetRequested ? 1 : 0;
+}
+
+bool LaunchTimeQueue::isEmpty() {
+    return !isHeadDue();
+}
+
+void LaunchTimeQueue::clear() {
+    Enter_Method("clear()");
+    cancelEvent(&releaseMsg);
+    for (Entry& entry : frames) {
+        delete entry.packet;
+    }
+    frames.clear();
+    emit(queueLengthSignal, frames.size());
+}
+
+cMessage* LaunchTimeQueue::pop() {
+    Enter_Method("pop()");
+    if (!isHeadDue()) {
+        return nullptr;
+    }
+    Packet* packet = popHead().packet;
+    scheduleRelease();
+    return packet;
+}
+
+void LaunchTimeQueue::addListener(IPassiveQueueListener *listener) {
+    listeners.push_back(listener);
+}
+
+void LaunchTimeQueue::removeListener(IPassiveQueueListener *listener) {
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener),
+            listeners.end());
+}
+
+void LaunchTimeQueue::notifyPacketEnqueued() {
+    for (auto listener : listeners) {
+        listener->packetEnqueued(this);
+    }
+}
+
+} // namespace nesting
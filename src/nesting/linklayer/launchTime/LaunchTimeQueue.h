@@ -0,0 +1,191 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NESTING_LINKLAYER_LAUNCHTIME_LAUNCHTIMEQUEUE_H_
+#define NESTING_LINKLAYER_LAUNCHTIME_LAUNCHTIMEQUEUE_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "inet/common/packet/Packet.h"
+#include "inet/common/queue/IPassiveQueue.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class LaunchTimeQueue: public IPassiveQueue, public cSimpleModule {
+protected:
+    /** Queued frame together with its launch time. */
+    struct Entry {
+        simtime_t launchTime;
+        /** Arrival order, keeps frames with equal launch times FIFO. */
+        uint64_t order;
+        /** False if the frame carried no LaunchTimeReq tag. */
+        bool hasLaunchTime;
+        Packet* packet;
+        bool operator>(const Entry& other) const;
+    };
+
+    /** Min-heap of queued frames ordered by launch time. */
+    std::vector<Entry> frames;
+
+    /** Number of frames enqueued so far. */
+    uint64_t enqueueCount = 0;
+
+    /** Maximum number of queued frames. */
+    unsigned int frameCapacity;
+
+    /** Drop frames whose launch time has already passed. */
+    bool dropLateFrames;
+
+    /**
+     * This flag is set if a packet is requested from this module by the
+     * requestPacket method and again set to false when a packet is send out
+     * on the out-gate.
+     */
+    bool packetRequested = false;
+
+    /**
+     * This vector keeps references to listeners that are notified about
+     * packet-enqueued-events. In the default case this should be the Mac
+     * module.
+     */
+    std::vector<IPassiveQueueListener*> listeners;
+
+    /**
+     * Set a lower scheduling priority for self-messages than the default
+     * value of zero, so that frames arriving at the same time are considered
+     * before the earliest frame is released.
+     */
+    int selfMessageSchedulingPriority = 1;
+
+    /**
+     * Self-message that is always scheduled at the launch time of the
+     * earliest frame, or at the current time if that frame is due and
+     * requested.
+     */
+    cMessage releaseMsg = cMessage("release");
+
+    // statistics
+    uint64_t numPacketsReceived = 0;
+    uint64_t numPacketsDropped = 0;
+    uint64_t numLateFrames = 0;
+    simsignal_t rcvdPkSignal;
+    simsignal_t dropPkSignal;
+    simsignal_t queueLengthSignal;
+    simsignal_t launchTimeDeviationSignal;
+
+protected:
+    /**
+     * @see cSimpleModule::initialize()
+     */
+    virtual void initialize() override;
+
+    /**
+     * @see cSimpleModule::handleMessage(cMessage*)
+     */
+    virtual void handleMessage(cMessage* msg) override;
+
+    /**
+     * @see cSimpleModule::refreshDisplay() const
+     */
+    virtual void refreshDisplay() const override;
+
+    /**
+     * Inserts a frame according to its launch time, or drops it if the queue
+     * is full or the launch time has already passed and late frames are
+     * dropped.
+     */
+    virtual void enqueue(Packet* packet);
+
+    /**
+     * Handles the release timer. Sends the earliest frame to the MAC if a
+     * packet was requested, otherwise notifies listeners that a frame became
+     * ready for transmission.
+     */
+    virtual void handleReleaseEvent();
+
+    /**
+     * Points the release timer to the earliest frame. Doesn't schedule the
+     * timer if the earliest frame is already due but no packet is requested.
+     */
+    virtual void scheduleRelease();
+
+    /** Returns true if the earliest frame may be released now. */
+    virtual bool isHeadDue() const;
+
+    /** Removes and returns the earliest frame. */
+    virtual Entry popHead();
+
+    /** Drops a frame and updates statistics. */
+    virtual void dropFrame(Packet* packet);
+
+    /**
+     * Notifies listeners that a packet is became ready for transmission.
+     */
+    virtual void notifyPacketEnqueued();
+
+public:
+    virtual ~LaunchTimeQueue();
+
+    /**
+     * @see IPassiveQueue::requestPacket()
+     */
+    virtual void requestPacket() override;
+
+    /**
+     * @see IPassiveQueue::getNumPendingRequests()
+     */
+    virtual int getNumPendingRequests() override;
+
+    /**
+     * Returns true if no frame is due for transmission. Frames whose launch
+     * time lies in the future are not considered.
+     *
+     * @see IPassiveQueue::isEmpty()
+     */
+    virtual bool isEmpty() override;
+
+    /**
+     * @see IPassiveQueue::clear()
+     */
+    virtual void clear() override;
+
+    /**
+     * Returns the earliest frame if it is due, nullptr otherwise.
+     *
+     * @see IPassiveQueue::pop()
+     */
+    virtual cMessage *pop() override;
+
+    /**
+     * @see IPassiveQueue::addListener(IPassiveQueueListener*)
+     */
+    virtual void addListener(IPassiveQueueListener *listener) override;
+
+    /**
+     * @see IPassiveQueue::removeListener(IPassiveQueueListener*)
+     */
+    virtual void removeListener(IPassiveQueueListener *listener) override;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_LINKLAYER_LAUNCHTIME_LAUNCHTIMEQUEUE_H_ */